@@ -0,0 +1,1440 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <glm/gtc/matrix_transform.hpp>
+#include "DestructibleMap.h"
+#include "DestructibleMapAutoTuner.h"
+#include "DestructibleMapDrawingBatch.h"
+#include "DestructibleMapFrameCommands.h"
+#include "DestructibleMapJournal.h"
+#include "DestructibleMapPager.h"
+#include "DestructibleMapRecordingBackend.h"
+#include "DestructibleMapProfiler.h"
+#include "DestructibleMapTaskScheduler.h"
+#include "DestructibleMapUtility.h"
+#include "poly2tri/common/arena.h"
+
+// counts every heap allocation of the process, to see how many allocations a frame causes
+std::atomic<long long> heap_allocations(0);
+
+void *operator new(size_t size)
+{
+	heap_allocations++;
+	if (auto pointer = malloc(size ? size : 1))
+	{
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+#ifdef __cpp_aligned_new
+// over aligned types (C++17), allocated and freed apart from the rest because windows needs its own free for them
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	heap_allocations++;
+	size = size ? size : 1;
+#ifdef _WIN32
+	auto pointer = _aligned_malloc(size, size_t(alignment));
+#else
+	void *pointer = nullptr;
+	if (posix_memalign(&pointer, std::max(size_t(alignment), sizeof(void*)), size) != 0)
+	{
+		pointer = nullptr;
+	}
+#endif
+	if (pointer)
+	{
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+	_aligned_free(pointer);
+#else
+	free(pointer);
+#endif
+}
+
+void operator delete[](void *pointer, std::align_val_t alignment) noexcept
+{
+	operator delete(pointer, alignment);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(pointer, alignment);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(pointer, alignment);
+}
+#endif
+
+// one brush stamp of a stroke, the same what DestructibleMapController does while a mouse button is pressed
+struct BrushStamp
+{
+	ClipperLib::ClipType clip_type;
+	glm::vec2 position;
+	float radius;
+};
+
+struct Scenario
+{
+	std::string name;
+	std::vector<BrushStamp> stamps;
+};
+
+struct BenchmarkOptions
+{
+	DestructibleMapConfig config;
+	bool autotune;
+	bool triangulation;
+	bool memory;
+	bool scaling;
+	bool async;
+	bool lod;
+	bool frame_commands;
+	int num_threads;
+	unsigned int seed;
+	int num_stamps;
+	int stamps_per_stroke;
+	int stamps_per_frame;
+	float view_size;
+	std::string scenario_filter;
+	std::string trace_path;
+	std::string snapshot_path;
+	std::string journal_path;
+	std::string page_path;
+};
+
+std::vector<BrushStamp> generate_strokes(unsigned int seed, int num_stamps, int stamps_per_stroke, ClipperLib::ClipType clip_type, float radius, bool clustered)
+{
+	std::mt19937 engine(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// clustered strokes all start in the same 300x300 region, scattered ones anywhere on the map
+	const auto cluster_size = 300.0f;
+	const auto cluster_begin = glm::vec2(GENERATE_WIDTH, GENERATE_HEIGHT) * 0.5f - cluster_size * 0.5f;
+
+	std::vector<BrushStamp> stamps;
+	while (stamps.size() < num_stamps)
+	{
+		glm::vec2 position;
+		if (clustered)
+		{
+			position = cluster_begin + glm::vec2(unit(engine), unit(engine)) * cluster_size;
+		}
+		else
+		{
+			position = glm::vec2(unit(engine) * GENERATE_WIDTH, unit(engine) * GENERATE_HEIGHT);
+		}
+
+		auto angle = unit(engine) * glm::radians(360.0f);
+		for (auto i = 0; i < stamps_per_stroke && stamps.size() < num_stamps; i++)
+		{
+			stamps.push_back({ clip_type, position, radius });
+
+			// move like a mouse drag: half a brush per stamp with some jitter in direction
+			angle += (unit(engine) - 0.5f) * 0.5f;
+			position += glm::vec2(cos(angle), sin(angle)) * radius * 0.5f;
+		}
+	}
+	return stamps;
+}
+
+// trace format: one stamp per line "<e|d> <x> <y> <radius>", e = erase (difference), d = draw (union)
+bool load_trace(const std::string &path, std::vector<BrushStamp> &stamps)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		std::cout << "Could not open trace " << path << std::endl;
+		return false;
+	}
+
+	std::string mode;
+	BrushStamp stamp;
+	while (file >> mode >> stamp.position.x >> stamp.position.y >> stamp.radius)
+	{
+		stamp.clip_type = mode == "d" ? ClipperLib::ctUnion : ClipperLib::ctDifference;
+		stamps.push_back(stamp);
+	}
+	return true;
+}
+
+DestructibleMapOperation stamp_to_operation(const BrushStamp &stamp)
+{
+	DestructibleMapOperation operation;
+	operation.polygon = make_circle(glm::ivec2(stamp.position * SCALE_FACTOR), stamp.radius * SCALE_FACTOR, 16);
+	operation.clip_type = stamp.clip_type;
+	return operation;
+}
+
+void generate_map(DestructibleMap &map, unsigned int seed)
+{
+	map.generate_map(GENERATE_NUM_RECTS, GENERATE_NUM_CIRCLES, GENERATE_WIDTH, GENERATE_HEIGHT, GENERATE_MIN_SIZE, GENERATE_MAX_SIZE, seed);
+}
+
+double percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+	{
+		return 0.0;
+	}
+	std::sort(values.begin(), values.end());
+	const auto index = std::min(values.size() - 1, size_t(p * (values.size() - 1) + 0.5));
+	return values[index];
+}
+
+void print_row(const char *name, const std::vector<double> &samples)
+{
+	auto total = 0.0;
+	for (auto &sample : samples)
+	{
+		total += sample;
+	}
+
+	std::cout << "  " << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(3)
+		<< std::setw(10) << (samples.empty() ? 0.0 : total / samples.size())
+		<< std::setw(10) << percentile(samples, 0.5)
+		<< std::setw(10) << percentile(samples, 0.9)
+		<< std::setw(10) << percentile(samples, 0.99)
+		<< std::setw(10) << percentile(samples, 1.0)
+		<< std::endl;
+}
+
+void run_scenario(const Scenario &scenario, const BenchmarkOptions &options)
+{
+	DestructibleMap map(options.config);
+	generate_map(map, options.seed);
+
+	RecordingBatchBackend backend;
+	map.init(&backend);
+
+	// the first draw places every chunk of the map into a batch
+	const auto initial_begin = get_time();
+	map.draw();
+	const auto initial_milliseconds = (get_time() - initial_begin) * 1000.0;
+
+	std::vector<double> stage_samples[NUM_STAGES];
+	std::vector<double> total_samples;
+	std::vector<double> upload_samples;
+	std::vector<double> visible_samples;
+	std::vector<double> allocation_samples;
+	long long counters[NUM_COUNTERS] = {};
+
+	std::vector<DestructibleMapOperation> operations;
+	for (auto i = 0; i < scenario.stamps.size(); i += options.stamps_per_frame)
+	{
+		operations.clear();
+		for (auto j = i; j < std::min(i + options.stamps_per_frame, int(scenario.stamps.size())); j++)
+		{
+			operations.push_back(stamp_to_operation(scenario.stamps[j]));
+		}
+
+		map_profiler.reset();
+		const long long allocations_begin = heap_allocations;
+		const auto begin = get_time();
+
+		// one frame: modify the map and bring the drawing batches up to date
+		if (options.async)
+		{
+			map.submit_polygon_operations(operations);
+		}
+		else if (operations.size() == 1)
+		{
+			map.apply_polygon_operation(operations[0].polygon, operations[0].clip_type);
+		}
+		else
+		{
+			map.apply_polygon_operations(operations);
+		}
+		if (options.view_size > 0.0f)
+		{
+			// orthographic camera looking at the last stamp of the frame
+			const auto center = scenario.stamps[i + operations.size() - 1].position;
+			const auto half_size = options.view_size * 0.5f;
+			const auto projection = glm::ortho(center.x - half_size, center.x + half_size, center.y + half_size, center.y - half_size, -1.0f, 1.0f);
+			map.draw(extract_frustum(projection));
+		}
+		else
+		{
+			map.draw();
+		}
+
+		total_samples.push_back((get_time() - begin) * 1000.0);
+		allocation_samples.push_back(double(heap_allocations - allocations_begin));
+		upload_samples.push_back(map_uploaded_bytes / 1024.0);
+		visible_samples.push_back(map.get_batches().size() - map_culled_batches);
+		for (auto stage = 0; stage < NUM_STAGES; stage++)
+		{
+			stage_samples[stage].push_back(map_profiler.get_milliseconds(DestructibleMapStage(stage)));
+		}
+		for (auto counter = 0; counter < NUM_COUNTERS; counter++)
+		{
+			counters[counter] += map_profiler.get_count(DestructibleMapCounter(counter));
+		}
+	}
+
+	// the frames only measured the render thread, the rest of the submitted operations is not part of the statistics
+	if (options.async)
+	{
+		map.finish_pending_operations();
+		map.draw();
+	}
+
+	std::cout << scenario.name << " (" << scenario.stamps.size() << " stamps, " << map.get_batches().size() << " batches, " << map_draw_calls << " draw calls, initial placement " << std::fixed << std::setprecision(3) << initial_milliseconds << " ms)" << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "stage [ms]" << std::right
+		<< std::setw(10) << "mean"
+		<< std::setw(10) << "p50"
+		<< std::setw(10) << "p90"
+		<< std::setw(10) << "p99"
+		<< std::setw(10) << "max"
+		<< std::endl;
+	print_row("frame", total_samples);
+	for (auto stage = 0; stage < NUM_STAGES; stage++)
+	{
+		print_row(get_stage_name(DestructibleMapStage(stage)), stage_samples[stage]);
+	}
+	print_row("uploaded [KB]", upload_samples);
+	print_row("allocations", allocation_samples);
+	if (options.view_size > 0.0f)
+	{
+		print_row("visible batches", visible_samples);
+	}
+	for (auto counter = 0; counter < NUM_COUNTERS; counter++)
+	{
+		std::cout << "  " << get_counter_name(DestructibleMapCounter(counter)) << ": " << counters[counter] << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+// triangulates every leaf of the generated map again, isolated from clipping and batching
+void run_triangulation(const BenchmarkOptions &options)
+{
+	const auto rounds = 20;
+
+	DestructibleMap map(options.config);
+	generate_map(map, options.seed);
+
+	const auto max_float = std::numeric_limits<float>::max();
+	std::vector<DestructibleMapChunk*> leaves;
+	map.get_root_chunk()->query_range(glm::vec2(-max_float, -max_float), glm::vec2(max_float, max_float), leaves);
+
+	// empty leaves are skipped, as they are never triangulated
+	std::vector<ClipperLib::PolyTree> poly_trees;
+	poly_trees.reserve(leaves.size());
+	ClipperLib::Paths paths;
+	for (auto leaf : leaves)
+	{
+		leaf->get_paths(paths);
+		if (!paths.empty())
+		{
+			poly_trees.emplace_back();
+			paths_to_polytree(paths, poly_trees.back());
+		}
+	}
+
+	std::vector<double> time_samples;
+	std::vector<double> allocation_samples;
+	std::vector<glm::vec2> vertices;
+	vertices.reserve(options.config.vertices_per_chunk * 4);
+	for (auto round = 0; round < rounds; round++)
+	{
+		for (auto &poly_tree : poly_trees)
+		{
+
+			vertices.clear();
+			const long long allocations_begin = heap_allocations;
+			const auto begin = get_time();
+			triangulate_fast(poly_tree, vertices, options.config.triangulation_buffer);
+			time_samples.push_back((get_time() - begin) * 1000000.0);
+			allocation_samples.push_back(double(heap_allocations - allocations_begin));
+		}
+	}
+
+	const auto &arena = p2t::Arena::Current();
+	std::cout << "triangulation (" << leaves.size() << " leaves, " << poly_trees.size() << " not empty, " << rounds << " rounds, arena " << arena.block_allocations() << " blocks, " << arena.capacity() / 1024 << " KB)" << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "per chunk" << std::right
+		<< std::setw(10) << "mean"
+		<< std::setw(10) << "p50"
+		<< std::setw(10) << "p90"
+		<< std::setw(10) << "p99"
+		<< std::setw(10) << "max"
+		<< std::endl;
+	print_row("time [us]", time_samples);
+	print_row("allocations", allocation_samples);
+}
+
+// bytes per leaf of the compact geometry, compared with what 64 bit paths, a triangle list and a stored quad took for the same leaves
+void run_memory(const std::vector<Scenario> &scenarios, const BenchmarkOptions &options)
+{
+	DestructibleMap map(options.config);
+	generate_map(map, options.seed);
+	map.init();
+	map.draw();
+
+	// the scenarios one after the other on the same map, so the leaves also contain edited geometry
+	std::vector<DestructibleMapOperation> operations;
+	for (auto &scenario : scenarios)
+	{
+		for (auto i = 0; i < scenario.stamps.size(); i += options.stamps_per_frame)
+		{
+			operations.clear();
+			for (auto j = i; j < std::min(i + options.stamps_per_frame, int(scenario.stamps.size())); j++)
+			{
+				operations.push_back(stamp_to_operation(scenario.stamps[j]));
+			}
+			map.apply_polygon_operations(operations);
+			map.draw();
+		}
+	}
+
+	const auto max_float = std::numeric_limits<float>::max();
+	std::vector<DestructibleMapChunk*> leaves;
+	map.get_root_chunk()->query_range(glm::vec2(-max_float, -max_float), glm::vec2(max_float, max_float), leaves);
+
+	// sizes of the containers and their elements, without unused capacity
+	double paths_before = 0.0, triangles_before = 0.0, quad_before = 0.0;
+	double paths_after = 0.0, triangles_after = 0.0;
+	double resident = 0.0;
+	auto num_narrow = 0;
+	for (auto leaf : leaves)
+	{
+		const auto &paths = leaf->get_compact_paths();
+		const auto num_points = double(paths.get_num_points());
+		const auto num_paths = double(paths.get_num_paths());
+		const auto num_vertices = double(leaf->get_num_vertices());
+		const auto num_indices = double(leaf->get_num_indices());
+
+		paths_before += sizeof(ClipperLib::Paths) + num_paths * sizeof(ClipperLib::Path) + num_points * sizeof(ClipperLib::IntPoint);
+		triangles_before += sizeof(std::vector<glm::vec2>) + num_indices * sizeof(glm::vec2);
+		quad_before += sizeof(ClipperLib::Path) + 4 * sizeof(ClipperLib::IntPoint);
+
+		paths_after += sizeof(DestructibleMapCompactPaths) + num_paths * sizeof(uint32_t) + num_points * 2 * paths.get_coordinate_bytes();
+		triangles_after += sizeof(DestructibleMapMesh) + num_vertices * sizeof(glm::vec2) + num_indices * sizeof(uint16_t);
+		resident += leaf->get_resident_bytes();
+		num_narrow += !paths.is_wide();
+	}
+
+	const auto num_leaves = double(std::max<size_t>(leaves.size(), 1));
+	std::cout << "memory (" << leaves.size() << " leaves, " << num_narrow << " with 16 bit paths, " << sizeof(DestructibleMapChunk) << " bytes per chunk object, "
+		<< std::fixed << std::setprecision(1) << resident / 1024.0 << " KB resident in the leaves)" << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "per leaf [B]" << std::right << std::setw(10) << "before" << std::setw(10) << "after" << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "paths" << std::right << std::setw(10) << paths_before / num_leaves << std::setw(10) << paths_after / num_leaves << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "triangles" << std::right << std::setw(10) << triangles_before / num_leaves << std::setw(10) << triangles_after / num_leaves << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "quad" << std::right << std::setw(10) << quad_before / num_leaves << std::setw(10) << 0.0 << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "total" << std::right << std::setw(10) << (paths_before + triangles_before + quad_before) / num_leaves << std::setw(10) << (paths_after + triangles_after) / num_leaves << std::endl;
+}
+
+// compares starting up from a snapshot with generating the map, both including the first draw which places the chunks into batches
+void run_snapshot(const BenchmarkOptions &options)
+{
+	const auto rounds = 5;
+	const auto max_float = std::numeric_limits<float>::max();
+
+	std::vector<double> generate_samples;
+	std::vector<double> load_samples;
+	auto save_milliseconds = 0.0;
+	auto identical = true;
+	for (auto round = 0; round < rounds; round++)
+	{
+		DestructibleMap generated_map(options.config);
+		RecordingBatchBackend generated_backend;
+		auto begin = get_time();
+		generate_map(generated_map, options.seed);
+		generated_map.init(&generated_backend);
+		generated_map.draw();
+		generate_samples.push_back((get_time() - begin) * 1000.0);
+
+		if (round == 0)
+		{
+			begin = get_time();
+			if (!generated_map.save_snapshot(options.snapshot_path.c_str()))
+			{
+				return;
+			}
+			save_milliseconds = (get_time() - begin) * 1000.0;
+		}
+
+		DestructibleMap loaded_map(options.config);
+		RecordingBatchBackend loaded_backend;
+		begin = get_time();
+		if (!loaded_map.load_snapshot(options.snapshot_path.c_str()))
+		{
+			return;
+		}
+		loaded_map.init(&loaded_backend);
+		loaded_map.draw();
+		load_samples.push_back((get_time() - begin) * 1000.0);
+
+		// the loaded map has to end up with exactly the same leaves
+		std::vector<DestructibleMapChunk*> generated_leaves;
+		std::vector<DestructibleMapChunk*> loaded_leaves;
+		generated_map.get_root_chunk()->query_range(glm::vec2(-max_float, -max_float), glm::vec2(max_float, max_float), generated_leaves);
+		loaded_map.get_root_chunk()->query_range(glm::vec2(-max_float, -max_float), glm::vec2(max_float, max_float), loaded_leaves);
+		identical = identical && generated_leaves.size() == loaded_leaves.size() && generated_map.get_batches().size() == loaded_map.get_batches().size();
+		ClipperLib::Paths generated_paths;
+		ClipperLib::Paths loaded_paths;
+		for (auto i = 0; i < generated_leaves.size() && identical; i++)
+		{
+			const auto generated = generated_leaves[i];
+			const auto loaded = loaded_leaves[i];
+			generated->get_paths(generated_paths);
+			loaded->get_paths(loaded_paths);
+			identical = generated_paths == loaded_paths &&
+				generated->get_num_vertices() == loaded->get_num_vertices() &&
+				generated->get_num_indices() == loaded->get_num_indices() &&
+				std::equal(generated->get_vertices(), generated->get_vertices() + generated->get_num_vertices(), loaded->get_vertices()) &&
+				std::equal(generated->get_indices(), generated->get_indices() + generated->get_num_indices(), loaded->get_indices());
+		}
+	}
+
+	std::ifstream file(options.snapshot_path, std::ios::binary | std::ios::ate);
+	std::cout << "snapshot (" << options.snapshot_path << ", " << file.tellg() / 1024 << " KB, saved in " << std::fixed << std::setprecision(3) << save_milliseconds << " ms, " << rounds << " rounds, identical " << identical << ")" << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "startup [ms]" << std::right
+		<< std::setw(10) << "mean"
+		<< std::setw(10) << "p50"
+		<< std::setw(10) << "p90"
+		<< std::setw(10) << "p99"
+		<< std::setw(10) << "max"
+		<< std::endl;
+	print_row("generate", generate_samples);
+	print_row("snapshot", load_samples);
+}
+
+// area and number of vertices of all leaves, to compare a replayed map with the recorded one
+glm::dvec2 get_map_summary(DestructibleMap &map)
+{
+	const auto max_float = std::numeric_limits<float>::max();
+	std::vector<DestructibleMapChunk*> leaves;
+	map.get_root_chunk()->query_range(glm::vec2(-max_float, -max_float), glm::vec2(max_float, max_float), leaves);
+
+	glm::dvec2 summary(0.0, 0.0);
+	ClipperLib::Paths paths;
+	for (auto leaf : leaves)
+	{
+		leaf->get_paths(paths);
+		for (auto &path : paths)
+		{
+			summary.x += ClipperLib::Area(path);
+		}
+		summary.y += leaf->get_num_vertices();
+	}
+	return summary;
+}
+
+// records all scenarios on one map into a journal, then rebuilds the map from the journal
+void run_journal(const std::vector<Scenario> &scenarios, const BenchmarkOptions &options)
+{
+	// without a time budget the maintenance of the quad tree does not depend on timing, so a replay ends up with exactly the same map
+	auto config = options.config;
+	config.maintenance_budget_microseconds = 0;
+
+	std::vector<DestructibleMapOperation> operations;
+	for (auto &scenario : scenarios)
+	{
+		for (auto &stamp : scenario.stamps)
+		{
+			operations.push_back(stamp_to_operation(stamp));
+		}
+	}
+
+	// the map before the last frame is compared with a replay, which starts from a checkpoint before it
+	const long long last_frame = (int(operations.size()) - 1) / options.stamps_per_frame * options.stamps_per_frame;
+
+	// once without and once with the journal, to see what recording costs per frame
+	double frame_milliseconds[2] = {};
+	glm::dvec2 recorded_summary;
+	for (auto recording = 0; recording < 2; recording++)
+	{
+		DestructibleMap map(config);
+		generate_map(map, options.seed);
+		RecordingBatchBackend backend;
+		map.init(&backend);
+		map.draw();
+
+		DestructibleMapJournal journal;
+		if (recording)
+		{
+			if (!journal.open(options.journal_path.c_str()))
+			{
+				return;
+			}
+			map.set_journal(&journal);
+		}
+
+		for (auto i = 0; i < operations.size(); i += options.stamps_per_frame)
+		{
+			if (recording && i == last_frame)
+			{
+				recorded_summary = get_map_summary(map);
+			}
+
+			const std::vector<DestructibleMapOperation> frame_operations(operations.begin() + i, operations.begin() + std::min(i + options.stamps_per_frame, int(operations.size())));
+			const auto begin = get_time();
+			map.apply_polygon_operations(frame_operations);
+			map.draw();
+			frame_milliseconds[recording] += (get_time() - begin) * 1000.0;
+		}
+		frame_milliseconds[recording] /= std::max(1, int(operations.size() + options.stamps_per_frame - 1) / options.stamps_per_frame);
+
+		if (recording)
+		{
+			journal.close();
+		}
+	}
+
+	DestructibleMapJournalReader reader;
+	if (!reader.open(options.journal_path.c_str()))
+	{
+		return;
+	}
+
+	std::ifstream file(options.journal_path, std::ios::binary | std::ios::ate);
+	std::cout << "journal (" << options.journal_path << ", " << file.tellg() / 1024 << " KB, " << reader.get_operations().size() << " operations, " << reader.get_checkpoints().size() << " checkpoints, frame " << std::fixed << std::setprecision(3) << frame_milliseconds[0] << " ms without and " << frame_milliseconds[1] << " ms with recording)" << std::endl;
+	std::cout << std::setw(12) << "operations" << std::setw(12) << "checkpoint" << std::setw(8) << "batch" << std::setw(14) << "replay [ms]" << std::setw(12) << "identical" << std::endl;
+
+	// up to the last frame from the nearest checkpoint, and everything before the second checkpoint (from the initial one) one by one and in batches
+	const long long before_second = reader.get_checkpoints().size() > 1 ? reader.get_checkpoints()[1].operation_index - 1 : last_frame;
+	const long long targets[][2] = { { last_frame, 1 }, { before_second, 1 }, { before_second, 16 } };
+	glm::dvec2 sequential_summary;
+	for (auto &target : targets)
+	{
+		DestructibleMap map(config);
+		RecordingBatchBackend backend;
+		map.init(&backend);
+
+		const auto begin = get_time();
+		if (!reader.replay(map, target[0], int(target[1])))
+		{
+			return;
+		}
+		const auto replay_milliseconds = (get_time() - begin) * 1000.0;
+
+		// the batched replay clips several operations at once, so it is only compared with the sequential one by area
+		const auto summary = get_map_summary(map);
+		auto identical = false;
+		if (target[0] == last_frame)
+		{
+			identical = summary == recorded_summary;
+		}
+		else if (target[1] == 1)
+		{
+			sequential_summary = summary;
+			identical = true;
+		}
+		else
+		{
+			identical = abs(summary.x - sequential_summary.x) <= abs(sequential_summary.x) * 1e-6;
+		}
+
+		auto checkpoint = 0ll;
+		for (auto &candidate : reader.get_checkpoints())
+		{
+			if (candidate.operation_index <= target[0])
+			{
+				checkpoint = std::max(checkpoint, candidate.operation_index);
+			}
+		}
+		std::cout << std::setw(12) << target[0] << std::setw(12) << checkpoint << std::setw(8) << target[1] << std::setw(14) << replay_milliseconds << std::setw(12) << identical << std::endl;
+	}
+}
+
+// the paths of all leaves, paged out leaves have to be paged in before
+void get_map_paths(DestructibleMap &map, ClipperLib::Paths &paths)
+{
+	const auto max_float = std::numeric_limits<float>::max();
+	std::vector<DestructibleMapChunk*> leaves;
+	map.get_root_chunk()->query_range(glm::vec2(-max_float, -max_float), glm::vec2(max_float, max_float), leaves);
+
+	paths.clear();
+	ClipperLib::Paths leaf_paths;
+	for (auto leaf : leaves)
+	{
+		leaf->get_paths(leaf_paths);
+		paths.insert(paths.end(), leaf_paths.begin(), leaf_paths.end());
+	}
+}
+
+// replays every scenario (with every third stamp reversed) once with apply_polygon_operations and once with submit_polygon_operations,
+// both with merging and paging, and compares the maps at the end. Merges and paged leaves make results of the background thread stale, which are applied again.
+// Returns false if a map differs, or if no merge happened while a job was running
+bool run_async_check(const std::vector<Scenario> &scenarios, const BenchmarkOptions &options)
+{
+	const auto view_size = options.view_size > 0.0f ? options.view_size : 1000.0f;
+	const auto max_float = std::numeric_limits<float>::max();
+
+	// a frame only does one merge, the others are deferred and done right after the next submission, while its job still works on copies of the leaves
+	auto config = options.config;
+	config.enable_merging_subdividing = true;
+	config.maintenance_budget_microseconds = 1;
+
+	std::cout << "async check (paging to " << options.page_path << ", view " << view_size << ")" << std::endl;
+	std::cout << "  " << std::left << std::setw(24) << "scenario" << std::right << std::setw(10) << "stale" << std::setw(10) << "merged" << std::setw(12) << "in flight" << std::setw(12) << "paged out" << std::setw(16) << "difference" << std::setw(12) << "identical" << std::endl;
+	auto identical = true;
+	long long total_merged_in_flight = 0;
+	for (auto &scenario : scenarios)
+	{
+		ClipperLib::Paths paths[2];
+		long long counters[NUM_COUNTERS] = {};
+		long long merged_in_flight = 0;
+		for (auto async = 0; async < 2; async++)
+		{
+			DestructibleMap map(config);
+			generate_map(map, options.seed);
+			RecordingBatchBackend backend;
+			map.init(&backend);
+			map.draw();
+
+			if (!map.set_page_file(options.page_path.c_str()))
+			{
+				return false;
+			}
+
+			std::vector<DestructibleMapOperation> operations;
+			for (auto i = 0; i < scenario.stamps.size(); i += options.stamps_per_frame)
+			{
+				operations.clear();
+				for (auto j = i; j < std::min(i + options.stamps_per_frame, int(scenario.stamps.size())); j++)
+				{
+					// every third stamp does the opposite, applying the operations of a leaf twice or in a different order would change the map
+					operations.push_back(stamp_to_operation(scenario.stamps[j]));
+					if (j % 3 == 2)
+					{
+						operations.back().clip_type = operations.back().clip_type == ClipperLib::ctUnion ? ClipperLib::ctDifference : ClipperLib::ctUnion;
+					}
+				}
+
+				const auto center = scenario.stamps[i].position;
+				map.set_active_region(center - view_size * 0.5f, center + view_size * 0.5f);
+				map_profiler.reset();
+				if (async)
+				{
+					map.submit_polygon_operations(operations);
+				}
+				else
+				{
+					map.apply_polygon_operations(operations);
+				}
+				const auto in_flight = map.has_pending_operations();
+				const auto merged_begin = map_profiler.get_count(COUNTER_CHUNK_MERGED);
+				map.finish_maintenance();
+				merged_in_flight += in_flight ? map_profiler.get_count(COUNTER_CHUNK_MERGED) - merged_begin : 0;
+				map.draw();
+				for (auto counter = 0; counter < NUM_COUNTERS; counter++)
+				{
+					counters[counter] += async ? map_profiler.get_count(DestructibleMapCounter(counter)) : 0;
+				}
+			}
+
+			map_profiler.reset();
+			map.finish_pending_operations();
+			map.set_active_region(glm::vec2(-max_float, -max_float) * 0.5f, glm::vec2(max_float, max_float) * 0.5f);
+			map.finish_paging();
+			map.draw();
+			counters[COUNTER_ASYNC_STALE] += async ? map_profiler.get_count(COUNTER_ASYNC_STALE) : 0;
+			get_map_paths(map, paths[async]);
+		}
+
+		// the area covered by only one of the maps. The leaves are combined first, the xor of the touching leaf polygons is not reliable
+		ClipperLib::Clipper c;
+		for (auto &map_paths : paths)
+		{
+			c.Clear();
+			c.AddPaths(map_paths, ClipperLib::ptSubject, true);
+			c.Execute(ClipperLib::ctUnion, map_paths, ClipperLib::pftNonZero);
+		}
+		ClipperLib::Paths difference;
+		c.Clear();
+		c.AddPaths(paths[0], ClipperLib::ptSubject, true);
+		c.AddPaths(paths[1], ClipperLib::ptClip, true);
+		c.Execute(ClipperLib::ctXor, difference, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+		auto area = 0.0;
+		auto difference_area = 0.0;
+		for (auto &path : paths[0])
+		{
+			area += ClipperLib::Area(path);
+		}
+		for (auto &path : difference)
+		{
+			difference_area += ClipperLib::Area(path);
+		}
+		area = abs(area) * SCALE_FACTOR_INV * SCALE_FACTOR_INV;
+		difference_area = abs(difference_area) * SCALE_FACTOR_INV * SCALE_FACTOR_INV;
+
+		std::cout << "  " << std::left << std::setw(24) << scenario.name << std::right
+			<< std::setw(10) << counters[COUNTER_ASYNC_STALE]
+			<< std::setw(10) << counters[COUNTER_CHUNK_MERGED]
+			<< std::setw(12) << merged_in_flight
+			<< std::setw(12) << counters[COUNTER_LEAF_PAGED_OUT]
+			<< std::setw(16) << std::fixed << std::setprecision(3) << difference_area
+			<< std::setw(12) << (difference_area <= area * 1e-6)
+			<< std::endl;
+		identical = identical && difference_area <= area * 1e-6;
+		total_merged_in_flight += merged_in_flight;
+	}
+
+	if (total_merged_in_flight == 0)
+	{
+		std::cout << "  no merge while a job was running, the stale results were not checked" << std::endl;
+	}
+	return identical && total_merged_in_flight > 0;
+}
+
+// walks the camera diagonally over a 100000 x 100000 map and edits under it, once with a resident_bytes_limit and once with everything in memory
+void run_paging(const BenchmarkOptions &options)
+{
+	const auto map_size = 100000;
+	const auto num_shapes = 5000;
+	const auto num_frames = 600;
+	const auto view_size = options.view_size > 0.0f ? options.view_size : 2000.0f;
+	const auto max_float = std::numeric_limits<float>::max();
+
+	// the quad tree depends on how the points are spread and not on how many there are, a point cloud of the usual density would need more memory than the geometry.
+	// Without a time budget the maintenance does not depend on timing, so both maps get the same edits.
+	auto config = options.config;
+	config.triangle_area_ratio *= 0.01f;
+	config.maintenance_budget_microseconds = 0;
+
+	std::vector<double> frame_samples[2];
+	std::vector<double> resident_samples;
+	std::vector<double> missing_samples;
+	long long counters[NUM_COUNTERS] = {};
+	double generate_seconds = 0.0;
+	long long initial_resident_bytes = 0;
+	long long page_file_bytes = 0;
+	long long page_used_bytes = 0;
+	size_t num_leaves = 0;
+	glm::dvec2 summaries[2];
+	for (auto paging = 1; paging >= 0; paging--)
+	{
+		config.resident_bytes_limit = paging ? options.config.resident_bytes_limit : 0;
+		DestructibleMap map(config);
+		const auto generate_begin = get_time();
+		map.generate_map(num_shapes, num_shapes, map_size, map_size, GENERATE_MIN_SIZE, GENERATE_MAX_SIZE, options.seed);
+		RecordingBatchBackend backend;
+		map.init(&backend);
+		map.draw();
+
+		if (paging)
+		{
+			generate_seconds = get_time() - generate_begin;
+			std::vector<DestructibleMapChunk*> leaves;
+			map.get_root_chunk()->query_range(glm::vec2(-max_float, -max_float), glm::vec2(max_float, max_float), leaves);
+			num_leaves = leaves.size();
+			for (auto leaf : leaves)
+			{
+				initial_resident_bytes += leaf->get_resident_bytes();
+			}
+			if (!map.set_page_file(options.page_path.c_str()))
+			{
+				return;
+			}
+		}
+
+		std::mt19937 engine(options.seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		for (auto frame = 0; frame < num_frames; frame++)
+		{
+			const auto center = glm::vec2(view_size + (map_size - 2.0f * view_size) * frame / (num_frames - 1));
+			const auto half_size = view_size * 0.5f;
+			const auto stamp = center + glm::vec2(unit(engine), unit(engine)) * half_size * 0.5f;
+			const auto clip_type = frame % 4 == 3 ? ClipperLib::ctUnion : ClipperLib::ctDifference;
+
+			map_profiler.reset();
+			const auto frame_end = std::chrono::steady_clock::now() + std::chrono::microseconds(16667);
+			const auto begin = get_time();
+			map.set_active_region(center - half_size, center + half_size);
+			map.apply_polygon_operation(make_circle(glm::ivec2(stamp * SCALE_FACTOR), 40.0f * SCALE_FACTOR, 16), clip_type);
+			const auto projection = glm::ortho(center.x - half_size, center.x + half_size, center.y + half_size, center.y - half_size, -1.0f, 1.0f);
+			map.draw(extract_frustum(projection));
+			frame_samples[paging].push_back((get_time() - begin) * 1000.0);
+
+			if (paging)
+			{
+				// 60 frames per second like the viewer, so the background thread has as much time to page in as it would have there
+				std::this_thread::sleep_until(frame_end);
+
+				// leaves in the view which were not paged in in time
+				std::vector<DestructibleMapChunk*> visible;
+				map.get_root_chunk()->query_range(center - half_size, center + half_size, visible);
+				auto missing = 0;
+				for (auto leaf : visible)
+				{
+					missing += leaf->is_paged_out();
+				}
+				missing_samples.push_back(missing);
+				resident_samples.push_back(map.get_resident_bytes() / 1024.0);
+				for (auto counter = 0; counter < NUM_COUNTERS; counter++)
+				{
+					counters[counter] += map_profiler.get_count(DestructibleMapCounter(counter));
+				}
+			}
+		}
+
+		if (paging)
+		{
+			page_file_bytes = map.get_pager()->get_file_size();
+			page_used_bytes = map.get_pager()->get_used_bytes();
+
+			// everything is paged in again to compare the whole map
+			map.set_active_region(glm::vec2(-max_float, -max_float) * 0.5f, glm::vec2(max_float, max_float) * 0.5f);
+			map.finish_paging();
+			map.draw();
+		}
+		summaries[paging] = get_map_summary(map);
+	}
+
+	std::cout << "paging (" << map_size << " x " << map_size << ", " << num_leaves << " leaves, generated in " << std::fixed << std::setprecision(3) << generate_seconds << " s, "
+		<< initial_resident_bytes / 1024 << " KB resident before paging, limit " << options.config.resident_bytes_limit / 1024 << " KB, page file " << page_file_bytes / 1024 << " KB with " << page_used_bytes / 1024 << " KB in use)" << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "per frame" << std::right
+		<< std::setw(10) << "mean"
+		<< std::setw(10) << "p50"
+		<< std::setw(10) << "p90"
+		<< std::setw(10) << "p99"
+		<< std::setw(10) << "max"
+		<< std::endl;
+	print_row("paged [ms]", frame_samples[1]);
+	print_row("in memory [ms]", frame_samples[0]);
+	print_row("resident [KB]", resident_samples);
+	print_row("missing leaves", missing_samples);
+	for (auto counter = COUNTER_LEAF_PAGED_OUT; counter <= COUNTER_LEAF_PAGED_IN_ON_DEMAND; counter = DestructibleMapCounter(counter + 1))
+	{
+		std::cout << "  " << get_counter_name(counter) << ": " << counters[counter] << std::endl;
+	}
+	std::cout << "  area paged " << std::setprecision(0) << summaries[1].x << ", in memory " << summaries[0].x << std::endl;
+}
+
+// looks straight down on the map with the camera of the viewer from several heights, the highest one shows the whole map.
+// Compares the batches inside of the frustum at full detail with the levels of detail, then edits the map while it is completely visible.
+void run_lod(const BenchmarkOptions &options)
+{
+	const auto viewport_size = glm::vec2(1600.0f, 900.0f);
+	const auto projection = glm::perspective(glm::radians(60.0f), viewport_size.x / viewport_size.y, 0.1f, 5000.0f);
+	const auto center = glm::vec3(GENERATE_WIDTH * 0.5f, GENERATE_HEIGHT * 0.5f, 0.0f);
+	// the map is seen completely once half of its height fits into half of the field of view
+	const auto full_height = GENERATE_HEIGHT * 0.5f / tan(glm::radians(30.0f)) * 1.01f;
+	const float heights[] = { 100.0f, 300.0f, 1000.0f, 2000.0f, full_height };
+	const auto num_edit_frames = 200;
+
+	auto config = options.config;
+	if (config.lod_pixels <= 0.0f)
+	{
+		config.lod_pixels = LOD_PIXELS;
+	}
+	DestructibleMap map(config);
+	generate_map(map, options.seed);
+	RecordingBatchBackend backend;
+	map.init(&backend);
+	map.draw();
+
+	std::cout << "levels of detail (" << config.lod_pixels << " pixels, viewport " << viewport_size.x << " x " << viewport_size.y << ")" << std::endl;
+	std::cout << std::setw(10) << "height" << std::setw(16) << "full indices" << std::setw(14) << "lod indices" << std::setw(10) << "ratio" << std::setw(12) << "full [ms]" << std::setw(12) << "cold [ms]" << std::setw(12) << "warm [ms]" << std::setw(10) << "built" << std::setw(10) << "drawn" << std::endl;
+	glm::mat4 view_projection;
+	for (auto height : heights)
+	{
+		view_projection = projection * glm::lookAt(center + glm::vec3(0.0f, 0.0f, height), center, glm::vec3(0.0f, 1.0f, 0.0f));
+
+		backend.reset_counters();
+		auto begin = get_time();
+		map.draw(extract_frustum(view_projection));
+		const auto full_milliseconds = (get_time() - begin) * 1000.0;
+		const auto full_indices = backend.drawn_indices;
+
+		// the first frame at this height builds the levels of detail it needs
+		map_profiler.reset();
+		begin = get_time();
+		map.draw(view_projection, viewport_size);
+		const auto cold_milliseconds = (get_time() - begin) * 1000.0;
+		const auto built = map_profiler.get_count(COUNTER_LOD_BUILT);
+
+		map_profiler.reset();
+		backend.reset_counters();
+		begin = get_time();
+		map.draw(view_projection, viewport_size);
+		const auto warm_milliseconds = (get_time() - begin) * 1000.0;
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(10) << std::setprecision(0) << height
+			<< std::setw(16) << full_indices
+			<< std::setw(14) << backend.drawn_indices
+			<< std::setw(10) << std::setprecision(3) << double(backend.drawn_indices) / std::max(full_indices, 1ll)
+			<< std::setw(12) << full_milliseconds
+			<< std::setw(12) << cold_milliseconds
+			<< std::setw(12) << warm_milliseconds
+			<< std::setw(10) << built
+			<< std::setw(10) << map_profiler.get_count(COUNTER_LOD_DRAWN)
+			<< std::endl;
+	}
+
+	// every stamp dirties the levels of detail above it, they are built again by the next frame
+	const auto stamps = generate_strokes(options.seed, num_edit_frames, options.stamps_per_stroke, ClipperLib::ctDifference, 40.0f, false);
+	std::vector<double> frame_samples;
+	std::vector<double> built_samples;
+	std::vector<double> index_samples;
+	for (auto &stamp : stamps)
+	{
+		map_profiler.reset();
+		backend.reset_counters();
+		const auto begin = get_time();
+		map.apply_polygon_operation(stamp_to_operation(stamp).polygon, stamp.clip_type);
+		map.draw(view_projection, viewport_size);
+		frame_samples.push_back((get_time() - begin) * 1000.0);
+		built_samples.push_back(double(map_profiler.get_count(COUNTER_LOD_BUILT)));
+		index_samples.push_back(double(backend.drawn_indices));
+	}
+
+	std::cout << std::endl << "editing the whole map (" << num_edit_frames << " frames)" << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "per frame" << std::right
+		<< std::setw(10) << "mean"
+		<< std::setw(10) << "p50"
+		<< std::setw(10) << "p90"
+		<< std::setw(10) << "p99"
+		<< std::setw(10) << "max"
+		<< std::endl;
+	print_row("total [ms]", frame_samples);
+	print_row("lod built", built_samples);
+	print_row("drawn indices", index_samples);
+}
+
+// generates the map and replays all scenarios with 1 to num_threads threads, to see how the clipping and triangulation tasks scale
+// draws frames whose command list shrinks and grows again with the same commands into a ring of command buffers, the way the GL backend
+// writes one copy per frame, and checks that the written copy always holds exactly the commands of its frame
+void run_frame_commands_check(const BenchmarkOptions &options)
+{
+	const auto num_copies = 3;
+	const auto num_frames = 1000;
+	const auto max_commands = 64;
+
+	std::mt19937 engine(options.seed);
+	std::uniform_int_distribution<int> length(0, max_commands);
+	std::uniform_int_distribution<int> run(1, 8);
+	std::uniform_int_distribution<int> change(0, 15);
+
+	// the command at a position only changes now and then, so a list which grows again mostly gets back the commands it had before
+	std::vector<IndirectDrawCommand> stable(max_commands);
+	for (auto i = 0; i < max_commands; i++)
+	{
+		stable[i] = { uint32_t(i + 1), 1, uint32_t(i * 3), 0, 0 };
+	}
+
+	DestructibleMapFrameCommands frame_commands(num_copies);
+	std::vector<std::vector<IndirectDrawCommand>> copies(num_copies, std::vector<IndirectDrawCommand>(max_commands));
+	auto num_wrong_frames = 0;
+	auto num_written = 0;
+	auto frame = 0;
+	while (frame < num_frames)
+	{
+		// the same length for a few frames, so every copy is written with it before it changes again
+		const auto num_commands = length(engine);
+		for (auto repeat = run(engine); repeat > 0 && frame < num_frames; repeat--, frame++)
+		{
+			if (change(engine) == 0)
+			{
+				stable[std::uniform_int_distribution<int>(0, max_commands - 1)(engine)].instance_count ^= 1;
+			}
+
+			// a batch of commands at the front, single commands which are only written if they changed after it
+			const auto num_batch_commands = std::min(num_commands, 4);
+			frame_commands.set(frame_commands.add(num_batch_commands), stable.data(), num_batch_commands);
+			for (auto i = num_batch_commands; i < num_commands; i++)
+			{
+				frame_commands.set_if_changed(frame_commands.add(1), stable[i]);
+			}
+
+			const auto copy = frame % num_copies;
+			const auto num_frame_commands = frame_commands.end_frame();
+			int begin, end;
+			frame_commands.take_pending(copy, begin, end);
+			if (end > begin)
+			{
+				std::copy(frame_commands.get_commands() + begin, frame_commands.get_commands() + end, copies[copy].begin() + begin);
+				num_written += end - begin;
+			}
+
+			if (num_frame_commands != num_commands || memcmp(copies[copy].data(), stable.data(), num_commands * sizeof(IndirectDrawCommand)) != 0)
+			{
+				num_wrong_frames++;
+			}
+		}
+	}
+
+	std::cout << "frame commands check (" << num_frames << " frames, " << num_copies << " copies, up to " << max_commands << " commands)" << std::endl;
+	std::cout << "  written commands " << num_written << ", frames with wrong commands " << num_wrong_frames << (num_wrong_frames == 0 ? " (identical)" : " (DIFFERENT)") << std::endl;
+}
+
+void run_scaling(const std::vector<Scenario> &scenarios, const BenchmarkOptions &options)
+{
+	// printed at the end, generating the map logs its progress
+	std::vector<glm::vec2> rows;
+	for (auto num_threads = 1; num_threads <= options.num_threads; num_threads++)
+	{
+		map_scheduler.set_num_threads(num_threads);
+
+		auto generate_milliseconds = 0.0;
+		auto frame_milliseconds = 0.0;
+		auto num_frames = 0;
+		std::vector<DestructibleMapOperation> operations;
+		for (auto &scenario : scenarios)
+		{
+			DestructibleMap map(options.config);
+			const auto generate_begin = get_time();
+			generate_map(map, options.seed);
+			generate_milliseconds += (get_time() - generate_begin) * 1000.0;
+
+			RecordingBatchBackend backend;
+			map.init(&backend);
+			map.draw();
+
+			for (auto i = 0; i < scenario.stamps.size(); i += options.stamps_per_frame)
+			{
+				operations.clear();
+				for (auto j = i; j < std::min(i + options.stamps_per_frame, int(scenario.stamps.size())); j++)
+				{
+					operations.push_back(stamp_to_operation(scenario.stamps[j]));
+				}
+
+				const auto begin = get_time();
+				map.apply_polygon_operations(operations);
+				map.draw();
+				frame_milliseconds += (get_time() - begin) * 1000.0;
+				num_frames++;
+			}
+		}
+
+		rows.push_back(glm::vec2(generate_milliseconds / std::max(int(scenarios.size()), 1), frame_milliseconds / std::max(num_frames, 1)));
+	}
+
+	std::cout << std::endl << "scaling (" << scenarios.size() << " scenarios, " << options.stamps_per_frame << " stamps per frame)" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(16) << "generate [ms]" << std::setw(14) << "frame [ms]" << std::setw(12) << "speedup" << std::endl;
+	for (auto i = 0; i < rows.size(); i++)
+	{
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(8) << i + 1
+			<< std::setw(16) << rows[i].x
+			<< std::setw(14) << rows[i].y
+			<< std::setw(12) << rows[0].y / rows[i].y
+			<< std::endl;
+	}
+}
+
+void run_autotune(const std::vector<Scenario> &scenarios, const BenchmarkOptions &options)
+{
+	std::vector<DestructibleMapOperation> workload;
+	for (auto &scenario : scenarios)
+	{
+		for (auto &stamp : scenario.stamps)
+		{
+			workload.push_back(stamp_to_operation(stamp));
+		}
+	}
+
+	const auto seed = options.seed;
+	DestructibleMapAutoTuner tuner(options.config, [seed](DestructibleMap &map) { generate_map(map, seed); });
+	const auto best = tuner.tune(workload);
+
+	std::cout << "autotune (" << workload.size() << " operations)" << std::endl;
+	std::cout << std::setw(8) << "chunk" << std::setw(8) << "batch" << std::setw(12) << "mean [ms]" << std::setw(12) << "max [ms]" << std::setw(12) << "draw calls" << std::setw(10) << "cost" << std::endl;
+	for (auto &result : tuner.get_results())
+	{
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(8) << result.config.vertices_per_chunk
+			<< std::setw(8) << result.config.vertices_per_batch
+			<< std::setw(12) << result.mean_frame_milliseconds
+			<< std::setw(12) << result.max_frame_milliseconds
+			<< std::setw(12) << result.draw_calls
+			<< std::setw(10) << result.cost
+			<< std::endl;
+	}
+	std::cout << "best: vertices_per_chunk " << best.vertices_per_chunk << ", vertices_per_batch " << best.vertices_per_batch << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	BenchmarkOptions options;
+	options.autotune = false;
+	options.triangulation = false;
+	options.memory = false;
+	options.scaling = false;
+	options.async = false;
+	options.lod = false;
+	options.frame_commands = false;
+	options.num_threads = 0;
+	options.seed = GENERATE_SEED;
+	options.num_stamps = 500;
+	options.stamps_per_stroke = 20;
+	options.stamps_per_frame = 1;
+	options.view_size = 0.0f;
+	options.config.resident_bytes_limit = 4096 * 1024;
+
+	for (auto i = 1; i < argc; i++)
+	{
+		const auto has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--seed") && has_value)
+		{
+			options.seed = std::stoul(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--stamps") && has_value)
+		{
+			options.num_stamps = std::stoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--scenario") && has_value)
+		{
+			options.scenario_filter = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--trace") && has_value)
+		{
+			options.trace_path = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--chunk") && has_value)
+		{
+			options.config.set_vertices_per_chunk(std::stoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--batch") && has_value)
+		{
+			options.config.vertices_per_batch = std::stoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--stamps-per-frame") && has_value)
+		{
+			options.stamps_per_frame = std::max(1, std::stoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--incremental"))
+		{
+			options.config.incremental_triangulation = true;
+		}
+		else if (!strcmp(argv[i], "--view") && has_value)
+		{
+			options.view_size = std::stof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--linear-batch-search"))
+		{
+			options.config.batch_free_index = false;
+		}
+		else if (!strcmp(argv[i], "--autotune"))
+		{
+			options.autotune = true;
+		}
+		else if (!strcmp(argv[i], "--triangulation"))
+		{
+			options.triangulation = true;
+		}
+		else if (!strcmp(argv[i], "--memory"))
+		{
+			options.memory = true;
+		}
+		else if (!strcmp(argv[i], "--threads") && has_value)
+		{
+			options.num_threads = std::max(1, std::stoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--scaling"))
+		{
+			options.scaling = true;
+		}
+		else if (!strcmp(argv[i], "--lod"))
+		{
+			options.lod = true;
+		}
+		else if (!strcmp(argv[i], "--lod-pixels") && has_value)
+		{
+			options.config.lod_pixels = std::stof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--frame-commands"))
+		{
+			options.frame_commands = true;
+		}
+		else if (!strcmp(argv[i], "--async"))
+		{
+			options.async = true;
+		}
+		else if (!strcmp(argv[i], "--snapshot") && has_value)
+		{
+			options.snapshot_path = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--journal") && has_value)
+		{
+			options.journal_path = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--paging") && has_value)
+		{
+			options.page_path = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--resident-limit") && has_value)
+		{
+			options.config.resident_bytes_limit = std::stoll(argv[++i]) * 1024;
+		}
+		else
+		{
+			std::cout << "Usage: " << argv[0] << " [--seed n] [--stamps n] [--scenario name] [--trace file] [--chunk n] [--batch n] [--stamps-per-frame n] [--view size] [--incremental] [--linear-batch-search] [--autotune] [--triangulation] [--memory] [--threads n] [--scaling] [--async] [--lod] [--lod-pixels n] [--frame-commands] [--snapshot file] [--journal file] [--paging file] [--resident-limit KB]" << std::endl;
+			return 1;
+		}
+	}
+
+	// without --threads every hardware thread is used, --scaling goes up to all of them
+	if (options.num_threads == 0)
+	{
+		options.num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+	}
+	if (!options.scaling)
+	{
+		map_scheduler.set_num_threads(options.num_threads);
+	}
+
+	if (options.frame_commands)
+	{
+		run_frame_commands_check(options);
+		return 0;
+	}
+
+	if (options.triangulation)
+	{
+		run_triangulation(options);
+		return 0;
+	}
+
+	if (!options.snapshot_path.empty())
+	{
+		run_snapshot(options);
+		return 0;
+	}
+
+	if (!options.page_path.empty() && !options.async)
+	{
+		run_paging(options);
+		return 0;
+	}
+
+	if (options.lod)
+	{
+		run_lod(options);
+		return 0;
+	}
+
+	std::vector<Scenario> scenarios;
+	if (!options.trace_path.empty())
+	{
+		Scenario scenario;
+		scenario.name = options.trace_path;
+		if (!load_trace(options.trace_path, scenario.stamps))
+		{
+			return 1;
+		}
+		scenarios.push_back(scenario);
+	}
+	else
+	{
+		const ClipperLib::ClipType clip_types[] = { ClipperLib::ctDifference, ClipperLib::ctUnion };
+		const float radii[] = { 10.0f, 40.0f };
+		const bool layouts[] = { true, false };
+		for (auto clip_type : clip_types)
+		{
+			for (auto radius : radii)
+			{
+				for (auto clustered : layouts)
+				{
+					Scenario scenario;
+					scenario.name = std::string(clip_type == ClipperLib::ctDifference ? "erase" : "draw") +
+						(radius < 20.0f ? "_small" : "_large") +
+						(clustered ? "_clustered" : "_scattered");
+					scenario.stamps = generate_strokes(options.seed, options.num_stamps, options.stamps_per_stroke, clip_type, radius, clustered);
+					scenarios.push_back(scenario);
+				}
+			}
+		}
+	}
+
+	if (!options.scenario_filter.empty())
+	{
+		std::vector<Scenario> filtered;
+		for (auto &scenario : scenarios)
+		{
+			if (scenario.name.find(options.scenario_filter) != std::string::npos)
+			{
+				filtered.push_back(scenario);
+			}
+		}
+		scenarios = filtered;
+	}
+
+	if (options.autotune)
+	{
+		run_autotune(scenarios, options);
+		return 0;
+	}
+
+	if (options.scaling)
+	{
+		run_scaling(scenarios, options);
+		return 0;
+	}
+
+	if (!options.journal_path.empty())
+	{
+		run_journal(scenarios, options);
+		return 0;
+	}
+
+	if (options.memory)
+	{
+		run_memory(scenarios, options);
+		return 0;
+	}
+
+	if (options.async && !options.page_path.empty())
+	{
+		return run_async_check(scenarios, options) ? 0 : 1;
+	}
+
+	std::cout << "vertices_per_batch " << options.config.vertices_per_batch << ", vertices_per_chunk " << options.config.vertices_per_chunk << ", stamps per frame " << options.stamps_per_frame << ", incremental triangulation " << options.config.incremental_triangulation << ", batch free index " << options.config.batch_free_index << ", threads " << options.num_threads << ", async " << options.async << ", seed " << options.seed << std::endl << std::endl;
+
+	for (auto &scenario : scenarios)
+	{
+		run_scenario(scenario, options);
+	}
+
+	return 0;
+}
@@ -2,49 +2,78 @@
 #include "clipper.hpp"
 #include <iostream>
 #include "poly2tri/sweep/cdt.h"
-#include "ShaderResource.h"
-#include "MeshResource.h"
 #include <random>
 #include <limits>
+#include <climits>
+#include <algorithm>
+#include <unordered_map>
 #include <glm/gtc/quaternion.hpp>
-#include <GLFW/glfw3.h>
-#include "DestructibleMapShader.h"
-#include "RenderingEngine.h"
 #include "DestructibleMapDrawingBatch.h"
-#include <omp.h>
+#include "DestructibleMapRecordingBackend.h"
 #include "DestructibleMapUtility.h"
-
-DestructibleMap::DestructibleMap(float triangle_area_ratio, float points_per_leaf_ratio)
+#include "DestructibleMapProfiler.h"
+#include "DestructibleMapClipperContext.h"
+#include "DestructibleMapTaskScheduler.h"
+#include "DestructibleMapAsyncModifier.h"
+#include "DestructibleMapSnapshot.h"
+#include "DestructibleMapJournal.h"
+#include "DestructibleMapPager.h"
+#include <thread>
+#include <fstream>
+#include <cstring>
+
+DestructibleMap::DestructibleMap(const DestructibleMapConfig &config)
 {
-	this->rendering_engine_ = nullptr;
-	this->point_distribution_resource_ = nullptr;
-	this->quadtree_resource_ = nullptr;
-	this->triangle_area_ratio_ = triangle_area_ratio;
-	this->points_per_leaf_ratio_ = points_per_leaf_ratio;
-	this->startup_displayed_ = false;
-
-	this->map_shader_ = new DestructibleMapShader();
-	map_shader_->init();
+	this->backend_ = nullptr;
+	this->owns_backend_ = false;
+	this->config_ = config;
+	this->start_time_ = 0.0;
+	this->seed_ = GENERATE_SEED;
+	this->async_modifier_ = nullptr;
+	this->async_job_ = nullptr;
+	this->first_update_ = true;
+	this->snapshot_ = nullptr;
+	this->journal_ = nullptr;
+	this->pager_ = nullptr;
+	this->num_page_requests_ = 0;
+	this->has_active_region_ = false;
+	this->active_begin_ = glm::vec2(0.0f, 0.0f);
+	this->active_end_ = glm::vec2(0.0f, 0.0f);
+	this->resident_bytes_ = 0;
+	this->resident_growth_ = 0;
+
+	// the indices inside of a batch are 16 bit
+	if (this->config_.vertices_per_batch > MAX_MESH_VERTICES)
+	{
+		std::cout << "Batches are limited to " << MAX_MESH_VERTICES << " vertices" << std::endl;
+		this->config_.vertices_per_batch = MAX_MESH_VERTICES;
+	}
 }
 
 
 DestructibleMap::~DestructibleMap()
 {
+	// the background thread may still read the current job
+	delete this->async_modifier_;
+	delete this->async_job_;
+	delete this->pager_;
+
 	for (auto &batch : this->batches_)
 	{
 		delete batch;
 	}
-	delete this->map_shader_;
-
-	if (point_distribution_resource_)
+	for (auto &batch : this->lod_batches_)
 	{
-		delete point_distribution_resource_;
+		delete batch;
 	}
 
-	if (quadtree_resource_)
+	if (this->owns_backend_)
 	{
-		delete quadtree_resource_;
+		delete this->backend_;
 	}
+
+	// the chunks do not read their mapped vertices anymore while they are destroyed
+	delete this->snapshot_;
 }
 
 void DestructibleMap::load(ClipperLib::Paths paths)
@@ -60,45 +89,138 @@ void DestructibleMap::load(ClipperLib::Paths paths)
 	triangulate(poly_tree, this->vertices_);
 	generate_aabb(this->vertices_, boundary_begin, boundary_end);
 
-	this->quad_tree_ = DestructibleMapChunk(nullptr, boundary_begin, boundary_end);
+	this->quad_tree_ = DestructibleMapChunk(&this->config_, &this->chunk_pool_, nullptr, boundary_begin, boundary_end);
 
-#ifdef ENABLE_MERGING_SUBDIVIDING
-	std::cout << "Generating Point Cloud" << std::endl;
-	generate_point_cloud(this->triangle_area_ratio_, this->vertices_, this->points_);
-
-	std::cout << "Generating Quad Tree" << std::endl;
-	const int count = std::max(this->points_.size() * points_per_leaf_ratio_, 5.0f);
-	for (auto& point : this->points_)
+	if (this->config_.enable_merging_subdividing)
 	{
-		this->quad_tree_.insert(point, count);
+		std::cout << "Generating Point Cloud" << std::endl;
+		generate_point_cloud(this->config_.triangle_area_ratio, this->vertices_, this->points_, this->seed_);
+
+		std::cout << "Generating Quad Tree" << std::endl;
+		const int count = std::max(this->points_.size() * this->config_.points_per_leaf_ratio, 5.0f);
+		for (auto& point : this->points_)
+		{
+			this->quad_tree_.insert(point, count);
+		}
 	}
-#endif
 
+	// the chunks clip the union of all shapes, overlapping shapes would keep their seams
 	std::cout << "Applying Polygon" << std::endl;
+	ClipperLib::PolyTreeToPaths(poly_tree, paths);
 	this->quad_tree_.apply_polygon(paths);
-
-	this->point_distribution_resource_ = new MeshResource(this->points_);
 }
 
 void DestructibleMap::update_batches()
 {
-	auto time = glfwGetTime();
+	// results of submitted operations are swapped in at the start of the frame
+	if (this->async_job_ != nullptr)
+	{
+		this->apply_async_results(this->config_.async_apply_budget_microseconds * 1000ll);
+	}
+	if (this->pager_ != nullptr)
+	{
+		this->apply_paged_in_leaves();
+	}
+
+	// before the dirty chunks are placed, so merged and subdivided chunks are drawn in the same frame
+	if (this->config_.enable_merging_subdividing)
+	{
+		this->run_maintenance(this->config_.maintenance_budget_microseconds * 1000ll);
+	}
+
+	this->place_dirty_chunks();
+
+	// the first frame places the whole map anyway, so it also settles the quad tree of the freshly loaded map without a budget
+	if (this->first_update_)
+	{
+		this->first_update_ = false;
+		this->finish_maintenance();
+	}
+
+	// after the dirty chunks are placed, so only leaves which are in a batch are paged out
+	if (this->pager_ != nullptr)
+	{
+		this->request_pages();
+		this->page_out_leaves();
+	}
+
+	// the snapshot has to contain every recorded operation, so it waits for the submitted ones
+	if (this->journal_ != nullptr && this->journal_->needs_checkpoint() && !this->has_pending_operations())
+	{
+		std::vector<char> snapshot;
+		this->write_snapshot(snapshot);
+		this->journal_->add_checkpoint(snapshot);
+	}
+
+	this->upload_chunk_attributes();
+}
+
+void DestructibleMap::upload_chunk_attributes()
+{
+	int begin, end;
+	if (this->backend_ == nullptr || !this->chunk_pool_.take_dirty_attributes(begin, end))
+	{
+		return;
+	}
+
+	const auto &attributes = this->chunk_pool_.get_all_attributes();
+	this->backend_->upload_chunk_attributes(attributes.data(), int(attributes.size()), begin, end - begin);
+	map_uploaded_bytes += sizeof(uint32_t) * (end - begin);
+}
+
+void DestructibleMap::set_journal(DestructibleMapJournal *journal)
+{
+	this->journal_ = journal;
+	if (journal != nullptr)
+	{
+		this->finish_pending_operations();
+
+		std::vector<char> snapshot;
+		this->write_snapshot(snapshot);
+		journal->add_checkpoint(snapshot);
+	}
+}
+
+bool DestructibleMap::has_maintenance() const
+{
+	return this->config_.enable_merging_subdividing && (!this->deferred_subdivisions_.empty() || this->quad_tree_.mergeable_count_ > 0);
+}
+
+void DestructibleMap::finish_maintenance()
+{
+	// a merged chunk can end up with more indices than its leaves had together and is subdivided again, which makes its leaves mergeable again.
+	// Such a chunk never settles, so the rounds are limited (every round merges or subdivides one level of the tree)
+	const auto max_rounds = 64;
+	for (auto round = 0; round < max_rounds && this->has_maintenance(); round++)
+	{
+		this->run_maintenance(0);
+		this->place_dirty_chunks();
+	}
+}
+
+void DestructibleMap::place_dirty_chunks()
+{
 	while (this->quad_tree_.mesh_dirty_)
 	{
 		std::vector<DestructibleMapChunk*> dirty_chunks;
 		std::vector<DestructibleMapChunk*> merge_chunks;
 
+		// query_dirty visits north west, north east, south west, south east, so the chunks are already in Morton order
 		this->quad_tree_.query_dirty(dirty_chunks);
 
 		for (auto &chunk : dirty_chunks)
 		{
-#ifdef ENABLE_MERGING_SUBDIVIDING
+			// only placed leaves can have grown since the resident bytes were measured
+			this->resident_growth_ += chunk->get_resident_bytes();
+
 			auto parent = chunk->parent_;
-			if (parent != nullptr && parent->north_west_ && !parent->north_west_->north_west_ && !parent->north_east_->north_west_ && !parent->south_east_->north_west_ && !parent->south_west_->north_west_)
+			if (this->config_.enable_merging_subdividing && parent != nullptr && parent->north_west_ && !parent->north_west_->north_west_ && !parent->north_east_->north_west_ && !parent->south_east_->north_west_ && !parent->south_west_->north_west_)
 			{
-				auto total_vertices = parent->north_west_->vertices_.size() + parent->north_east_->vertices_.size() + parent->south_west_->vertices_.size() + parent->south_east_->vertices_.size();
+				auto total_vertices = parent->north_west_->get_num_indices() + parent->north_east_->get_num_indices() + parent->south_west_->get_num_indices() + parent->south_east_->get_num_indices();
 
-				if (parent->mergeable_count_ == 0 && total_vertices < VERTICES_PER_CHUNK) {
+				// a paged out sibling has no vertices, but it is not empty
+				const auto resident = !parent->north_west_->paged_out_ && !parent->north_east_->paged_out_ && !parent->south_west_->paged_out_ && !parent->south_east_->paged_out_;
+				if (parent->mergeable_count_ == 0 && resident && total_vertices < this->config_.vertices_per_chunk) {
 					// chunk may be merged with parent
 
 					// => increase mergeable count of leaves
@@ -114,7 +236,7 @@ void DestructibleMap::update_batches()
 						current->mergeable_count_++;
 						current = current->parent_;
 					}
-				} else if (parent->mergeable_count_ > 0 && total_vertices >= VERTICES_PER_CHUNK)
+				} else if (parent->mergeable_count_ > 0 && total_vertices >= this->config_.vertices_per_chunk)
 				{
 					// chunk was previously marked as being mergable, but it got some vertices, so it is NOT mergeable
 
@@ -132,77 +254,152 @@ void DestructibleMap::update_batches()
 					}
 				}
 			}
-#endif
+
 			DestructibleMapDrawingBatch *batch = nullptr;
 			if (chunk->get_batch_info())
 			{
+				ProfileScope dealloc_scope(STAGE_BATCH_UPDATE);
 				auto info = chunk->get_batch_info();
 				batch = info->batch;
 
 				batch->dealloc_chunk(chunk);
-				if (!batch->is_free(chunk->vertices_.size())) {
+				if (!batch->is_free(chunk->get_batch_size())) {
 					batch = nullptr;
 				}
 			}
 
-#ifdef ENABLE_MERGING_SUBDIVIDING
-			if (chunk->vertices_.size() >= VERTICES_PER_CHUNK)
+			// only a chunk which does not fit into a batch has to be subdivided right away, the others wait for run_maintenance.
+			// It cannot be drawn otherwise (its mesh may even be cut off at MAX_MESH_VERTICES), so this happens without merging/subdividing as well
+			const auto subdivide = chunk->get_batch_size() >= this->config_.vertices_per_batch;
+			if (!subdivide && this->config_.enable_merging_subdividing && chunk->get_num_indices() >= this->config_.vertices_per_chunk)
 			{
+				this->deferred_subdivisions_.push_back({ chunk->get_num_indices() - this->config_.vertices_per_chunk, chunk, chunk->version_, false });
+			}
+
+			if (subdivide)
+			{
+				ProfileScope subdivide_scope(STAGE_MERGE_SUBDIVIDE);
 				chunk->subdivide();
+				map_profiler.count(COUNTER_CHUNK_SUBDIVIDED);
 			}
 			else
-#endif
 			{
+				ProfileScope alloc_scope(STAGE_BATCH_UPDATE);
 				if (batch == nullptr) {
-					for (auto &batch_candidate : this->batches_)
-					{
-						if (batch_candidate->is_free(chunk->vertices_.size()))
-						{
-							batch = batch_candidate;
-							break;
-						}
-					}
+					batch = this->find_batch(chunk);
 				}
 
 				if (batch == nullptr)
 				{
-					batch = new DestructibleMapDrawingBatch();
-					batch->init();
-					this->batches_.push_back(batch);
+					batch = this->create_batch();
 				}
 
+				const auto was_empty = batch->infos_.empty();
 				batch->alloc_chunk(chunk);
+				if (was_empty)
+				{
+					this->update_morton_index(batch, chunk);
+				}
 			}
 		}
 	}
+}
+
+void DestructibleMap::run_maintenance(long long budget_nanoseconds)
+{
+	auto &maintenance = this->maintenance_;
+	maintenance.clear();
+
+	// chunks which changed since they were deferred are checked again by the loop over the dirty chunks
+	for (auto &deferred : this->deferred_subdivisions_)
+	{
+		if (deferred.chunk->version_ == deferred.version)
+		{
+			maintenance.push_back(deferred);
+		}
+	}
+	this->deferred_subdivisions_.clear();
 
-	// merge parents
+	this->mergeable_chunks_.clear();
+	this->quad_tree_.query_mergeable(this->mergeable_chunks_);
+	for (auto parent : this->mergeable_chunks_)
+	{
+		auto total_vertices = parent->north_west_->get_num_indices() + parent->north_east_->get_num_indices() + parent->south_west_->get_num_indices() + parent->south_east_->get_num_indices();
+		maintenance.push_back({ this->config_.vertices_per_chunk - int(total_vertices), parent, parent->version_, true });
+	}
 
-#ifdef ENABLE_MERGING_SUBDIVIDING
-	auto mergeable = this->quad_tree_.get_best_mergeable();
-	if (mergeable != nullptr)
+	if (maintenance.empty())
 	{
-		mergeable->merge();
+		return;
 	}
-#endif
 
-	//std::cout << "Time " << (glfwGetTime() - time) * 1000 << std::endl;
+	// stable, so equal benefits keep the order of the quad tree and the result does not depend on the addresses of the chunks
+	std::stable_sort(maintenance.begin(), maintenance.end(), [](const DestructibleMapMaintenance &a, const DestructibleMapMaintenance &b)
+	{
+		return a.benefit > b.benefit;
+	});
+
+	ProfileScope merge_scope(STAGE_MERGE_SUBDIVIDE);
+	const auto begin = get_nanoseconds();
+	for (size_t i = 0; i < maintenance.size(); i++)
+	{
+		// at least one per frame, so even a tiny budget makes progress
+		if (budget_nanoseconds > 0 && i > 0 && get_nanoseconds() - begin >= budget_nanoseconds)
+		{
+			// the merges are found again by their mergeable count
+			for (auto j = i; j < maintenance.size(); j++)
+			{
+				if (!maintenance[j].merge)
+				{
+					this->deferred_subdivisions_.push_back(maintenance[j]);
+				}
+			}
+			map_profiler.count(COUNTER_MAINTENANCE_DEFERRED, maintenance.size() - i);
+			return;
+		}
+
+		// a merge earlier in the frame may have released the chunk, or the same chunk was deferred twice
+		auto chunk = maintenance[i].chunk;
+		if (chunk->version_ != maintenance[i].version)
+		{
+			continue;
+		}
+
+		if (maintenance[i].merge)
+		{
+			chunk->merge();
+			map_profiler.count(COUNTER_CHUNK_MERGED);
+		}
+		else
+		{
+			// the chunk is turned into an inner chunk, its children are placed by the loop over the dirty chunks
+			if (chunk->get_batch_info())
+			{
+				chunk->get_batch_info()->batch->dealloc_chunk(chunk);
+			}
+			chunk->subdivide();
+			map_profiler.count(COUNTER_CHUNK_SUBDIVIDED);
+		}
+	}
 }
 
-void DestructibleMap::generate_map(int num_rects, int num_circle, int width, int height, int min_size, int max_size)
+void DestructibleMap::generate_map(int num_rects, int num_circle, int width, int height, int min_size, int max_size, unsigned int seed)
 {
-	this->start_time_ = glfwGetTime();
+	this->start_time_ = get_time();
 
 	std::cout << "Generate Map" << std::endl;
 
+	this->seed_ = seed;
+	std::mt19937 engine(seed);
+
 	ClipperLib::Paths paths;
 
 	for (auto i = 0; i < num_rects; i++)
 	{
-		auto pos_x = rand() % width;
-		auto pos_y = rand() % height;
-		auto w = min_size + rand() % (max_size - min_size);
-		auto h = min_size + rand() % (max_size - min_size);
+		auto pos_x = engine() % width;
+		auto pos_y = engine() % height;
+		auto w = min_size + engine() % (max_size - min_size);
+		auto h = min_size + engine() % (max_size - min_size);
 		paths.push_back(make_rect(
 			glm::ivec2(pos_x*SCALE_FACTOR, pos_y*SCALE_FACTOR),
 			glm::ivec2(w*SCALE_FACTOR, h*SCALE_FACTOR)
@@ -211,9 +408,9 @@ void DestructibleMap::generate_map(int num_rects, int num_circle, int width, int
 
 	for (auto i = 0; i < num_circle; i++)
 	{
-		auto pos_x = rand() % width;
-		auto pos_y = rand() % height;
-		auto radius = min_size + rand() % (max_size - min_size);
+		auto pos_x = engine() % width;
+		auto pos_y = engine() % height;
+		auto radius = min_size + engine() % (max_size - min_size);
 		paths.push_back(make_circle(
 			glm::ivec2(pos_x*SCALE_FACTOR, pos_y*SCALE_FACTOR),
 			radius*SCALE_FACTOR,
@@ -224,153 +421,1280 @@ void DestructibleMap::generate_map(int num_rects, int num_circle, int width, int
 	this->load(paths);
 }
 
+namespace
+{
+	const char snapshot_magic[8] = { 'D', 'M', 'S', 'N', 'A', 'P', '\r', '\n' };
+
+	uint64_t align_snapshot_offset(uint64_t offset)
+	{
+		return (offset + 7) & ~uint64_t(7);
+	}
+
+	bool is_valid_snapshot_section(const DestructibleMapMappedFile &file, uint64_t offset, uint64_t count, size_t element_size)
+	{
+		return offset % 8 == 0 && offset <= file.get_size() && count <= (file.get_size() - offset) / element_size;
+	}
+
+	void write_snapshot_section(std::vector<char> &data, const void *section, uint64_t size)
+	{
+		data.insert(data.end(), static_cast<const char*>(section), static_cast<const char*>(section) + size);
+		data.resize(align_snapshot_offset(data.size()));
+	}
+}
 
-void DestructibleMap::init(RenderingEngine* rendering_engine)
+bool DestructibleMap::save_snapshot(const char *file_name) const
 {
-	this->rendering_engine_ = rendering_engine;
+	if (this->quad_tree_.config_ == nullptr)
+	{
+		std::cout << "No map to save" << std::endl;
+		return false;
+	}
 
-	this->update_quadtree_representation();
+	std::vector<char> data;
+	this->write_snapshot(data);
 
-	this->point_distribution_resource_->init();
+	std::ofstream stream(file_name, std::ios::binary | std::ios::trunc);
+	stream.write(data.data(), data.size());
+	stream.close();
+
+	if (!stream)
+	{
+		std::cout << "Could not write snapshot " << file_name << std::endl;
+		return false;
+	}
+	return true;
+}
 
-	glPointSize(8);
+void DestructibleMap::write_snapshot(std::vector<char> &data) const
+{
+	std::vector<DestructibleMapSnapshotNode> nodes;
+	std::vector<uint32_t> path_sizes;
+	std::vector<int64_t> path_points;
+	std::vector<glm::vec2> vertices;
+	std::vector<uint16_t> indices;
+	ClipperLib::Paths paths;
+	DestructibleMapMesh paged_mesh;
 
-	for (auto i = 0; i < NUM_START_BATCHES; i++)
+	// pre order, the children are pushed in reverse so north west comes out first
+	std::vector<const DestructibleMapChunk*> stack;
+	stack.push_back(&this->quad_tree_);
+	while (!stack.empty())
 	{
-		auto batch = new DestructibleMapDrawingBatch();
-		batch->init();
-		this->batches_.push_back(batch);
+		const auto chunk = stack.back();
+		stack.pop_back();
+
+		DestructibleMapSnapshotNode node = {};
+		node.begin[0] = chunk->begin_.x;
+		node.begin[1] = chunk->begin_.y;
+		node.end[0] = chunk->end_.x;
+		node.end[1] = chunk->end_.y;
+		if (chunk->north_west_)
+		{
+			node.has_children = 1;
+			stack.push_back(chunk->south_east_);
+			stack.push_back(chunk->south_west_);
+			stack.push_back(chunk->north_east_);
+			stack.push_back(chunk->north_west_);
+		}
+		else
+		{
+			// paged out leaves are read into a copy, the map stays as it is
+			auto leaf_vertices = chunk->get_vertices();
+			auto num_leaf_vertices = chunk->get_num_vertices();
+			auto leaf_indices = chunk->get_indices();
+			auto num_leaf_indices = chunk->get_num_indices();
+			if (chunk->paged_out_)
+			{
+				if (!this->pager_->read(chunk->page_, this->get_page_origin(chunk), paths))
+				{
+					std::cout << "Could not read a paged out leaf, it is missing in the snapshot" << std::endl;
+				}
+				this->pager_->triangulate(paths, paged_mesh);
+				leaf_vertices = paged_mesh.vertices.data();
+				num_leaf_vertices = int(paged_mesh.vertices.size());
+				leaf_indices = paged_mesh.indices.data();
+				num_leaf_indices = int(paged_mesh.indices.size());
+			}
+			else
+			{
+				chunk->get_paths(paths);
+			}
+
+			node.num_paths = paths.size();
+			for (auto &path : paths)
+			{
+				path_sizes.push_back(path.size());
+				for (auto &point : path)
+				{
+					path_points.push_back(point.X);
+					path_points.push_back(point.Y);
+				}
+			}
+
+			node.num_vertices = num_leaf_vertices;
+			vertices.insert(vertices.end(), leaf_vertices, leaf_vertices + num_leaf_vertices);
+			node.num_indices = num_leaf_indices;
+			indices.insert(indices.end(), leaf_indices, leaf_indices + num_leaf_indices);
+		}
+		nodes.push_back(node);
 	}
+
+	DestructibleMapSnapshotHeader header = {};
+	memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.vertex_size = sizeof(glm::vec2);
+	header.scale_factor = SCALE_FACTOR;
+	header.seed = this->seed_;
+	header.vertices_per_batch = this->config_.vertices_per_batch;
+	header.vertices_per_chunk = this->config_.vertices_per_chunk;
+	header.triangulation_buffer = this->config_.triangulation_buffer;
+	header.merging_subdividing = this->config_.enable_merging_subdividing;
+	header.triangle_area_ratio = this->config_.triangle_area_ratio;
+	header.points_per_leaf_ratio = this->config_.points_per_leaf_ratio;
+	header.num_nodes = nodes.size();
+	header.num_paths = path_sizes.size();
+	header.num_path_points = path_points.size() / 2;
+	header.num_vertices = vertices.size();
+	header.num_indices = indices.size();
+	header.num_points = this->points_.size();
+	header.nodes_offset = align_snapshot_offset(sizeof(header));
+	header.path_sizes_offset = header.nodes_offset + align_snapshot_offset(nodes.size() * sizeof(DestructibleMapSnapshotNode));
+	header.path_points_offset = header.path_sizes_offset + align_snapshot_offset(path_sizes.size() * sizeof(uint32_t));
+	header.vertices_offset = header.path_points_offset + align_snapshot_offset(path_points.size() * sizeof(int64_t));
+	header.indices_offset = header.vertices_offset + align_snapshot_offset(vertices.size() * sizeof(glm::vec2));
+	header.points_offset = header.indices_offset + align_snapshot_offset(indices.size() * sizeof(uint16_t));
+
+	data.clear();
+	data.reserve(header.points_offset + align_snapshot_offset(this->points_.size() * sizeof(glm::vec2)));
+	write_snapshot_section(data, &header, sizeof(header));
+	write_snapshot_section(data, nodes.data(), nodes.size() * sizeof(DestructibleMapSnapshotNode));
+	write_snapshot_section(data, path_sizes.data(), path_sizes.size() * sizeof(uint32_t));
+	write_snapshot_section(data, path_points.data(), path_points.size() * sizeof(int64_t));
+	write_snapshot_section(data, vertices.data(), vertices.size() * sizeof(glm::vec2));
+	write_snapshot_section(data, indices.data(), indices.size() * sizeof(uint16_t));
+	write_snapshot_section(data, this->points_.data(), this->points_.size() * sizeof(glm::vec2));
 }
 
-void DestructibleMap::draw()
+bool DestructibleMap::load_snapshot(const char *file_name)
 {
-	map_draw_calls = 0;
+	this->start_time_ = get_time();
 
-	update_batches();
+	std::cout << "Load Snapshot" << std::endl;
+
+	auto file = new DestructibleMapMappedFile();
+	if (!file->open(file_name))
+	{
+		std::cout << "Could not open snapshot " << file_name << std::endl;
+		delete file;
+		return false;
+	}
 
-	this->map_shader_->use();
-	this->map_shader_->set_camera_uniforms(this->rendering_engine_->get_view_matrix(), this->rendering_engine_->get_projection_matrix());
-	this->map_shader_->set_base_color(glm::vec3(1.0, 0.0, 0.0));
+	// everything is checked before the quad tree is touched, so a broken file leaves the map as it was
+	DestructibleMapSnapshotHeader header;
+	auto valid = file->get_size() >= sizeof(header);
+	if (valid)
+	{
+		memcpy(&header, file->get_data(), sizeof(header));
+		valid = memcmp(header.magic, snapshot_magic, sizeof(header.magic)) == 0 &&
+			header.version == SNAPSHOT_VERSION &&
+			header.vertex_size == sizeof(glm::vec2) &&
+			header.scale_factor == SCALE_FACTOR &&
+			header.num_nodes > 0 &&
+			is_valid_snapshot_section(*file, header.nodes_offset, header.num_nodes, sizeof(DestructibleMapSnapshotNode)) &&
+			is_valid_snapshot_section(*file, header.path_sizes_offset, header.num_paths, sizeof(uint32_t)) &&
+			is_valid_snapshot_section(*file, header.path_points_offset, header.num_path_points, 2 * sizeof(int64_t)) &&
+			is_valid_snapshot_section(*file, header.vertices_offset, header.num_vertices, sizeof(glm::vec2)) &&
+			is_valid_snapshot_section(*file, header.indices_offset, header.num_indices, sizeof(uint16_t)) &&
+			is_valid_snapshot_section(*file, header.points_offset, header.num_points, sizeof(glm::vec2));
+	}
 
-	glBindVertexArray(this->quadtree_resource_->get_resource_id());
-	glDrawArrays(GL_LINES, 0, this->lines_.size());
+	const auto data = file->get_data();
+	const auto nodes = reinterpret_cast<const DestructibleMapSnapshotNode*>(data + header.nodes_offset);
+	const auto path_sizes = reinterpret_cast<const uint32_t*>(data + header.path_sizes_offset);
+	const auto path_points = reinterpret_cast<const int64_t*>(data + header.path_points_offset);
+	const auto vertices = reinterpret_cast<const glm::vec2*>(data + header.vertices_offset);
+	const auto indices = reinterpret_cast<const uint16_t*>(data + header.indices_offset);
+	const auto points = reinterpret_cast<const glm::vec2*>(data + header.points_offset);
 
-	if (glfwGetKey(this->rendering_engine_->get_window(), GLFW_KEY_3)) {
-		glBindVertexArray(this->point_distribution_resource_->get_resource_id());
-		glDrawArrays(GL_POINTS, 0, this->points_.size());
+	if (valid)
+	{
+		// every node which is still missing is the root of a subtree, the counts of the leaves have to add up to the sections
+		uint64_t missing_nodes = 1;
+		uint64_t num_paths = 0;
+		uint64_t num_path_points = 0;
+		uint64_t num_vertices = 0;
+		uint64_t num_indices = 0;
+		for (uint64_t i = 0; i < header.num_nodes && valid; i++)
+		{
+			const auto &node = nodes[i];
+			valid = missing_nodes > 0 && node.begin[0] < node.end[0] && node.begin[1] < node.end[1];
+			missing_nodes += node.has_children ? 3 : -1;
+			num_paths += node.num_paths;
+			num_vertices += node.num_vertices;
+			num_indices += node.num_indices;
+			valid = valid && num_paths <= header.num_paths && num_vertices <= header.num_vertices && num_indices <= header.num_indices &&
+				node.num_vertices <= MAX_MESH_VERTICES && node.num_indices % 3 == 0;
+
+			// the indices are used as they are, so each has to stay inside of the vertices of its leaf
+			for (auto index = num_indices - node.num_indices; index < num_indices && valid; index++)
+			{
+				valid = indices[index] < node.num_vertices;
+			}
+		}
+		for (uint64_t i = 0; i < header.num_paths && valid; i++)
+		{
+			num_path_points += path_sizes[i];
+		}
+		valid = valid && missing_nodes == 0 && num_paths == header.num_paths && num_vertices == header.num_vertices && num_indices == header.num_indices && num_path_points == header.num_path_points;
 	}
 
-	if (glfwGetKey(this->rendering_engine_->get_window(), GLFW_KEY_1))
+	if (!valid)
 	{
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-	} else
+		std::cout << "Invalid snapshot " << file_name << std::endl;
+		delete file;
+		return false;
+	}
+
+	if (header.vertices_per_batch != this->config_.vertices_per_batch || header.vertices_per_chunk != this->config_.vertices_per_chunk ||
+		header.triangulation_buffer != this->config_.triangulation_buffer || header.merging_subdividing != uint32_t(this->config_.enable_merging_subdividing) ||
+		header.triangle_area_ratio != this->config_.triangle_area_ratio || header.points_per_leaf_ratio != this->config_.points_per_leaf_ratio)
 	{
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		std::cout << "Snapshot " << file_name << " was written with another configuration" << std::endl;
+		delete file;
+		return false;
 	}
 
-	this->map_shader_->set_base_color(glm::vec3(0.0, 1.0, 0.0));
-	auto time = glfwGetTime();
-	for (auto &batch : batches_)
+	this->seed_ = header.seed;
+	this->points_.assign(points, points + header.num_points);
+
+	const auto &root = nodes[0];
+	this->quad_tree_ = DestructibleMapChunk(&this->config_, &this->chunk_pool_, nullptr, glm::vec2(root.begin[0], root.begin[1]), glm::vec2(root.end[0], root.end[1]));
+
+	// same pre order as save_snapshot, the children get their cells from their parent
+	uint64_t node_index = 0;
+	uint64_t path_index = 0;
+	uint64_t point_index = 0;
+	uint64_t vertex_index = 0;
+	uint64_t index_index = 0;
+	ClipperLib::Paths paths;
+	std::vector<DestructibleMapChunk*> stack;
+	stack.push_back(&this->quad_tree_);
+	while (!stack.empty())
 	{
-		
-		for (auto &info : batch->infos_)
+		const auto chunk = stack.back();
+		stack.pop_back();
+
+		const auto &node = nodes[node_index++];
+		if (node.has_children)
+		{
+			chunk->create_children();
+			stack.push_back(chunk->south_east_);
+			stack.push_back(chunk->south_west_);
+			stack.push_back(chunk->north_east_);
+			stack.push_back(chunk->north_west_);
+			continue;
+		}
+
+		paths.resize(node.num_paths);
+		for (auto &path : paths)
 		{
-			if (info->chunk != nullptr && info->chunk->highlighted_)
+			path.resize(path_sizes[path_index++]);
+			for (auto &point : path)
 			{
-				this->map_shader_->set_base_color(glm::vec3(1.0, 1.0, 0.0));
+				point.X = path_points[point_index * 2];
+				point.Y = path_points[point_index * 2 + 1];
+				point_index++;
 			}
 		}
+		chunk->paths_.assign(paths);
 
-		batch->draw(this->map_shader_);
-
-		this->map_shader_->set_base_color(glm::vec3(0.0, 1.0, 0.0));
+		// the mesh stays in the file until the leaf is triangulated again
+		if (node.num_indices > 0)
+		{
+			chunk->mapped_vertices_ = vertices + vertex_index;
+			chunk->num_mapped_vertices_ = int(node.num_vertices);
+			chunk->mapped_indices_ = indices + index_index;
+			chunk->num_mapped_indices_ = int(node.num_indices);
+			chunk->mark_mesh_dirty();
+		}
+		vertex_index += node.num_vertices;
+		index_index += node.num_indices;
 	}
-	//std::cout << "Time: " << (glfwGetTime() - time) * 1000 << std::endl;
 
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	delete this->snapshot_;
+	this->snapshot_ = file;
+	return true;
+}
+
 
-	glBindVertexArray(0);
+void DestructibleMap::init(IBatchBackend *backend)
+{
+	if (backend == nullptr)
+	{
+		backend = new RecordingBatchBackend();
+		this->owns_backend_ = true;
+	}
+	this->backend_ = backend;
 
-	if (!startup_displayed_)
+	for (auto i = 0; i < this->config_.num_start_batches; i++)
 	{
-		std::cout << "Time from loading until first frame " << (glfwGetTime() - this->start_time_) << std::endl;
-		this->startup_displayed_ = true;
+		this->create_batch();
 	}
 }
 
-void DestructibleMap::apply_polygon_operation(const ClipperLib::Path polygon, ClipperLib::ClipType clip_type)
+DestructibleMapDrawingBatch *DestructibleMap::create_batch()
 {
-	double time = glfwGetTime();
-	glm::ivec2 begin, end;
+	auto batch = new DestructibleMapDrawingBatch(this->config_.vertices_per_batch);
+	batch->init(this->backend_);
+	batch->set_free_index(&this->batch_free_index_, this->batches_.size());
+	this->batches_.push_back(batch);
+	this->batch_morton_keys_.push_back(std::make_pair(false, 0u));
+	return batch;
+}
 
-	get_bounding_box(polygon, begin, end);
+unsigned int DestructibleMap::get_morton_code(const DestructibleMapChunk *chunk) const
+{
+	return morton_code((chunk->begin_ + chunk->end_) * 0.5f, this->quad_tree_.begin_, this->quad_tree_.end_);
+}
 
-	std::vector<DestructibleMapChunk*> affected_leaves;
-	this->quad_tree_.query_range(glm::vec2(begin) * SCALE_FACTOR_INV, glm::vec2(end) * SCALE_FACTOR_INV, affected_leaves);
+glm::ivec2 DestructibleMap::get_page_origin(const DestructibleMapChunk *chunk) const
+{
+	return glm::ivec2(chunk->begin_ * SCALE_FACTOR);
+}
 
-#pragma omp parallel for
-	for (auto i = 0; i < affected_leaves.size(); i++)
+DestructibleMapDrawingBatch *DestructibleMap::find_nearby_batch(const DestructibleMapChunk *chunk) const
+{
+	// the batches started next to the chunk (in Morton order) are checked in both directions
+	const auto num_vertices = chunk->get_batch_size();
+	const auto key = this->get_morton_code(chunk);
+	auto after = this->batch_morton_index_.lower_bound(key);
+	auto before = after;
+	for (auto i = 0; i < MORTON_NEIGHBOUR_BATCHES; i++)
 	{
-		auto &leave = affected_leaves[i];
+		if (after != this->batch_morton_index_.end())
+		{
+			if (this->batches_[after->second]->is_free(num_vertices))
+			{
+				return this->batches_[after->second];
+			}
+			++after;
+		}
+		if (before != this->batch_morton_index_.begin())
+		{
+			--before;
+			if (this->batches_[before->second]->is_free(num_vertices))
+			{
+				return this->batches_[before->second];
+			}
+		}
+	}
+	return nullptr;
+}
 
-		ClipperLib::PolyTree result_poly_tree;
-		ClipperLib::Paths path_inside_bounds;
-		ClipperLib::Clipper c;
-		c.StrictlySimple(true);
-		c.AddPath(polygon, ClipperLib::ptSubject, true);
-		c.AddPath(leave->quad_, ClipperLib::ptClip, true);
+void DestructibleMap::update_morton_index(DestructibleMapDrawingBatch *batch, const DestructibleMapChunk *chunk)
+{
+	// a batch is located where its first chunk is
+	auto &key = this->batch_morton_keys_[batch->index_];
+	if (key.first)
+	{
+		const auto range = this->batch_morton_index_.equal_range(key.second);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second == batch->index_)
+			{
+				this->batch_morton_index_.erase(it);
+				break;
+			}
+		}
+	}
+	key = std::make_pair(true, this->get_morton_code(chunk));
+	this->batch_morton_index_.insert(std::make_pair(key.second, batch->index_));
+}
 
-		if (clip_type == ClipperLib::ctIntersection)
+DestructibleMapDrawingBatch *DestructibleMap::find_batch(const DestructibleMapChunk *chunk) const
+{
+	const int num_vertices = chunk->get_batch_size();
+	if (this->config_.spatial_batch_packing)
+	{
+		// only batches close to the chunk or empty ones are used, so no batch gets stretched over the whole map
+		const auto batch = this->find_nearby_batch(chunk);
+		if (batch != nullptr)
 		{
-			c.AddPaths(leave->paths_, ClipperLib::ptClip, true);
+			return batch;
+		}
 
-			ClipperLib::Paths result_paths;
+		const auto empty = this->batch_free_index_.lower_bound(std::make_pair(this->config_.vertices_per_batch, 0));
+		return empty != this->batch_free_index_.end() ? this->batches_[empty->second] : nullptr;
+	}
 
-			ClipperLib::PolyTreeToPaths(result_poly_tree, result_paths);
+	if (this->config_.batch_free_index)
+	{
+		// best fit: the batch with the smallest biggest free range which is still big enough
+		const auto it = this->batch_free_index_.upper_bound(std::make_pair(num_vertices, INT_MAX));
+		return it != this->batch_free_index_.end() ? this->batches_[it->second] : nullptr;
+	}
 
-			leave->set_paths(result_paths, result_poly_tree, true);
+	for (auto &batch : this->batches_)
+	{
+		if (batch->is_free(num_vertices))
+		{
+			return batch;
 		}
-		else {
-			if (!c.Execute(ClipperLib::ctIntersection, path_inside_bounds, ClipperLib::pftNonZero))
-			{
-				std::cout << "Could not create Polygon Tree" << std::endl;
-			}
+	}
+	return nullptr;
+}
 
-			if (path_inside_bounds.size() == 0)
-			{
-				continue;
-			}
+void DestructibleMap::draw()
+{
+	map_draw_calls = 0;
+	map_uploaded_bytes = 0;
+	map_culled_batches = 0;
 
-			c.Clear();
-			c.AddPaths(leave->paths_, ClipperLib::ptSubject, true);
-			c.AddPaths(path_inside_bounds, ClipperLib::ptClip, true);
-			if (!c.Execute(clip_type, result_poly_tree, ClipperLib::pftNonZero))
-			{
-				std::cout << "Could not create Polygon Tree" << std::endl;
-			}
+	update_batches();
+
+	for (auto &batch : batches_)
+	{
+		batch->draw();
+	}
+	map_draw_calls += this->backend_->flush();
+}
 
-			ClipperLib::Paths result_paths;
+void DestructibleMap::draw(const DestructibleMapFrustum &frustum)
+{
+	map_draw_calls = 0;
+	map_uploaded_bytes = 0;
+	map_culled_batches = 0;
 
-			ClipperLib::PolyTreeToPaths(result_poly_tree, result_paths);
+	update_batches();
 
-			leave->set_paths(result_paths, result_poly_tree, true);
+	for (auto &batch : batches_)
+	{
+		// culled batches keep their pending upload until they are visible again
+		if (!batch->is_visible(frustum))
+		{
+			map_culled_batches++;
+			continue;
 		}
+		batch->draw();
 	}
+	map_draw_calls += this->backend_->flush();
+}
+
+void DestructibleMap::draw(const glm::mat4 &view_projection, const glm::vec2 &viewport_size)
+{
+	map_draw_calls = 0;
+	map_uploaded_bytes = 0;
+	map_culled_batches = 0;
+
+	update_batches();
 
-	//std::cout << "Time: " << (glfwGetTime() - time) * 1000 << std::endl;
+	this->draw_lod_chunks(view_projection, viewport_size);
+	map_draw_calls += this->backend_->flush();
 }
 
+void DestructibleMap::draw_lod_chunks(const glm::mat4 &view_projection, const glm::vec2 &viewport_size)
+{
+	this->draw_lod_chunks(&this->quad_tree_, extract_frustum(view_projection), view_projection, viewport_size);
+}
 
-void DestructibleMap::update_quadtree_representation()
+void DestructibleMap::draw_lod_chunks(DestructibleMapChunk *chunk, const DestructibleMapFrustum &frustum, const glm::mat4 &view_projection, const glm::vec2 &viewport_size)
 {
-	this->lines_.clear();
-	this->quad_tree_.get_lines(this->lines_);
+	if (!is_box_visible(frustum, chunk->begin_, chunk->end_))
+	{
+		return;
+	}
+
+	if (chunk->north_west_ != nullptr && this->config_.lod_pixels > 0.0f && get_projected_size(view_projection, viewport_size, chunk->begin_, chunk->end_) < this->config_.lod_pixels)
+	{
+		// built lazily, only if a leaf below changed since the chunk was drawn like this the last time. While a leaf below is paged out
+		// the children are drawn instead, as is a level of detail which does not fit into a batch (not simplified enough)
+		if (chunk->update_lod() && chunk->get_batch_size() < this->config_.vertices_per_batch)
+		{
+			if (chunk->get_batch_info() == nullptr && chunk->get_num_indices() > 0)
+			{
+				ProfileScope batch_scope(STAGE_BATCH_UPDATE);
+				this->find_lod_batch(chunk->get_batch_size())->alloc_chunk(chunk);
+			}
+			if (chunk->get_batch_info() != nullptr)
+			{
+				chunk->get_batch_info()->batch->draw_chunk(chunk->get_batch_info());
+			}
+			map_profiler.count(COUNTER_LOD_DRAWN);
+			return;
+		}
+	}
 
-	if (this->quadtree_resource_)
+	if (chunk->north_west_ != nullptr)
 	{
-		delete this->quadtree_resource_;
+		this->draw_lod_chunks(chunk->north_west_, frustum, view_projection, viewport_size);
+		this->draw_lod_chunks(chunk->north_east_, frustum, view_projection, viewport_size);
+		this->draw_lod_chunks(chunk->south_west_, frustum, view_projection, viewport_size);
+		this->draw_lod_chunks(chunk->south_east_, frustum, view_projection, viewport_size);
 	}
-	this->quadtree_resource_ = new MeshResource(this->lines_);
-	this->quadtree_resource_->init();
+	else if (chunk->get_batch_info() != nullptr)
+	{
+		chunk->get_batch_info()->batch->draw_chunk(chunk->get_batch_info());
+	}
+}
+
+DestructibleMapDrawingBatch *DestructibleMap::find_lod_batch(int num_vertices)
+{
+	for (auto &batch : this->lod_batches_)
+	{
+		if (batch->is_free(num_vertices))
+		{
+			return batch;
+		}
+	}
+
+	auto batch = new DestructibleMapDrawingBatch(this->config_.vertices_per_batch);
+	batch->init(this->backend_);
+	this->lod_batches_.push_back(batch);
+	return batch;
+}
+
+enum RunClassification
+{
+	RUN_SKIP,
+	RUN_EMPTY,
+	RUN_FILL,
+	RUN_CLIP
+};
+
+// decides if a run of brushes (already clipped to the quad of the leaf) needs a boolean operation with the paths of the leaf
+RunClassification classify_run(const ClipperLib::Paths &brushes, const ClipperLib::Paths &leaf_paths, double quad_area, ClipperLib::ClipType clip_type)
+{
+	// a brush clipped to the quad only has the area of the quad if it covers the whole quad
+	auto covers_quad = false;
+	for (auto &brush : brushes)
+	{
+		covers_quad = covers_quad || abs(ClipperLib::Area(brush)) >= quad_area;
+	}
+
+	if (covers_quad)
+	{
+		switch (clip_type)
+		{
+		case ClipperLib::ctDifference:
+			return leaf_paths.empty() ? RUN_SKIP : RUN_EMPTY;
+		case ClipperLib::ctUnion:
+			return leaf_paths.size() == 1 && abs(ClipperLib::Area(leaf_paths[0])) >= quad_area ? RUN_SKIP : RUN_FILL;
+		case ClipperLib::ctIntersection:
+			return RUN_SKIP;
+		default:
+			return RUN_CLIP;
+		}
+	}
+
+	// removing something where nothing is does not change the leaf
+	if (clip_type == ClipperLib::ctDifference)
+	{
+		if (leaf_paths.empty())
+		{
+			return RUN_SKIP;
+		}
+
+		glm::ivec2 brushes_begin(INT_MAX, INT_MAX), brushes_end(INT_MIN, INT_MIN);
+		for (auto &brush : brushes)
+		{
+			glm::ivec2 path_begin, path_end;
+			get_bounding_box(brush, path_begin, path_end);
+			brushes_begin = glm::min(brushes_begin, path_begin);
+			brushes_end = glm::max(brushes_end, path_end);
+		}
+		for (auto &path : leaf_paths)
+		{
+			glm::ivec2 path_begin, path_end;
+			get_bounding_box(path, path_begin, path_end);
+			if (path_end.x > brushes_begin.x && path_end.y > brushes_begin.y && path_begin.x < brushes_end.x && path_begin.y < brushes_end.y)
+			{
+				return RUN_CLIP;
+			}
+		}
+		return RUN_SKIP;
+	}
+
+	return RUN_CLIP;
+}
+
+void orient_polygon(ClipperLib::Path &polygon)
+{
+	if (!ClipperLib::Orientation(polygon))
+	{
+		ClipperLib::ReversePath(polygon);
+	}
+}
+
+DestructibleMapLeafClip clip_leaf(ClipperContext &context, const ClipperLib::Path &quad, const std::vector<DestructibleMapOperation> &operations, const std::vector<int> &indices, bool incremental)
+{
+	auto &result_poly_tree = context.poly_tree;
+	auto &result_paths = context.paths;
+	auto &run_polygons = context.subject_paths;
+	auto &path_inside_bounds = context.clip_paths;
+	auto &c = context.clipper;
+	c.StrictlySimple(true);
+	auto poly_tree_outdated = false;
+	const auto quad_area = abs(ClipperLib::Area(quad));
+
+	// region which has been touched by the operations, an intersection changes everything outside of it
+	DestructibleMapLeafClip clip;
+	clip.changed = false;
+	clip.incremental = incremental;
+	clip.modified_begin = glm::ivec2(INT_MAX, INT_MAX);
+	clip.modified_end = glm::ivec2(INT_MIN, INT_MIN);
+
+	for (auto begin = 0; begin < indices.size();)
+	{
+		// consecutive unions/differences are combined into one run, since P op A op B = P op (A u B)
+		const auto clip_type = operations[indices[begin]].clip_type;
+		const auto mergeable = clip_type == ClipperLib::ctUnion || clip_type == ClipperLib::ctDifference;
+		auto end = begin + 1;
+		while (mergeable && end < indices.size() && operations[indices[end]].clip_type == clip_type)
+		{
+			end++;
+		}
+
+		run_polygons.clear();
+		for (auto j = begin; j < end; j++)
+		{
+			run_polygons.push_back(operations[indices[j]].polygon);
+		}
+		begin = end;
+
+		ProfileScope clip_scope(STAGE_CLIP);
+		// overlapping polygons of a run are combined by the non zero filling of the next operation
+		clip_paths_to_rect(run_polygons, quad, path_inside_bounds);
+
+		if (path_inside_bounds.size() == 0)
+		{
+			if (clip_type == ClipperLib::ctIntersection && !result_paths.empty())
+			{
+				result_paths.clear();
+				result_poly_tree.Clear();
+				poly_tree_outdated = false;
+				clip.changed = true;
+				clip.incremental = false;
+				map_profiler.count(COUNTER_LEAF_EMPTIED);
+			}
+			else
+			{
+				map_profiler.count(COUNTER_LEAF_SKIPPED);
+			}
+			continue;
+		}
+
+		// trivial cases are decided without a boolean operation
+		const auto run = classify_run(path_inside_bounds, result_paths, quad_area, clip_type);
+		if (run == RUN_SKIP)
+		{
+			map_profiler.count(COUNTER_LEAF_SKIPPED);
+			continue;
+		}
+		if (run == RUN_EMPTY)
+		{
+			result_paths.clear();
+			result_poly_tree.Clear();
+			poly_tree_outdated = false;
+			clip.changed = true;
+			clip.incremental = false;
+			map_profiler.count(COUNTER_LEAF_EMPTIED);
+			continue;
+		}
+		if (run == RUN_FILL)
+		{
+			result_paths.assign(1, quad);
+			poly_tree_outdated = true;
+			clip.changed = true;
+			clip.incremental = false;
+			map_profiler.count(COUNTER_LEAF_FILLED);
+			continue;
+		}
+		map_profiler.count(COUNTER_LEAF_CLIPPED);
+
+		if (clip_type == ClipperLib::ctIntersection)
+		{
+			clip.incremental = false;
+		}
+		for (auto &path : path_inside_bounds)
+		{
+			glm::ivec2 path_begin, path_end;
+			get_bounding_box(path, path_begin, path_end);
+			clip.modified_begin = glm::min(clip.modified_begin, path_begin);
+			clip.modified_end = glm::max(clip.modified_end, path_end);
+		}
+
+		c.Clear();
+		c.AddPaths(result_paths, ClipperLib::ptSubject, true);
+		c.AddPaths(path_inside_bounds, ClipperLib::ptClip, true);
+		if (!c.Execute(clip_type, result_poly_tree, ClipperLib::pftNonZero))
+		{
+			std::cout << "Could not create Polygon Tree" << std::endl;
+		}
+
+		ClipperLib::PolyTreeToPaths(result_poly_tree, result_paths);
+		poly_tree_outdated = false;
+		clip.changed = true;
+	}
+
+	// a filled quad only got its paths, the tree for triangulation is built once at the end
+	if (clip.changed && poly_tree_outdated)
+	{
+		ProfileScope clip_scope(STAGE_CLIP);
+		c.Clear();
+		c.AddPaths(result_paths, ClipperLib::ptSubject, true);
+		if (!c.Execute(ClipperLib::ctUnion, result_poly_tree, ClipperLib::pftNonZero))
+		{
+			std::cout << "Could not create Polygon Tree" << std::endl;
+		}
+	}
+	return clip;
+}
+
+void DestructibleMap::apply_polygon_operation(const ClipperLib::Path polygon, ClipperLib::ClipType clip_type)
+{
+	DestructibleMapOperation operation;
+	operation.polygon = polygon;
+	operation.clip_type = clip_type;
+	this->apply_polygon_operations(std::vector<DestructibleMapOperation>(1, operation));
+}
+
+void DestructibleMap::group_by_leaf(const std::vector<DestructibleMapOperation> &operations, std::vector<DestructibleMapChunk*> &affected_leaves, std::unordered_map<DestructibleMapChunk*, std::vector<int>> &leaf_operations)
+{
+	ProfileScope range_query_scope(STAGE_RANGE_QUERY);
+	std::vector<DestructibleMapChunk*> leaves;
+	for (auto i = 0; i < operations.size(); i++)
+	{
+		glm::ivec2 begin, end;
+		get_bounding_box(operations[i].polygon, begin, end);
+
+		leaves.clear();
+		// an intersection removes everything outside of the polygon, so it reaches every leaf with geometry (resident or paged out),
+		// not only the ones below its bounding box. Leaves which are still empty stay empty, unless an earlier operation of the batch fills them
+		const auto intersection = operations[i].clip_type == ClipperLib::ctIntersection;
+		if (intersection)
+		{
+			this->quad_tree_.query_range(this->quad_tree_.begin_, this->quad_tree_.end_, leaves);
+		}
+		else
+		{
+			this->quad_tree_.query_range(glm::vec2(begin) * SCALE_FACTOR_INV, glm::vec2(end) * SCALE_FACTOR_INV, leaves);
+		}
+
+		for (auto &leave : leaves)
+		{
+			if (intersection && leave->paths_.empty() && (!leave->paged_out_ || leave->page_.size == 0) && leaf_operations.count(leave) == 0)
+			{
+				continue;
+			}
+			auto &indices = leaf_operations[leave];
+			if (indices.empty())
+			{
+				affected_leaves.push_back(leave);
+			}
+			indices.push_back(i);
+		}
+	}
+}
+
+void DestructibleMap::apply_polygon_operations(const std::vector<DestructibleMapOperation> &operations)
+{
+	// submitted operations come first, otherwise a leaf hit by both would get them in another order than the journal recorded them
+	this->finish_pending_operations();
+
+	if (this->journal_ != nullptr)
+	{
+		this->journal_->record(operations);
+	}
+
+	std::vector<DestructibleMapOperation> oriented_operations(operations);
+	for (auto &operation : oriented_operations)
+	{
+		orient_polygon(operation.polygon);
+	}
+
+	// group operations by affected leaf, keeping the order in which they were submitted
+	std::vector<DestructibleMapChunk*> affected_leaves;
+	std::unordered_map<DestructibleMapChunk*, std::vector<int>> leaf_operations;
+	this->group_by_leaf(oriented_operations, affected_leaves, leaf_operations);
+	this->page_in(affected_leaves);
+
+	// each leaf is one task, a leaf only writes to itself
+	map_scheduler.parallel_for(int(affected_leaves.size()), [&](int i)
+	{
+		auto &leave = affected_leaves[i];
+
+		ClipperScope scope;
+		leave->get_paths(scope->paths);
+		leave->get_quad(scope->quad);
+		scope->poly_tree.Clear();
+		const auto clip = clip_leaf(*scope, scope->quad, oriented_operations, leaf_operations.at(leave), this->config_.incremental_triangulation);
+
+		// each touched leaf is triangulated exactly once, no matter how many operations hit it
+		if (clip.changed)
+		{
+			if (clip.incremental)
+			{
+				leave->set_paths_incremental(scope->paths, scope->poly_tree, clip.modified_begin, clip.modified_end);
+			}
+			else
+			{
+				leave->set_paths(scope->paths, scope->poly_tree, true);
+			}
+		}
+	});
+}
+
+void DestructibleMap::submit_polygon_operation(const ClipperLib::Path polygon, ClipperLib::ClipType clip_type)
+{
+	DestructibleMapOperation operation;
+	operation.polygon = polygon;
+	operation.clip_type = clip_type;
+	this->submit_polygon_operations(std::vector<DestructibleMapOperation>(1, operation));
+}
+
+void DestructibleMap::submit_polygon_operations(const std::vector<DestructibleMapOperation> &operations)
+{
+	if (this->journal_ != nullptr)
+	{
+		this->journal_->record(operations);
+	}
+
+	for (auto &operation : operations)
+	{
+		this->pending_operations_.push_back(operation);
+		orient_polygon(this->pending_operations_.back().polygon);
+	}
+
+	if (this->async_modifier_ == nullptr)
+	{
+		this->async_modifier_ = new DestructibleMapAsyncModifier();
+	}
+	if (this->async_job_ == nullptr)
+	{
+		this->start_async_job();
+	}
+}
+
+bool DestructibleMap::has_pending_operations() const
+{
+	return this->async_job_ != nullptr || !this->pending_operations_.empty();
+}
+
+void DestructibleMap::finish_pending_operations()
+{
+	while (this->has_pending_operations())
+	{
+		this->apply_async_results(0);
+		if (this->has_pending_operations())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void DestructibleMap::start_async_job()
+{
+	if (this->pending_operations_.empty())
+	{
+		return;
+	}
+
+	auto job = new DestructibleMapAsyncJob();
+	job->operations.swap(this->pending_operations_);
+	job->fast_triangulation = this->config_.enable_merging_subdividing;
+	job->triangulation_buffer = this->config_.triangulation_buffer;
+
+	// the background thread works on copies of the leaves, the quad tree is only touched by this thread
+	std::vector<DestructibleMapChunk*> affected_leaves;
+	std::unordered_map<DestructibleMapChunk*, std::vector<int>> leaf_operations;
+	this->group_by_leaf(job->operations, affected_leaves, leaf_operations);
+	if (affected_leaves.empty())
+	{
+		delete job;
+		return;
+	}
+	this->page_in(affected_leaves);
+
+	job->leaves.resize(affected_leaves.size());
+	for (auto i = 0; i < affected_leaves.size(); i++)
+	{
+		auto &leaf = job->leaves[i];
+		leaf.chunk = affected_leaves[i];
+		leaf.version = leaf.chunk->version_;
+		leaf.chunk->get_quad(leaf.quad);
+		leaf.chunk->get_paths(leaf.paths);
+		leaf.indices.swap(leaf_operations[leaf.chunk]);
+	}
+
+	this->async_job_ = job;
+	this->async_modifier_->start(job);
+}
+
+void DestructibleMap::apply_async_results(long long budget_nanoseconds)
+{
+	const auto begin = get_nanoseconds();
+	auto num_applied = 0;
+	while (this->async_job_ != nullptr)
+	{
+		// at least one result per frame, so even a tiny budget makes progress
+		if (budget_nanoseconds > 0 && num_applied > 0 && get_nanoseconds() - begin >= budget_nanoseconds)
+		{
+			break;
+		}
+
+		const auto result = this->async_modifier_->pop_result();
+		if (result == nullptr)
+		{
+			break;
+		}
+
+		if (result->leaf == nullptr)
+		{
+			// the job is done, the stale leaves get its operations before anything submitted since then
+			this->replay_stale_leaves();
+
+			delete this->async_job_;
+			this->async_job_ = nullptr;
+			delete result;
+
+			this->start_async_job();
+			break;
+		}
+
+		// a leaf which was modified, merged or subdivided since the job copied it would lose that change
+		auto chunk = result->leaf->chunk;
+		if (chunk->version_ == result->leaf->version)
+		{
+			chunk->swap_geometry(result->paths, result->mesh);
+			map_profiler.count(COUNTER_ASYNC_APPLIED);
+		}
+		else
+		{
+			this->stale_leaves_.push_back(result->leaf);
+			map_profiler.count(COUNTER_ASYNC_STALE);
+		}
+		num_applied++;
+		delete result;
+	}
+}
+
+void DestructibleMap::replay_stale_leaves()
+{
+	if (this->stale_leaves_.empty())
+	{
+		return;
+	}
+
+	// the stale leaf may have been merged (one leaf covers several stale quads), subdivided or paged out and in since the job copied it.
+	// The other leaves already got their results, so the operations must not touch anything outside of the stale quads
+	std::vector<DestructibleMapChunk*> affected_leaves;
+	std::unordered_map<DestructibleMapChunk*, std::vector<const DestructibleMapAsyncLeaf*>> leaf_stale_leaves;
+	std::vector<DestructibleMapChunk*> leaves;
+	for (auto stale : this->stale_leaves_)
+	{
+		glm::ivec2 stale_begin, stale_end;
+		get_bounding_box(stale->quad, stale_begin, stale_end);
+		leaves.clear();
+		this->quad_tree_.query_range(glm::vec2(stale_begin) * SCALE_FACTOR_INV, glm::vec2(stale_end) * SCALE_FACTOR_INV, leaves);
+		for (auto leaf : leaves)
+		{
+			auto &stale_leaves = leaf_stale_leaves[leaf];
+			if (stale_leaves.empty())
+			{
+				affected_leaves.push_back(leaf);
+			}
+			stale_leaves.push_back(stale);
+		}
+	}
+	this->stale_leaves_.clear();
+	this->page_in(affected_leaves);
+
+	const auto &operations = this->async_job_->operations;
+	map_scheduler.parallel_for(int(affected_leaves.size()), [&](int i)
+	{
+		auto leaf = affected_leaves[i];
+		ClipperScope scope;
+		auto &c = scope->clipper;
+		ClipperLib::Paths paths;
+		ClipperLib::Paths outside_paths;
+		ClipperLib::Path leaf_quad;
+		leaf->get_paths(paths);
+		leaf->get_quad(leaf_quad);
+		glm::ivec2 leaf_begin, leaf_end;
+		get_bounding_box(leaf_quad, leaf_begin, leaf_end);
+
+		auto changed = false;
+		for (auto stale : leaf_stale_leaves.at(leaf))
+		{
+			// quads are either nested or apart, but the corners of neighbours may be one unit off, since they are rounded from floats
+			glm::ivec2 stale_begin, stale_end;
+			get_bounding_box(stale->quad, stale_begin, stale_end);
+			const auto overlap_size = glm::min(leaf_end, stale_end) - glm::max(leaf_begin, stale_begin);
+			if (overlap_size.x <= 1 || overlap_size.y <= 1)
+			{
+				continue;
+			}
+
+			// the stale leaf itself or one of its children gets all of the operations
+			if (leaf_end.x - leaf_begin.x <= stale_end.x - stale_begin.x)
+			{
+				scope->paths.swap(paths);
+				const auto clip = clip_leaf(*scope, leaf_quad, operations, stale->indices, false);
+				scope->paths.swap(paths);
+				changed = changed || clip.changed;
+				continue;
+			}
+
+			// a merged leaf is split at the stale quad, only the part inside of it gets the operations
+			c.Clear();
+			c.StrictlySimple(true);
+			c.AddPaths(paths, ClipperLib::ptSubject, true);
+			c.AddPath(stale->quad, ClipperLib::ptClip, true);
+			c.Execute(ClipperLib::ctIntersection, scope->paths, ClipperLib::pftNonZero);
+			c.Execute(ClipperLib::ctDifference, outside_paths, ClipperLib::pftNonZero);
+			const auto clip = clip_leaf(*scope, stale->quad, operations, stale->indices, false);
+			if (!clip.changed)
+			{
+				continue;
+			}
+			c.Clear();
+			c.AddPaths(outside_paths, ClipperLib::ptSubject, true);
+			c.AddPaths(scope->paths, ClipperLib::ptSubject, true);
+			c.Execute(ClipperLib::ctUnion, paths, ClipperLib::pftNonZero);
+			changed = true;
+		}
+
+		if (!changed)
+		{
+			return;
+		}
+
+		// clipper fails on an empty subject, an empty leaf keeps an empty tree
+		scope->poly_tree.Clear();
+		c.Clear();
+		c.StrictlySimple(true);
+		c.AddPaths(paths, ClipperLib::ptSubject, true);
+		if (!paths.empty() && !c.Execute(ClipperLib::ctUnion, scope->poly_tree, ClipperLib::pftNonZero))
+		{
+			std::cout << "Could not create Polygon Tree" << std::endl;
+		}
+		ClipperLib::PolyTreeToPaths(scope->poly_tree, scope->paths);
+		leaf->set_paths(scope->paths, scope->poly_tree, true);
+	});
+}
+
+bool DestructibleMap::set_page_file(const char *file_name)
+{
+	if (this->pager_ != nullptr)
+	{
+		std::cout << "The map already has a page file" << std::endl;
+		return false;
+	}
+
+	auto pager = new DestructibleMapPager();
+	if (!pager->open(file_name, this->config_.enable_merging_subdividing, this->config_.triangulation_buffer))
+	{
+		delete pager;
+		return false;
+	}
+	this->pager_ = pager;
+	return true;
+}
+
+void DestructibleMap::set_active_region(const glm::vec2 &begin, const glm::vec2 &end)
+{
+	this->has_active_region_ = true;
+	this->active_begin_ = glm::min(begin, end);
+	this->active_end_ = glm::max(begin, end);
+}
+
+void DestructibleMap::finish_paging()
+{
+	if (this->pager_ == nullptr)
+	{
+		return;
+	}
+
+	this->request_pages();
+	while (this->num_page_requests_ > 0)
+	{
+		this->apply_paged_in_leaves();
+		if (this->num_page_requests_ > 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void DestructibleMap::apply_paged_in_leaves()
+{
+	while (auto result = this->pager_->pop_result())
+	{
+		this->num_page_requests_--;
+
+		auto chunk = result->request.chunk;
+		if (chunk->paged_out_ && chunk->version_ == result->request.version)
+		{
+			// a page which could not be read stays where it is and is requested again
+			chunk->page_requested_ = false;
+			if (result->loaded)
+			{
+				this->pager_->release(chunk->page_);
+				chunk->swap_geometry(result->paths, result->mesh);
+				chunk->paged_out_ = false;
+				map_profiler.count(COUNTER_LEAF_PAGED_IN);
+			}
+		}
+		else
+		{
+			// the leaf was paged in on demand, which left the page to this result
+			this->pager_->release(result->request.page);
+		}
+		delete result;
+	}
+}
+
+void DestructibleMap::request_pages()
+{
+	if (!this->has_active_region_)
+	{
+		return;
+	}
+
+	const auto distance = glm::vec2(this->config_.page_in_distance, this->config_.page_in_distance);
+	std::vector<DestructibleMapChunk*> leaves;
+	this->quad_tree_.query_range(this->active_begin_ - distance, this->active_end_ + distance, leaves);
+	for (auto leaf : leaves)
+	{
+		if (leaf->paged_out_ && !leaf->page_requested_)
+		{
+			leaf->page_requested_ = true;
+			this->num_page_requests_++;
+			this->pager_->request({ leaf, leaf->version_, leaf->page_, this->get_page_origin(leaf) });
+		}
+	}
+}
+
+void DestructibleMap::page_out_leaves()
+{
+	// walking all leaves is expensive for big maps, so it only happens once the leaves might need more than the limit
+	if (this->config_.resident_bytes_limit <= 0 || this->resident_bytes_ + this->resident_growth_ <= this->config_.resident_bytes_limit)
+	{
+		return;
+	}
+	this->resident_growth_ = 0;
+
+	std::vector<DestructibleMapChunk*> leaves;
+	this->quad_tree_.query_range(this->quad_tree_.begin_, this->quad_tree_.end_, leaves);
+	long long resident_bytes = 0;
+	for (auto leaf : leaves)
+	{
+		resident_bytes += leaf->get_resident_bytes();
+	}
+	this->resident_bytes_ = resident_bytes;
+	if (resident_bytes <= this->config_.resident_bytes_limit)
+	{
+		return;
+	}
+
+	// leaves of a mergeable group are kept, merge needs all four of them
+	const auto distance = glm::vec2(this->config_.page_in_distance, this->config_.page_in_distance);
+	const auto keep_begin = this->active_begin_ - distance;
+	const auto keep_end = this->active_end_ + distance;
+	std::vector<std::pair<float, DestructibleMapChunk*>> candidates;
+	for (auto leaf : leaves)
+	{
+		if (leaf->paged_out_ || leaf->mesh_dirty_ || leaf->mergeable_count_ > 0 || leaf->get_resident_bytes() == 0)
+		{
+			continue;
+		}
+
+		auto leaf_distance = 0.0f;
+		if (this->has_active_region_)
+		{
+			const auto gap = glm::max(glm::max(keep_begin - leaf->end_, leaf->begin_ - keep_end), glm::vec2(0.0f, 0.0f));
+			if (gap.x <= 0.0f && gap.y <= 0.0f)
+			{
+				continue;
+			}
+			leaf_distance = glm::length(gap);
+		}
+		candidates.push_back(std::make_pair(leaf_distance, leaf));
+	}
+
+	// furthest first, down to 90% of the limit, so not every frame pages out a few leaves again
+	std::stable_sort(candidates.begin(), candidates.end(), [](const std::pair<float, DestructibleMapChunk*> &a, const std::pair<float, DestructibleMapChunk*> &b)
+	{
+		return a.first > b.first;
+	});
+	const auto target_bytes = this->config_.resident_bytes_limit / 10 * 9;
+	ClipperLib::Paths paths;
+	for (auto &candidate : candidates)
+	{
+		if (resident_bytes <= target_bytes)
+		{
+			break;
+		}
+
+		auto leaf = candidate.second;
+		resident_bytes -= leaf->get_resident_bytes();
+		leaf->get_paths(paths);
+		leaf->page_out(this->pager_->write(paths, this->get_page_origin(leaf)));
+		map_profiler.count(COUNTER_LEAF_PAGED_OUT);
+	}
+	this->resident_bytes_ = resident_bytes;
+}
+
+void DestructibleMap::page_in(const std::vector<DestructibleMapChunk*> &leaves)
+{
+	if (this->pager_ == nullptr)
+	{
+		return;
+	}
+
+	std::vector<DestructibleMapChunk*> paged_out;
+	for (auto leaf : leaves)
+	{
+		if (leaf->paged_out_)
+		{
+			paged_out.push_back(leaf);
+		}
+	}
+	if (paged_out.empty())
+	{
+		return;
+	}
+
+	// the leaves are needed right now, so they are loaded in parallel on this thread instead of waiting for the background thread
+	std::vector<DestructibleMapCompactPaths> paths(paged_out.size());
+	std::vector<DestructibleMapMesh> meshes(paged_out.size());
+	map_scheduler.parallel_for(int(paged_out.size()), [&](int i)
+	{
+		ClipperScope scope;
+		if (!this->pager_->read(paged_out[i]->page_, this->get_page_origin(paged_out[i]), scope->paths))
+		{
+			std::cout << "Could not page in a leaf, its geometry is lost" << std::endl;
+		}
+		paths[i].assign(scope->paths);
+		this->pager_->triangulate(scope->paths, meshes[i]);
+	});
+
+	for (auto i = 0; i < paged_out.size(); i++)
+	{
+		auto leaf = paged_out[i];
+		// a requested page is released once its result is back
+		if (!leaf->page_requested_)
+		{
+			this->pager_->release(leaf->page_);
+		}
+		leaf->page_requested_ = false;
+		leaf->swap_geometry(paths[i], meshes[i]);
+		leaf->paged_out_ = false;
+		map_profiler.count(COUNTER_LEAF_PAGED_IN_ON_DEMAND);
+	}
+}
+
+void DestructibleMap::get_quadtree_lines(std::vector<glm::vec2> &lines) const
+{
+	this->quad_tree_.get_lines(lines);
 }
@@ -2,54 +2,242 @@
 #include "clipper.hpp"
 #include "DestructibleMapChunk.h"
 #include "DestructibleMapConfiguration.h"
+#include "DestructibleMapBackend.h"
+#include "DestructibleMapCulling.h"
+#include <map>
+#include <unordered_map>
 
 
-class DestructibleMapShader;
-class MeshResource;
-
 ClipperLib::Path make_rect(const glm::ivec2 pos, const glm::ivec2 size);
 ClipperLib::Path make_circle(const glm::ivec2 pos, const float radius, const int num_of_points);
 
+struct DestructibleMapOperation
+{
+	ClipperLib::Path polygon;
+	ClipperLib::ClipType clip_type;
+};
+
+struct ClipperContext;
+class DestructibleMapAsyncModifier;
+struct DestructibleMapAsyncJob;
+struct DestructibleMapAsyncLeaf;
+class DestructibleMapMappedFile;
+class DestructibleMapJournal;
+class DestructibleMapPager;
+
+// what clip_leaf did to the paths of a leaf
+struct DestructibleMapLeafClip
+{
+	bool changed;
+	// false if the whole leaf has to be triangulated again
+	bool incremental;
+	glm::ivec2 modified_begin;
+	glm::ivec2 modified_end;
+};
+
+// same orientation for all polygons, otherwise overlapping polygons would cancel each other out using non zero filling
+void orient_polygon(ClipperLib::Path &polygon);
+
+// applies the operations with the given indices in order to the paths of a leaf (in context.paths, polygons oriented by orient_polygon).
+// The result is in context.paths and, if anything changed, context.poly_tree. Only touches the context, so it can run on any thread.
+DestructibleMapLeafClip clip_leaf(ClipperContext &context, const ClipperLib::Path &quad, const std::vector<DestructibleMapOperation> &operations, const std::vector<int> &indices, bool incremental);
+
+// a merge or subdivide which update_batches may postpone to a later frame
+struct DestructibleMapMaintenance
+{
+	// how many vertices the chunk is below (merge) or above (subdivide) vertices_per_chunk, the biggest benefit is done first
+	int benefit;
+	DestructibleMapChunk *chunk;
+	// a subdivide is dropped if the chunk changed since it was deferred
+	unsigned int version;
+	bool merge;
+};
+
 class DestructibleMap
 {
-	glm::mat4 trafo_;
-	glm::mat4 itrafo_;
 	std::vector<glm::vec2> vertices_;
 	std::vector<glm::vec2> points_;
-	std::vector<glm::vec2> lines_;
+	// declared before the quad tree, so it outlives the chunks it handed out
+	DestructibleMapChunkPool chunk_pool_;
 	DestructibleMapChunk quad_tree_;
-	float triangle_area_ratio_;
-	float points_per_leaf_ratio_;
-	DestructibleMapShader* map_shader_;
+	DestructibleMapConfig config_;
 
-	MeshResource* point_distribution_resource_;
-	MeshResource* quadtree_resource_;
-	RenderingEngine* rendering_engine_;
+	IBatchBackend *backend_;
+	bool owns_backend_;
 
 	std::vector<DestructibleMapDrawingBatch*> batches_;
+	// hold the levels of detail of inner chunks, apart from the leaves
+	std::vector<DestructibleMapDrawingBatch*> lod_batches_;
+	BatchFreeIndex batch_free_index_;
+	// batches by the Morton code of the first chunk allocated in them, to find batches close to a chunk
+	std::multimap<unsigned int, int> batch_morton_index_;
+	std::vector<std::pair<bool, unsigned int>> batch_morton_keys_;
 	double start_time_;
-	bool startup_displayed_;
+	unsigned int seed_;
+
+	// created with the first submitted operation, so maps which are only modified synchronously do not start a thread
+	DestructibleMapAsyncModifier *async_modifier_;
+	// submitted operations which wait for the current job to finish
+	std::vector<DestructibleMapOperation> pending_operations_;
+	// the job which is running or which results are not all applied yet
+	DestructibleMapAsyncJob *async_job_;
+	// leaves of the current job which changed while the job was running, their operations run again on their quads once the job is done
+	std::vector<const DestructibleMapAsyncLeaf*> stale_leaves_;
+
+	// leaves with more than vertices_per_chunk vertices which still fit into a batch, subdivided by run_maintenance
+	std::vector<DestructibleMapMaintenance> deferred_subdivisions_;
+	std::vector<DestructibleMapMaintenance> maintenance_;
+	std::vector<DestructibleMapChunk*> mergeable_chunks_;
+	bool first_update_;
+	// snapshot the vertices of the leaves point into, if the map was loaded from one
+	DestructibleMapMappedFile *snapshot_;
+	// not owned, every operation is recorded into it
+	DestructibleMapJournal *journal_;
+	// created by set_page_file, the leaves far away from the active region are paged out to it
+	DestructibleMapPager *pager_;
+	int num_page_requests_;
+	bool has_active_region_;
+	glm::vec2 active_begin_;
+	glm::vec2 active_end_;
+	long long resident_bytes_;
+	// upper bound of how much the leaves grew since resident_bytes_ was measured
+	long long resident_growth_;
 
 	void load(ClipperLib::Paths poly_tree);
-	void update_batches();
+	DestructibleMapDrawingBatch *create_batch();
+	unsigned int get_morton_code(const DestructibleMapChunk *chunk) const;
+	// the paths of a page are stored relative to the begin of the quad of the leaf
+	glm::ivec2 get_page_origin(const DestructibleMapChunk *chunk) const;
+	DestructibleMapDrawingBatch *find_nearby_batch(const DestructibleMapChunk *chunk) const;
+	void update_morton_index(DestructibleMapDrawingBatch *batch, const DestructibleMapChunk *chunk);
+	DestructibleMapDrawingBatch *find_batch(const DestructibleMapChunk *chunk) const;
+	// the leaves hit by any operation in the order they were hit first, with the indices of the operations hitting them in submission order
+	void group_by_leaf(const std::vector<DestructibleMapOperation> &operations, std::vector<DestructibleMapChunk*> &affected_leaves, std::unordered_map<DestructibleMapChunk*, std::vector<int>> &leaf_operations);
+	void start_async_job();
+	// budget_nanoseconds <= 0 applies every result which is ready
+	void apply_async_results(long long budget_nanoseconds);
+	// applies the operations of the stale leaves of the current job to whatever leaves cover their quads now, only inside of those quads
+	void replay_stale_leaves();
+	// merges and deferred subdivides by benefit, budget_nanoseconds <= 0 does all of them
+	void run_maintenance(long long budget_nanoseconds);
+	// puts every dirty leaf into a batch, subdivides the ones which do not fit into a batch
+	void place_dirty_chunks();
+	// swaps in the leaves the background thread paged in
+	void apply_paged_in_leaves();
+	// requests the paged out leaves close to the active region
+	void request_pages();
+	// pages out the leaves furthest away from the active region until the resident bytes are below the limit
+	void page_out_leaves();
+	// loads the paged out leaves among the given ones right away, before they are modified
+	void page_in(const std::vector<DestructibleMapChunk*> &leaves);
+	// sends the render attributes changed since the last frame to the backend
+	void upload_chunk_attributes();
+	// first fit, the levels of detail are only placed while drawing
+	DestructibleMapDrawingBatch *find_lod_batch(int num_vertices);
+	void draw_lod_chunks(DestructibleMapChunk *chunk, const DestructibleMapFrustum &frustum, const glm::mat4 &view_projection, const glm::vec2 &viewport_size);
 public:
 
-	explicit DestructibleMap(float triangle_area_ratio = MAP_TRIANGLE_AREA_RATIO, float points_per_leaf_ratio = MAP_POINTS_PER_LEAF_RATIO);
+	explicit DestructibleMap(const DestructibleMapConfig &config = DestructibleMapConfig());
 	~DestructibleMap();
 
-	void generate_map(int num_rects = GENERATE_NUM_RECTS, int num_circle = GENERATE_NUM_CIRCLES, int width = GENERATE_WIDTH, int height = GENERATE_HEIGHT, int min_size = GENERATE_MIN_SIZE, int max_size = GENERATE_MAX_SIZE);
+	void generate_map(int num_rects = GENERATE_NUM_RECTS, int num_circle = GENERATE_NUM_CIRCLES, int width = GENERATE_WIDTH, int height = GENERATE_HEIGHT, int min_size = GENERATE_MIN_SIZE, int max_size = GENERATE_MAX_SIZE, unsigned int seed = GENERATE_SEED);
+	// writes the quad tree together with the paths and vertices of every leaf
+	bool save_snapshot(const char *file_name) const;
+	// the same as save_snapshot, but into memory (the map has to be loaded)
+	void write_snapshot(std::vector<char> &data) const;
+	// replaces generate_map, the leaves use the vertices inside of the mapped file until they are modified
+	bool load_snapshot(const char *file_name);
+
+	// if no backend is given, a RecordingBatchBackend is used, which does not need any GPU
+	void init(IBatchBackend *backend = nullptr);
 
-	void init(RenderingEngine* rendering_engine);
+	void update_batches();
+	bool has_maintenance() const;
+	// merges and subdivides until the quad tree is settled, ignoring maintenance_budget_microseconds
+	void finish_maintenance();
 
+	// the batches are submitted together when the backend is flushed at the end, the GL backend needs a single draw call for them
 	void draw();
+	// only draws the batches which are inside of the frustum
+	void draw(const DestructibleMapFrustum &frustum);
+	// draws the chunks inside of the view, an inner chunk which covers fewer than lod_pixels pixels is drawn with its level of detail instead of its leaves
+	void draw(const glm::mat4 &view_projection, const glm::vec2 &viewport_size);
+	// the same without updating the batches and flushing the backend, so the caller can draw the frame itself
+	void draw_lod_chunks(const glm::mat4 &view_projection, const glm::vec2 &viewport_size);
 
 	void apply_polygon_operation(const ClipperLib::Path polygon, ClipperLib::ClipType clip_type);
 
-	void update_quadtree_representation();
+	// applies all operations in order, but clips and triangulates each affected chunk only once.
+	// An intersection affects every leaf with geometry, the ones outside of its polygon are emptied
+	void apply_polygon_operations(const std::vector<DestructibleMapOperation> &operations);
+
+	// queues the operation for the background thread, the result is swapped in by update_batches of a later frame.
+	// Leaves which are merged, subdivided or paged in the meantime run the queued operations again afterwards.
+	// apply_polygon_operation(s) waits for the queued operations first, so every leaf gets the operations in the order they were submitted
+	void submit_polygon_operation(const ClipperLib::Path polygon, ClipperLib::ClipType clip_type);
+	void submit_polygon_operations(const std::vector<DestructibleMapOperation> &operations);
+	bool has_pending_operations() const;
+	// blocks until every submitted operation is applied to the leaves
+	void finish_pending_operations();
+
+	// records every following operation into the journal, starting with a checkpoint of the current map (which has to be loaded).
+	// Further checkpoints are taken by update_batches once the journal needs one and no submitted operation is pending.
+	void set_journal(DestructibleMapJournal *journal);
+
+	// leaves are paged out to the file (which is deleted with the map) once their geometry needs more than resident_bytes_limit.
+	// Has to be called after the map is generated or loaded.
+	bool set_page_file(const char *file_name);
+	// usually the view of the camera, the leaves closer than page_in_distance to it are paged in ahead of time and never paged out.
+	// Without an active region leaves are only paged in when they are modified.
+	void set_active_region(const glm::vec2 &begin, const glm::vec2 &end);
+	// blocks until every leaf close to the active region is paged in, they are placed into batches by the next update_batches
+	void finish_paging();
+
+	void get_quadtree_lines(std::vector<glm::vec2> &lines) const;
 
 	DestructibleMapChunk *get_root_chunk()
 	{
 		return &this->quad_tree_;
 	}
-};
 
+	const std::vector<DestructibleMapDrawingBatch*> &get_batches() const
+	{
+		return this->batches_;
+	}
+
+	const std::vector<DestructibleMapDrawingBatch*> &get_lod_batches() const
+	{
+		return this->lod_batches_;
+	}
+
+	const std::vector<glm::vec2> &get_points() const
+	{
+		return this->points_;
+	}
+
+	const DestructibleMapConfig &get_config() const
+	{
+		return this->config_;
+	}
+
+	IBatchBackend *get_backend() const
+	{
+		return this->backend_;
+	}
+
+	// memory used by the geometry of the leaves when it was measured last, only measured with a resident_bytes_limit
+	long long get_resident_bytes() const
+	{
+		return this->resident_bytes_;
+	}
+
+	const DestructibleMapPager *get_pager() const
+	{
+		return this->pager_;
+	}
+
+	double get_start_time() const
+	{
+		return this->start_time_;
+	}
+};
@@ -0,0 +1,105 @@
+#include "DestructibleMapAsyncModifier.h"
+#include "DestructibleMapClipperContext.h"
+#include "DestructibleMapTaskScheduler.h"
+#include "DestructibleMapUtility.h"
+
+DestructibleMapAsyncModifier::DestructibleMapAsyncModifier()
+{
+	this->stopping_ = false;
+	this->thread_ = std::thread(&DestructibleMapAsyncModifier::thread_main, this);
+}
+
+DestructibleMapAsyncModifier::~DestructibleMapAsyncModifier()
+{
+	this->stop();
+
+	DestructibleMapAsyncResult *result;
+	while (this->results_.pop(result))
+	{
+		delete result;
+	}
+}
+
+void DestructibleMapAsyncModifier::stop()
+{
+	if (!this->thread_.joinable())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		this->stopping_ = true;
+	}
+	this->wake_up_.notify_one();
+	this->thread_.join();
+}
+
+void DestructibleMapAsyncModifier::start(DestructibleMapAsyncJob *job)
+{
+	this->jobs_.push(job);
+
+	// the thread checks for jobs while holding the mutex, so it either sees the job or gets the notification
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+	}
+	this->wake_up_.notify_one();
+}
+
+DestructibleMapAsyncResult *DestructibleMapAsyncModifier::pop_result()
+{
+	DestructibleMapAsyncResult *result;
+	if (this->results_.pop(result))
+	{
+		return result;
+	}
+	return nullptr;
+}
+
+void DestructibleMapAsyncModifier::thread_main()
+{
+	while (true)
+	{
+		DestructibleMapAsyncJob *job;
+		if (this->jobs_.pop(job))
+		{
+			this->run_job(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(this->mutex_);
+		this->wake_up_.wait(lock, [this]() { return this->stopping_ || !this->jobs_.empty(); });
+		if (this->stopping_)
+		{
+			return;
+		}
+	}
+}
+
+void DestructibleMapAsyncModifier::run_job(DestructibleMapAsyncJob *job)
+{
+	// the results are published as soon as each leaf is done, the render thread may already apply them while the others are still running
+	map_scheduler.parallel_for(int(job->leaves.size()), [this, job](int i)
+	{
+		const auto &leaf = job->leaves[i];
+
+		ClipperScope scope;
+		scope->paths = leaf.paths;
+		scope->poly_tree.Clear();
+		const auto clip = clip_leaf(*scope, leaf.quad, job->operations, leaf.indices, false);
+		if (!clip.changed)
+		{
+			return;
+		}
+
+		auto result = new DestructibleMapAsyncResult();
+		result->leaf = &leaf;
+		result->paths.assign(scope->paths);
+		triangulate_mesh(scope->poly_tree, job->fast_triangulation, job->triangulation_buffer, result->mesh);
+		this->results_.push(result);
+	});
+
+	auto done = new DestructibleMapAsyncResult();
+	done->leaf = nullptr;
+	this->results_.push(done);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "clipper.hpp"
+#include "DestructibleMap.h"
+#include "DestructibleMapGeometry.h"
+#include "DestructibleMapQueue.h"
+
+// copy of a leaf taken by the render thread, the background thread never touches the quad tree itself
+struct DestructibleMapAsyncLeaf
+{
+	DestructibleMapChunk *chunk;
+	// the result is dropped if the leaf changed in the meantime
+	unsigned int version;
+	ClipperLib::Path quad;
+	ClipperLib::Paths paths;
+	// operations of the job which touch the leaf, in submission order
+	std::vector<int> indices;
+};
+
+struct DestructibleMapAsyncJob
+{
+	std::vector<DestructibleMapOperation> operations;
+	std::vector<DestructibleMapAsyncLeaf> leaves;
+	bool fast_triangulation;
+	int triangulation_buffer;
+};
+
+// new geometry of a leaf of the job. The last result of a job has no leaf, it only marks that the job is done.
+struct DestructibleMapAsyncResult
+{
+	const DestructibleMapAsyncLeaf *leaf;
+	DestructibleMapCompactPaths paths;
+	DestructibleMapMesh mesh;
+};
+
+// clips and triangulates jobs on a background thread (which spreads the leaves over the task scheduler) and hands the results back through a lock free queue
+class DestructibleMapAsyncModifier
+{
+	DestructibleMapQueue<DestructibleMapAsyncJob*> jobs_;
+	DestructibleMapQueue<DestructibleMapAsyncResult*> results_;
+
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable wake_up_;
+	bool stopping_;
+
+	void thread_main();
+	void run_job(DestructibleMapAsyncJob *job);
+public:
+	DestructibleMapAsyncModifier();
+	~DestructibleMapAsyncModifier();
+
+	DestructibleMapAsyncModifier(const DestructibleMapAsyncModifier&) = delete;
+	DestructibleMapAsyncModifier& operator=(const DestructibleMapAsyncModifier&) = delete;
+
+	// the job has to stay alive until its last result was popped
+	void start(DestructibleMapAsyncJob *job);
+	// returns nullptr if no result is ready, only called by the render thread
+	DestructibleMapAsyncResult *pop_result();
+	// finishes the current job and joins the thread
+	void stop();
+};
@@ -0,0 +1,81 @@
+#include "DestructibleMapAutoTuner.h"
+#include <algorithm>
+#include "DestructibleMapRecordingBackend.h"
+#include "DestructibleMapUtility.h"
+
+DestructibleMapAutoTuner::DestructibleMapAutoTuner(const DestructibleMapConfig &base_config, std::function<void(DestructibleMap&)> generator)
+{
+	this->base_config_ = base_config;
+	this->generator_ = generator;
+	this->chunk_sizes_ = { 32, 64, 128, 256, 512 };
+	this->batch_sizes_ = { 1024, 2048, 4096, 8192 };
+	this->draw_call_cost_ = 0.005;
+}
+
+AutoTuneResult DestructibleMapAutoTuner::evaluate(const DestructibleMapConfig &config, const std::vector<DestructibleMapOperation> &workload) const
+{
+	DestructibleMap map(config);
+	this->generator_(map);
+
+	RecordingBatchBackend backend;
+	map.init(&backend);
+	map.draw();
+
+	AutoTuneResult result;
+	result.config = config;
+	result.mean_frame_milliseconds = 0.0;
+	result.max_frame_milliseconds = 0.0;
+
+	for (auto &operation : workload)
+	{
+		const auto begin = get_time();
+
+		map.apply_polygon_operation(operation.polygon, operation.clip_type);
+		map.draw();
+
+		const auto frame_milliseconds = (get_time() - begin) * 1000.0;
+		result.mean_frame_milliseconds += frame_milliseconds;
+		result.max_frame_milliseconds = std::max(result.max_frame_milliseconds, frame_milliseconds);
+	}
+
+	if (!workload.empty())
+	{
+		result.mean_frame_milliseconds /= workload.size();
+	}
+	result.draw_calls = map_draw_calls;
+	result.cost = result.mean_frame_milliseconds + this->draw_call_cost_ * result.draw_calls;
+	return result;
+}
+
+DestructibleMapConfig DestructibleMapAutoTuner::tune(const std::vector<DestructibleMapOperation> &workload)
+{
+	this->results_.clear();
+
+	auto best = this->base_config_;
+	auto best_cost = -1.0;
+	for (auto chunk_size : this->chunk_sizes_)
+	{
+		for (auto batch_size : this->batch_sizes_)
+		{
+			// a chunk below the subdivision threshold must always fit into an empty batch
+			if (batch_size <= chunk_size)
+			{
+				continue;
+			}
+
+			auto config = this->base_config_;
+			config.set_vertices_per_chunk(chunk_size);
+			config.vertices_per_batch = batch_size;
+
+			const auto result = this->evaluate(config, workload);
+			this->results_.push_back(result);
+
+			if (best_cost < 0.0 || result.cost < best_cost)
+			{
+				best_cost = result.cost;
+				best = config;
+			}
+		}
+	}
+	return best;
+}
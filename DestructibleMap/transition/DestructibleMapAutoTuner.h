@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include "DestructibleMap.h"
+
+struct AutoTuneResult
+{
+	DestructibleMapConfig config;
+	double mean_frame_milliseconds;
+	double max_frame_milliseconds;
+	int draw_calls;
+	double cost;
+};
+
+// Replays a recorded workload for every combination of chunk and batch size and picks the configuration with the lowest cost.
+// cost = mean modification latency + draw_call_cost * draw calls after the workload, so the draw call cost (in ms)
+// decides how render time is weighted against modification time.
+class DestructibleMapAutoTuner
+{
+	DestructibleMapConfig base_config_;
+	std::function<void(DestructibleMap&)> generator_;
+	std::vector<int> chunk_sizes_;
+	std::vector<int> batch_sizes_;
+	double draw_call_cost_;
+	std::vector<AutoTuneResult> results_;
+
+	AutoTuneResult evaluate(const DestructibleMapConfig &config, const std::vector<DestructibleMapOperation> &workload) const;
+public:
+	// generator has to fill the (empty) map, e.g. by calling generate_map with a fixed seed
+	DestructibleMapAutoTuner(const DestructibleMapConfig &base_config, std::function<void(DestructibleMap&)> generator);
+
+	void set_chunk_sizes(const std::vector<int> &chunk_sizes)
+	{
+		this->chunk_sizes_ = chunk_sizes;
+	}
+
+	void set_batch_sizes(const std::vector<int> &batch_sizes)
+	{
+		this->batch_sizes_ = batch_sizes;
+	}
+
+	void set_draw_call_cost(double milliseconds)
+	{
+		this->draw_call_cost_ = milliseconds;
+	}
+
+	DestructibleMapConfig tune(const std::vector<DestructibleMapOperation> &workload);
+
+	const std::vector<AutoTuneResult> &get_results() const
+	{
+		return this->results_;
+	}
+};
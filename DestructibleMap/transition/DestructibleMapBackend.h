@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// flags of the render attributes of a chunk, read by map_shader.vs
+#define CHUNK_ATTRIBUTE_HIGHLIGHTED (1u)
+
+// indices of one chunk inside of its batch
+struct BatchDrawCommand
+{
+	int first_index;
+	int num_indices;
+	// the render attributes of the chunk are looked up by it
+	int chunk_id;
+};
+
+// GPU side storage of one drawing batch. Created by an IBatchBackend, so the map itself never talks to a graphics API
+class IBatchBuffer
+{
+public:
+	virtual ~IBatchBuffer() = default;
+
+	// vertex_data is the complete vertex data of the batch (interleaved x/y pairs), index_data the complete 16 bit index data (three per triangle,
+	// relative to the start of the batch). Only the vertices [offset, offset + num_vertices) and the indices [index_offset, index_offset + num_indices) changed.
+	// The pointers stay valid for the lifetime of the buffer, so they may also be read later on.
+	virtual void upload(const float *vertex_data, int offset, int num_vertices, const uint16_t *index_data, int index_offset, int num_indices) = 0;
+	// replaces the chunks which are drawn, one command per chunk. The commands are copied
+	virtual void upload_commands(const BatchDrawCommand *commands, int num_commands) = 0;
+	// adds the chunks of the batch to the current frame, they are drawn by IBatchBackend::flush
+	virtual void draw() = 0;
+	// adds only the chunk of the command with the given index
+	virtual void draw_command(int index) = 0;
+};
+
+class IBatchBackend
+{
+public:
+	virtual ~IBatchBackend() = default;
+
+	// capacity is the maximum number of vertices the buffer has to hold, index_capacity the maximum number of indices
+	virtual IBatchBuffer *create_buffer(int capacity, int index_capacity) = 0;
+	// attributes holds the CHUNK_ATTRIBUTE_* flags of all num_chunks chunk ids, only the ids [offset, offset + count) changed.
+	// The pointer stays valid until the next call.
+	virtual void upload_chunk_attributes(const uint32_t *attributes, int num_chunks, int offset, int count) = 0;
+	// draws all batches added since the last flush, returns the number of draw calls this took
+	virtual int flush() = 0;
+};
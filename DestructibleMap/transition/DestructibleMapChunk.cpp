@@ -3,13 +3,22 @@
 #include <cassert>
 #include "clipper.hpp"
 #include <iostream>
-#include "ShaderResource.h"
 #include <random>
+#include <stdexcept>
+#include <mutex>
 #include "DestructibleMap.h"
 #include "DestructibleMapDrawingBatch.h"
 #include "DestructibleMapUtility.h"
+#include "DestructibleMapProfiler.h"
+#include "DestructibleMapClipperContext.h"
+#include "DestructibleMapTaskScheduler.h"
 
 int map_draw_calls;
+long long map_uploaded_bytes;
+int map_culled_batches;
+
+// leaves which are modified by different tasks share their ancestors
+static std::mutex dirty_mutex;
 
 
 void DestructibleMapChunk::constructor()
@@ -20,27 +29,41 @@ void DestructibleMapChunk::constructor()
 	this->south_east_ = nullptr;
 	this->parent_ = nullptr;
 	this->mesh_dirty_ = false;
+	this->lod_dirty_ = true;
+	this->version_ = 0;
+	this->mapped_vertices_ = nullptr;
+	this->num_mapped_vertices_ = 0;
+	this->mapped_indices_ = nullptr;
+	this->num_mapped_indices_ = 0;
+	this->paged_out_ = false;
+	this->page_requested_ = false;
+	this->page_ = { 0, 0 };
 	this->batch_info_ = nullptr;
-	this->mergeable_count_ = false;
-
+	this->mergeable_count_ = 0;
+	this->config_ = nullptr;
+	this->pool_ = nullptr;
+	this->id_ = 0;
 }
 
-DestructibleMapChunk::DestructibleMapChunk(DestructibleMapChunk *parent, const glm::vec2 begin, const glm::vec2 end)
+void DestructibleMapChunk::init(const DestructibleMapConfig *config, DestructibleMapChunkPool *pool, DestructibleMapChunk *parent, const glm::vec2 begin, const glm::vec2 end)
 {
-	constructor();
+	this->config_ = config;
+	this->pool_ = pool;
 	assert(begin.x < end.x && begin.y < end.y);
 	this->begin_ = begin;
 	this->end_ = end;
 	this->parent_ = parent;
+	this->version_++;
 
-	const glm::ivec2 quad_pos = glm::ivec2(this->begin_* SCALE_FACTOR);
-	const glm::ivec2 quad_size = glm::ivec2((this->end_ - this->begin_) * SCALE_FACTOR);
-	this->quad_ = make_rect(
-		quad_pos,
-		quad_size
-	);
+	// a triangle list of vertices_per_chunk * 2 corners shares about half of them
+	this->mesh_.vertices.reserve(config->vertices_per_chunk);
+	this->mesh_.indices.reserve(config->vertices_per_chunk * 2);
+}
 
-	this->vertices_.reserve(VERTICES_PER_CHUNK * 2);
+DestructibleMapChunk::DestructibleMapChunk(const DestructibleMapConfig *config, DestructibleMapChunkPool *pool, DestructibleMapChunk *parent, const glm::vec2 begin, const glm::vec2 end)
+{
+	constructor();
+	init(config, pool, parent, begin, end);
 }
 
 DestructibleMapChunk::DestructibleMapChunk()
@@ -55,13 +78,61 @@ DestructibleMapChunk::~DestructibleMapChunk()
 		this->batch_info_->batch->dealloc_chunk(this);
 	}
 
-	if (this->north_west_)
+	this->release_children();
+}
+
+void DestructibleMapChunk::reset()
+{
+	if (this->batch_info_ != nullptr)
 	{
-		delete this->north_west_;
-		delete this->north_east_;
-		delete this->south_west_;
-		delete this->south_east_;
+		this->batch_info_->batch->dealloc_chunk(this);
 	}
+
+	this->release_children();
+
+	this->points_.clear();
+	this->paths_.clear();
+	this->mesh_.clear();
+	this->mapped_vertices_ = nullptr;
+	this->paged_out_ = false;
+	this->page_requested_ = false;
+	this->parent_ = nullptr;
+	this->mesh_dirty_ = false;
+	this->lod_dirty_ = true;
+	this->version_++;
+	this->pool_->set_attributes(this->id_, 0);
+	this->mergeable_count_ = 0;
+}
+
+void DestructibleMapChunk::set_highlighted(bool highlight)
+{
+	const auto attributes = this->pool_->get_attributes(this->id_);
+	this->pool_->set_attributes(this->id_, highlight ? attributes | CHUNK_ATTRIBUTE_HIGHLIGHTED : attributes & ~CHUNK_ATTRIBUTE_HIGHLIGHTED);
+}
+
+bool DestructibleMapChunk::is_highlighted() const
+{
+	return (this->pool_->get_attributes(this->id_) & CHUNK_ATTRIBUTE_HIGHLIGHTED) != 0;
+}
+
+void DestructibleMapChunk::release_children()
+{
+	if (this->north_west_ == nullptr)
+	{
+		return;
+	}
+
+	// the four children were acquired as one group, north west is the first of them
+	this->north_west_->reset();
+	this->north_east_->reset();
+	this->south_west_->reset();
+	this->south_east_->reset();
+	this->pool_->release(this->north_west_);
+
+	this->north_west_ = nullptr;
+	this->north_east_ = nullptr;
+	this->south_west_ = nullptr;
+	this->south_east_ = nullptr;
 }
 
 void DestructibleMapChunk::get_lines(std::vector<glm::vec2>& lines) const
@@ -111,7 +182,8 @@ bool DestructibleMapChunk::insert(const glm::vec2& point, const int max_points)
 		{
 			this->insert(old_points, max_points);
 		}
-		this->points_.clear();
+		// inner chunks never get points again
+		std::vector<glm::vec2>().swap(this->points_);
 	}
 
 	if (this->north_west_->insert(point, max_points))
@@ -133,34 +205,61 @@ bool DestructibleMapChunk::insert(const glm::vec2& point, const int max_points)
 	return false;
 }
 
-void DestructibleMapChunk::subdivide()
+void DestructibleMapChunk::create_children()
 {
 	const glm::vec2 size = (this->end_ - this->begin_) / 2.0f;
 	assert(size.x >= 0 && size.y >= 0);
 	const glm::vec2 size_x = glm::vec2(size.x, 0);
 	const glm::vec2 size_y = glm::vec2(0, size.y);
 
-	this->north_west_ = new DestructibleMapChunk(this, this->begin_, this->begin_ + size);
-	this->north_east_ = new DestructibleMapChunk(this, this->begin_ + size_x, this->begin_ + size_x + size);
-	this->south_west_ = new DestructibleMapChunk(this, this->begin_ + size_y, this->begin_ + size_y + size);
-	this->south_east_ = new DestructibleMapChunk(this, this->begin_ + size, this->end_);
-
-	DestructibleMapChunk *directions[] = {
-		this->north_west_,
-		this->north_east_,
-		this->south_west_,
-		this->south_east_
-	};
+	this->version_++;
+	const auto children = this->pool_->acquire();
+	this->north_west_ = &children[0];
+	this->north_east_ = &children[1];
+	this->south_west_ = &children[2];
+	this->south_east_ = &children[3];
+	this->north_west_->init(this->config_, this->pool_, this, this->begin_, this->begin_ + size);
+	this->north_east_->init(this->config_, this->pool_, this, this->begin_ + size_x, this->begin_ + size_x + size);
+	this->south_west_->init(this->config_, this->pool_, this, this->begin_ + size_y, this->begin_ + size_y + size);
+	this->south_east_->init(this->config_, this->pool_, this, this->begin_ + size, this->end_);
+}
 
+void DestructibleMapChunk::subdivide()
+{
+	this->create_children();
 
-#pragma omp parallel for
-	for (auto i = 0; i < 4; i++)
+	// the new children clip and triangulate their part of the paths in parallel
+	if (!this->paths_.empty())
 	{
-		directions[i]->apply_polygon(this->paths_);
+		ClipperScope scope;
+		auto &paths = scope->paths;
+		this->paths_.get(paths);
+
+		DestructibleMapChunk *directions[] = {
+			this->north_west_,
+			this->north_east_,
+			this->south_west_,
+			this->south_east_
+		};
+
+		DestructibleMapTaskGroup group;
+		for (auto child : directions)
+		{
+			map_scheduler.spawn(group, [&paths, child]() { child->apply_polygon(paths); });
+		}
+		map_scheduler.wait(group);
 	}
 
 	this->paths_.clear();
-	this->vertices_.clear();
+	this->mesh_.clear();
+	this->mapped_vertices_ = nullptr;
+	// the paths of the leaf are gone, its level of detail is built from the children once it is needed. The ancestors may have been built
+	// since this chunk was modified as a leaf (a deferred subdivision), they are marked as well so later modifications below reach them
+	{
+		std::lock_guard<std::mutex> lock(dirty_mutex);
+		this->lod_dirty_ = false;
+		this->mark_lod_dirty();
+	}
 
 	// do not need to merge
 	if (this->mergeable_count_)
@@ -181,37 +280,43 @@ void DestructibleMapChunk::subdivide()
 void DestructibleMapChunk::merge()
 {
 	assert(this->north_west_);
+	this->version_++;
+	this->release_lod();
 
-	if (this->north_west_->paths_.size() + this->north_east_->paths_.size() + this->south_west_->paths_.size() + this->south_east_->paths_.size() > 0) {
-		ClipperLib::PolyTree result_poly_tree;
-		ClipperLib::Clipper c;
+	if (this->north_west_->paths_.get_num_paths() + this->north_east_->paths_.get_num_paths() + this->south_west_->paths_.get_num_paths() + this->south_east_->paths_.get_num_paths() > 0) {
+		ClipperScope scope;
+		auto &result_poly_tree = scope->poly_tree;
+		auto &c = scope->clipper;
 		c.StrictlySimple(true);
-		c.AddPaths(this->north_west_->paths_, ClipperLib::ptSubject, true);
-		c.AddPaths(this->north_east_->paths_, ClipperLib::ptSubject, true);
-		c.AddPaths(this->south_west_->paths_, ClipperLib::ptSubject, true);
-		c.AddPaths(this->south_east_->paths_, ClipperLib::ptSubject, true);
 
-		if (!c.Execute(ClipperLib::ctUnion, result_poly_tree, ClipperLib::pftNonZero))
+		DestructibleMapChunk *children[] = {
+			this->north_west_,
+			this->north_east_,
+			this->south_west_,
+			this->south_east_
+		};
+		for (auto child : children)
 		{
-			std::cout << "Could not create Polygon Tree" << std::endl;
+			child->paths_.get(scope->subject_paths);
+			c.AddPaths(scope->subject_paths, ClipperLib::ptSubject, true);
+		}
+
+		auto &result_paths = scope->paths;
+		{
+			ProfileScope clip_scope(STAGE_CLIP);
+			if (!c.Execute(ClipperLib::ctUnion, result_poly_tree, ClipperLib::pftNonZero))
+			{
+				std::cout << "Could not create Polygon Tree" << std::endl;
+			}
+
+			ClipperLib::PolyTreeToPaths(result_poly_tree, result_paths);
 		}
-		
-		ClipperLib::Paths result_paths;
-		ClipperLib::PolyTreeToPaths(result_poly_tree, result_paths);
 
 		this->set_paths(result_paths, result_poly_tree, true);
 	}
 
 	// remove children
-	delete this->north_west_;
-	delete this->north_east_;
-	delete this->south_west_;
-	delete this->south_east_;
-
-	this->north_west_ = nullptr;
-	this->north_east_ = nullptr;
-	this->south_west_ = nullptr;
-	this->south_east_ = nullptr;
+	this->release_children();
 
 	// decrease merge counter
 	auto current = this;
@@ -227,35 +332,58 @@ void DestructibleMapChunk::merge()
 
 void DestructibleMapChunk::apply_polygon(const ClipperLib::Paths &input_paths)
 {
-	ClipperLib::PolyTree result_poly_tree;
-	ClipperLib::Clipper c;
-	c.StrictlySimple(true);
-	c.AddPaths(input_paths, ClipperLib::ptSubject, true);
-	c.AddPath(this->quad_, ClipperLib::ptClip, true);
-
-	if (!c.Execute(ClipperLib::ctIntersection, result_poly_tree, ClipperLib::pftNonZero))
-	{
-		std::cout << "Could not create Polygon Tree" << std::endl;
-	}
-
-	if (result_poly_tree.Total() == 0)
-	{
-		return;
+	// the context stays borrowed while the children are clipped, they borrow their own
+	ClipperScope scope;
+	auto &result_paths = scope->paths;
+	{
+		ProfileScope clip_scope(STAGE_CLIP);
+		this->get_quad(scope->quad);
+		clip_paths_to_rect(input_paths, scope->quad, result_paths);
+		if (result_paths.empty())
+		{
+			return;
+		}
 	}
 
-	ClipperLib::Paths result_paths;
-	ClipperLib::PolyTreeToPaths(result_poly_tree, result_paths);
-
-
 	if (this->north_west_)
 	{
-		this->north_west_->apply_polygon(result_paths);
-		this->north_east_->apply_polygon(result_paths);
-		this->south_west_->apply_polygon(result_paths);
-		this->south_east_->apply_polygon(result_paths);
+		// every child is a task, which recurses further down with tasks of its own
+		DestructibleMapChunk *directions[] = {
+			this->north_west_,
+			this->north_east_,
+			this->south_west_,
+			this->south_east_
+		};
+
+		DestructibleMapTaskGroup group;
+		for (auto child : directions)
+		{
+			map_scheduler.spawn(group, [&result_paths, child]() { child->apply_polygon(result_paths); });
+		}
+		map_scheduler.wait(group);
 	}
 	else
 	{
+		// the union removes the bridges the rectangle clip may have left and builds the tree for the triangulation
+		auto &result_poly_tree = scope->poly_tree;
+		{
+			ProfileScope clip_scope(STAGE_CLIP);
+			auto &c = scope->clipper;
+			c.StrictlySimple(true);
+			c.AddPaths(result_paths, ClipperLib::ptSubject, true);
+			if (!c.Execute(ClipperLib::ctUnion, result_poly_tree, ClipperLib::pftNonZero))
+			{
+				std::cout << "Could not create Polygon Tree" << std::endl;
+			}
+
+			if (result_poly_tree.Total() == 0)
+			{
+				return;
+			}
+
+			ClipperLib::PolyTreeToPaths(result_poly_tree, result_paths);
+		}
+
 		this->set_paths(result_paths, result_poly_tree, false);
 	}
 }
@@ -285,19 +413,210 @@ void DestructibleMapChunk::query_range(const glm::vec2& query_begin, const glm::
 
 void DestructibleMapChunk::set_paths(const ClipperLib::Paths &paths, const ClipperLib::PolyTree &poly_tree, bool fast)
 {
-	this->paths_ = paths;
-	this->vertices_.clear();
-#ifdef ENABLE_MERGING_SUBDIVIDING
-	if (fast)
+	ProfileScope triangulate_scope(STAGE_TRIANGULATE);
+	map_profiler.count(COUNTER_FULL_TRIANGULATION);
+	this->paths_.assign(paths);
+	this->version_++;
+	this->mapped_vertices_ = nullptr;
+	triangulate_mesh(poly_tree, fast && this->config_->enable_merging_subdividing, this->config_->triangulation_buffer, this->mesh_);
+
+	this->mark_mesh_dirty();
+}
+
+void DestructibleMapChunk::swap_geometry(DestructibleMapCompactPaths &paths, DestructibleMapMesh &mesh)
+{
+	this->paths_.swap(paths);
+	this->mesh_.swap(mesh);
+	this->mapped_vertices_ = nullptr;
+	this->version_++;
+	this->mark_mesh_dirty();
+}
+
+void DestructibleMapChunk::set_paths_incremental(const ClipperLib::Paths &paths, const ClipperLib::PolyTree &poly_tree, const glm::ivec2 &modified_begin, const glm::ivec2 &modified_end)
+{
+	if (!this->config_->enable_merging_subdividing || this->get_num_indices() == 0)
+	{
+		this->set_paths(paths, poly_tree, true);
+		return;
+	}
+
+	// the triangles are edited as a list and indexed again afterwards
+	thread_local std::vector<glm::vec2> triangles;
+	bool success;
+	{
+		ProfileScope triangulate_scope(STAGE_TRIANGULATE);
+		expand_triangles(this->get_vertices(), this->get_indices(), this->get_num_indices(), triangles);
+		success = this->retriangulate_region(paths, modified_begin, modified_end, triangles);
+		if (success)
+		{
+			index_triangles(triangles, this->mesh_);
+			this->mapped_vertices_ = nullptr;
+		}
+	}
+
+	if (!success)
+	{
+		map_profiler.count(COUNTER_INCREMENTAL_FALLBACK);
+		this->set_paths(paths, poly_tree, true);
+		return;
+	}
+
+	map_profiler.count(COUNTER_INCREMENTAL_TRIANGULATION);
+	this->paths_.assign(paths);
+	this->version_++;
+	this->mark_mesh_dirty();
+}
+
+bool DestructibleMapChunk::retriangulate_region(const ClipperLib::Paths &paths, const glm::ivec2 &modified_begin, const glm::ivec2 &modified_end, std::vector<glm::vec2> &triangles)
+{
+	// the contours are moved by one unit before triangulating, so the region is grown a bit to catch those triangles too
+	const auto region_begin = modified_begin - 2;
+	const auto region_end = modified_end + 2;
+	const auto begin = glm::vec2(region_begin) * SCALE_FACTOR_INV;
+	const auto end = glm::vec2(region_end) * SCALE_FACTOR_INV;
+
+	// split the triangles into the kept ones (compacted to the front) and the cavity around the modification
+	ClipperLib::Paths cavity_triangles;
+	auto num_kept = 0;
+	for (auto i = 0; i < triangles.size(); i += 3)
+	{
+		const auto v0 = triangles[i];
+		const auto v1 = triangles[i + 1];
+		const auto v2 = triangles[i + 2];
+
+		if (!triangle_intersects_rect(v0, v1, v2, begin, end))
+		{
+			triangles[num_kept++] = v0;
+			triangles[num_kept++] = v1;
+			triangles[num_kept++] = v2;
+		}
+		else
+		{
+			ClipperLib::Path triangle;
+			triangle <<
+				ClipperLib::IntPoint(ClipperLib::cInt(round(v0.x * SCALE_FACTOR)), ClipperLib::cInt(round(v0.y * SCALE_FACTOR))) <<
+				ClipperLib::IntPoint(ClipperLib::cInt(round(v1.x * SCALE_FACTOR)), ClipperLib::cInt(round(v1.y * SCALE_FACTOR))) <<
+				ClipperLib::IntPoint(ClipperLib::cInt(round(v2.x * SCALE_FACTOR)), ClipperLib::cInt(round(v2.y * SCALE_FACTOR)));
+			cavity_triangles.push_back(triangle);
+		}
+	}
+
+	// everything is affected, triangulating the whole chunk is cheaper
+	if (num_kept == 0)
 	{
-		triangulate_fast(poly_tree, this->vertices_);
-	} else
+		return false;
+	}
+	triangles.resize(num_kept);
+
+	// the hole left by the removed triangles together with the modified region is filled with the new polygon
+	ClipperLib::Paths cavity;
+	if (!triangles_to_outline(cavity_triangles, cavity))
+	{
+		return false;
+	}
+	auto rect = make_rect(region_begin, region_end - region_begin);
+	if (!ClipperLib::Orientation(rect))
 	{
-		triangulate(poly_tree, this->vertices_);
+		ClipperLib::ReversePath(rect);
 	}
-#else
-	triangulate(poly_tree, this->vertices_);
-#endif
+	cavity.push_back(rect);
+
+	glm::ivec2 cavity_begin = region_begin;
+	glm::ivec2 cavity_end = region_end;
+	for (auto &path : cavity)
+	{
+		glm::ivec2 path_begin, path_end;
+		get_bounding_box(path, path_begin, path_end);
+		cavity_begin = glm::min(cavity_begin, path_begin);
+		cavity_end = glm::max(cavity_end, path_end);
+	}
+
+	ClipperScope scope;
+	auto &cavity_poly_tree = scope->poly_tree;
+	{
+		ProfileScope clip_scope(STAGE_CLIP);
+		auto &c = scope->clipper;
+		c.StrictlySimple(true);
+
+		// contours which are completely outside of the cavity do not change the result
+		for (auto &path : paths)
+		{
+			glm::ivec2 path_begin, path_end;
+			get_bounding_box(path, path_begin, path_end);
+			if (path_end.x >= cavity_begin.x && path_end.y >= cavity_begin.y && path_begin.x <= cavity_end.x && path_begin.y <= cavity_end.y)
+			{
+				c.AddPath(path, ClipperLib::ptSubject, true);
+			}
+		}
+		c.AddPaths(cavity, ClipperLib::ptClip, true);
+		if (!c.Execute(ClipperLib::ctIntersection, cavity_poly_tree, ClipperLib::pftNonZero, ClipperLib::pftNonZero))
+		{
+			return false;
+		}
+	}
+
+	try
+	{
+		triangulate_fast(cavity_poly_tree, triangles, this->config_->triangulation_buffer);
+	}
+	catch (const std::runtime_error &)
+	{
+		return false;
+	}
+
+	// the cavity and the kept triangles do not match up exactly, if anything got lost or overlaps the whole chunk is triangulated again
+	auto expected_area = 0.0;
+	for (auto &path : paths)
+	{
+		expected_area += ClipperLib::Area(path);
+	}
+	expected_area = abs(expected_area) * SCALE_FACTOR_INV * SCALE_FACTOR_INV;
+
+	auto area = 0.0;
+	for (auto i = 0; i < triangles.size(); i += 3)
+	{
+		const auto &v0 = triangles[i];
+		const auto &v1 = triangles[i + 1];
+		const auto &v2 = triangles[i + 2];
+		area += triangle_area(v0.x, v0.y, v1.x, v1.y, v2.x, v2.y);
+	}
+
+	return abs(area - expected_area) <= expected_area * 0.001 + 1.0;
+}
+
+void DestructibleMapChunk::get_quad(ClipperLib::Path &quad) const
+{
+	const glm::ivec2 quad_pos = glm::ivec2(this->begin_ * SCALE_FACTOR);
+	const glm::ivec2 quad_size = glm::ivec2((this->end_ - this->begin_) * SCALE_FACTOR);
+	make_rect(quad_pos, quad_size, quad);
+}
+
+void DestructibleMapChunk::page_out(const DestructibleMapPage &page)
+{
+	if (this->batch_info_ != nullptr)
+	{
+		this->batch_info_->batch->dealloc_chunk(this);
+	}
+
+	// swapped with empty vectors, clear would keep the memory
+	this->paths_.release();
+	this->mesh_.release();
+	std::vector<glm::vec2>().swap(this->points_);
+	this->mapped_vertices_ = nullptr;
+	this->version_++;
+	this->paged_out_ = true;
+	this->page_requested_ = false;
+	this->page_ = page;
+}
+
+size_t DestructibleMapChunk::get_resident_bytes() const
+{
+	return this->points_.capacity() * sizeof(glm::vec2) + this->paths_.get_resident_bytes() + this->mesh_.get_resident_bytes();
+}
+
+void DestructibleMapChunk::mark_mesh_dirty()
+{
+	std::lock_guard<std::mutex> lock(dirty_mutex);
 
 	auto current = this;
 	while (current && !current->mesh_dirty_)
@@ -305,6 +624,111 @@ void DestructibleMapChunk::set_paths(const ClipperLib::Paths &paths, const Clipp
 		current->mesh_dirty_ = true;
 		current = current->parent_;
 	}
+
+	if (this->parent_)
+	{
+		this->parent_->mark_lod_dirty();
+	}
+}
+
+void DestructibleMapChunk::mark_lod_dirty()
+{
+	// the ancestors of a dirty inner chunk are dirty as well, so the walk stops at the first one
+	auto current = this;
+	while (current && !current->lod_dirty_)
+	{
+		current->lod_dirty_ = true;
+		current = current->parent_;
+	}
+}
+
+void DestructibleMapChunk::release_lod()
+{
+	if (this->batch_info_ != nullptr)
+	{
+		this->batch_info_->batch->dealloc_chunk(this);
+	}
+	this->paths_.clear();
+	this->mesh_.clear();
+	this->lod_dirty_ = false;
+}
+
+bool DestructibleMapChunk::update_lod()
+{
+	// a paged out leaf has no paths, a level of detail built from it would have a hole
+	if (this->north_west_ == nullptr)
+	{
+		return !this->paged_out_;
+	}
+	if (!this->lod_dirty_)
+	{
+		return true;
+	}
+
+	DestructibleMapChunk *children[] = {
+		this->north_west_,
+		this->north_east_,
+		this->south_west_,
+		this->south_east_
+	};
+
+	// built from the levels of detail of the children (or the paths of the leaves), which have half of the tolerance.
+	// The chunk stays dirty until every leaf below it is resident again, paging it in marks it anyway
+	auto resident = true;
+	for (auto child : children)
+	{
+		resident = child->update_lod() && resident;
+	}
+	if (!resident)
+	{
+		return false;
+	}
+	this->lod_dirty_ = false;
+	map_profiler.count(COUNTER_LOD_BUILT);
+
+	ClipperScope scope;
+	auto &c = scope->clipper;
+	for (auto child : children)
+	{
+		child->paths_.get(scope->subject_paths);
+		c.AddPaths(scope->subject_paths, ClipperLib::ptSubject, true);
+	}
+
+	// the union first joins the paths along the borders of the children, so the simplification removes the points there
+	auto &result_poly_tree = scope->poly_tree;
+	auto &result_paths = scope->paths;
+	{
+		ProfileScope clip_scope(STAGE_CLIP);
+		c.Execute(ClipperLib::ctUnion, result_paths, ClipperLib::pftNonZero);
+
+		const auto tolerance = double(std::max(this->end_.x - this->begin_.x, this->end_.y - this->begin_.y)) * SCALE_FACTOR / this->config_->lod_pixels;
+		simplify_paths(result_paths, tolerance, scope->subject_paths);
+
+		// clipper fails on an empty subject, which happens if everything below the chunk is destroyed or smaller than the tolerance
+		result_poly_tree.Clear();
+		if (!scope->subject_paths.empty())
+		{
+			c.Clear();
+			c.StrictlySimple(true);
+			c.AddPaths(scope->subject_paths, ClipperLib::ptSubject, true);
+			if (!c.Execute(ClipperLib::ctUnion, result_poly_tree, ClipperLib::pftNonZero))
+			{
+				std::cout << "Could not create Polygon Tree" << std::endl;
+			}
+		}
+		ClipperLib::PolyTreeToPaths(result_poly_tree, result_paths);
+	}
+
+	// the old level of detail leaves its batch, it is placed again when it is drawn
+	if (this->batch_info_ != nullptr)
+	{
+		this->batch_info_->batch->dealloc_chunk(this);
+	}
+
+	ProfileScope triangulate_scope(STAGE_TRIANGULATE);
+	this->paths_.assign(result_paths);
+	triangulate_mesh(result_poly_tree, true, this->config_->triangulation_buffer, this->mesh_);
+	return true;
 }
 
 void DestructibleMapChunk::query_dirty(std::vector<DestructibleMapChunk*>& dirty_chunks)
@@ -333,41 +757,27 @@ void DestructibleMapChunk::update_batch(BatchInfo* info)
 	this->batch_info_ = info;
 }
 
-DestructibleMapChunk* DestructibleMapChunk::get_best_mergeable() const
+void DestructibleMapChunk::query_mergeable(std::vector<DestructibleMapChunk*>& mergeable)
 {
-	if (this->mergeable_count_ == 0)
+	if (this->mergeable_count_ == 0 || this->north_west_ == nullptr)
 	{
-		return nullptr;
+		return;
 	}
 
-	if (this->north_west_)
+	if (!this->north_west_->north_west_ && !this->north_east_->north_west_ && !this->south_west_->north_west_ && !this->south_east_->north_west_)
 	{
-		DestructibleMapChunk *directions[] = {
-			this->north_west_,
-			this->north_east_,
-			this->south_west_,
-			this->south_east_
-		};
-		
-		auto best_match = 0;
-		DestructibleMapChunk *selected = nullptr;
-		for (auto i = 0; i < 4; i++)
+		// the leaves are only counted if this chunk was marked as mergeable
+		if (this->north_west_->mergeable_count_ > 0)
 		{
-			auto &dir = directions[i];
-			if (best_match < dir->mergeable_count_)
-			{
-				best_match = dir->mergeable_count_;
-				selected = dir;
-			}
+			mergeable.push_back(this);
 		}
-		assert(selected != nullptr);
-
-		return selected->get_best_mergeable();
-	}
-	else
-	{
-		return this->parent_;
+		return;
 	}
+
+	this->north_west_->query_mergeable(mergeable);
+	this->north_east_->query_mergeable(mergeable);
+	this->south_west_->query_mergeable(mergeable);
+	this->south_east_->query_mergeable(mergeable);
 }
 
 DestructibleMapChunk* DestructibleMapChunk::query_chunk(glm::vec2 point)
@@ -1,14 +1,20 @@
 #pragma once
 
 #include "clipper.hpp"
+#include <algorithm>
 #include <glm/glm.hpp>
 #include "DestructibleMapDrawingBatch.h"
-#include "DestructibleMapController.h"
+#include "DestructibleMapConfiguration.h"
+#include "DestructibleMapChunkPool.h"
+#include "DestructibleMapGeometry.h"
+#include "DestructibleMapPager.h"
 
 extern int map_draw_calls;
+extern long long map_uploaded_bytes;
+extern int map_culled_batches;
 
 class DestructibleMap;
-class RenderingEngine;
+class DestructibleMapRenderer;
 class DestructibleMapDrawingBatch;
 
 class DestructibleMapChunk
@@ -24,20 +30,56 @@ class DestructibleMapChunk
 	DestructibleMapChunk *south_west_;
 	DestructibleMapChunk *south_east_;
 
-	ClipperLib::Paths paths_;
-	std::vector<glm::vec2> vertices_;
+	// an inner chunk keeps its level of detail here, the simplified paths and mesh of all of its leaves
+	DestructibleMapCompactPaths paths_;
+	DestructibleMapMesh mesh_;
+	// mesh inside of a memory mapped snapshot, used instead of mesh_ until the chunk is triangulated again
+	const glm::vec2 *mapped_vertices_;
+	const uint16_t *mapped_indices_;
+	int num_mapped_vertices_;
+	int num_mapped_indices_;
+	// a paged out leaf has neither paths nor vertices, they are in the page file of the map
+	bool paged_out_;
+	// the background thread is loading the page, it is released once the result is back
+	bool page_requested_;
+	DestructibleMapPage page_;
 
 	bool mesh_dirty_;
+	// set on the ancestors of a modified leaf, an inner chunk builds its level of detail again the next time it is drawn with it
+	bool lod_dirty_;
+	// changes with every modification of the geometry or the structure, results computed from an older copy are stale
+	unsigned int version_;
 
 	BatchInfo *batch_info_;
-	bool highlighted_;
-	ClipperLib::Path quad_;
+	BatchInfo batch_info_storage_;
+	// set by the pool, indexes the render attributes of the chunk
+	int id_;
 	int mergeable_count_;
 
+	const DestructibleMapConfig *config_;
+	DestructibleMapChunkPool *pool_;
+
 	void constructor();
+	void init(const DestructibleMapConfig *config, DestructibleMapChunkPool *pool, DestructibleMapChunk *parent, const glm::vec2 begin, const glm::vec2 end);
+	// empties the chunk but keeps the allocated memory, so it can be handed out by the pool again
+	void reset();
+	void release_children();
+	// acquires the four children from the pool, without any geometry
+	void create_children();
+	void mark_mesh_dirty();
+	// marks the chunk and its ancestors, the caller holds the lock of the dirty flags
+	void mark_lod_dirty();
+	// drops the geometry (and the memory behind it) after it was written to the page
+	void page_out(const DestructibleMapPage &page);
+	// drops the level of detail (and its place in a batch) before an inner chunk becomes a leaf
+	void release_lod();
+	// builds the level of detail of an inner chunk and of its inner descendants if they are dirty.
+	// Returns false if a leaf below is paged out, then the level of detail is not built (a leaf returns if it is resident)
+	bool update_lod();
+	bool retriangulate_region(const ClipperLib::Paths &paths, const glm::ivec2 &modified_begin, const glm::ivec2 &modified_end, std::vector<glm::vec2> &triangles);
 public:
 
-	explicit DestructibleMapChunk(DestructibleMapChunk *parent, const glm::vec2 begin, const glm::vec2 end);
+	explicit DestructibleMapChunk(const DestructibleMapConfig *config, DestructibleMapChunkPool *pool, DestructibleMapChunk *parent, const glm::vec2 begin, const glm::vec2 end);
 	DestructibleMapChunk();
 	~DestructibleMapChunk();
 
@@ -55,6 +97,10 @@ public:
 	DestructibleMapChunk *query_chunk(glm::vec2 point);
 
 	void set_paths(const ClipperLib::Paths &paths, const ClipperLib::PolyTree &poly_tree, bool fast);
+	// takes over geometry computed somewhere else (e.g. by the background thread), the previous geometry ends up in the arguments (without the mapped mesh)
+	void swap_geometry(DestructibleMapCompactPaths &paths, DestructibleMapMesh &mesh);
+	// keeps all triangles outside of the modified region (in Clipper coordinates) and only triangulates the rest again
+	void set_paths_incremental(const ClipperLib::Paths &paths, const ClipperLib::PolyTree &poly_tree, const glm::ivec2 &modified_begin, const glm::ivec2 &modified_end);
 
 	void query_dirty(std::vector<DestructibleMapChunk*>& dirty_chunks);
 
@@ -64,20 +110,72 @@ public:
 		return this->batch_info_;
 	}
 
-	ClipperLib::Paths& get_paths()
+	// decodes the compact paths, reusing the memory of the argument
+	void get_paths(ClipperLib::Paths &paths) const
+	{
+		this->paths_.get(paths);
+	}
+
+	const DestructibleMapCompactPaths &get_compact_paths() const
 	{
-		return paths_;
+		return this->paths_;
 	}
 
+	// the rectangle of the chunk in Clipper coordinates, reusing the memory of the argument
+	void get_quad(ClipperLib::Path &quad) const;
+
+	// distinct vertices of the triangles
+	const glm::vec2 *get_vertices() const
+	{
+		return this->mapped_vertices_ != nullptr ? this->mapped_vertices_ : this->mesh_.vertices.data();
+	}
+
+	int get_num_vertices() const
+	{
+		return this->mapped_vertices_ != nullptr ? this->num_mapped_vertices_ : int(this->mesh_.vertices.size());
+	}
+
+	// three per triangle
+	const uint16_t *get_indices() const
+	{
+		return this->mapped_vertices_ != nullptr ? this->mapped_indices_ : this->mesh_.indices.data();
+	}
 
-	void set_highlighted(bool highlight)
+	int get_num_indices() const
 	{
-		this->highlighted_ = highlight;
+		return this->mapped_vertices_ != nullptr ? this->num_mapped_indices_ : int(this->mesh_.indices.size());
 	}
 
-	DestructibleMapChunk *get_best_mergeable() const;
+	// vertices the chunk takes in a batch, including the ones reserved for its indices
+	int get_batch_size() const
+	{
+		return std::max(this->get_num_vertices(), (this->get_num_indices() + BATCH_INDICES_PER_VERTEX - 1) / BATCH_INDICES_PER_VERTEX);
+	}
+
+
+	bool is_paged_out() const
+	{
+		return this->paged_out_;
+	}
+
+	// memory used by the geometry and the points of the chunk
+	size_t get_resident_bytes() const;
+
+	int get_id() const
+	{
+		return this->id_;
+	}
+
+	// changes the CHUNK_ATTRIBUTE_HIGHLIGHTED flag in the attribute table of the pool, the chunk is drawn highlighted without touching its batch
+	void set_highlighted(bool highlight);
+	bool is_highlighted() const;
+
+	// chunks whose four leaves were marked as mergeable, only descends into chunks with a mergeable count
+	void query_mergeable(std::vector<DestructibleMapChunk*> &mergeable);
 
 
 	friend DestructibleMap;
+	friend DestructibleMapRenderer;
 	friend DestructibleMapDrawingBatch;
+	friend DestructibleMapChunkPool;
 };
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "DestructibleMapChunkPool.h"
+#include <algorithm>
+#include "DestructibleMapChunk.h"
+#include "DestructibleMapProfiler.h"
+
+DestructibleMapChunkPool::DestructibleMapChunkPool()
+{
+	// the root chunk
+	this->attributes_.push_back(0);
+	this->attributes_dirty_ = true;
+	this->attributes_dirty_begin_ = 0;
+	this->attributes_dirty_end_ = 1;
+}
+
+DestructibleMapChunkPool::~DestructibleMapChunkPool()
+{
+	for (auto slab : this->slabs_)
+	{
+		delete[] slab;
+	}
+}
+
+void DestructibleMapChunkPool::allocate_slab()
+{
+	map_profiler.count(COUNTER_CHUNK_SLAB_ALLOCATED);
+
+	const auto slab = new DestructibleMapChunk[CHUNK_POOL_GROUPS_PER_SLAB * 4];
+	this->slabs_.push_back(slab);
+
+	const auto first_id = int(this->attributes_.size());
+	for (auto i = 0; i < CHUNK_POOL_GROUPS_PER_SLAB * 4; i++)
+	{
+		slab[i].id_ = first_id + i;
+	}
+	this->attributes_.resize(first_id + CHUNK_POOL_GROUPS_PER_SLAB * 4, 0);
+	this->attributes_dirty_begin_ = this->attributes_dirty_ ? this->attributes_dirty_begin_ : first_id;
+	this->attributes_dirty_end_ = int(this->attributes_.size());
+	this->attributes_dirty_ = true;
+
+	// hand out the groups in memory order
+	this->free_groups_.reserve(this->free_groups_.size() + CHUNK_POOL_GROUPS_PER_SLAB);
+	for (auto i = CHUNK_POOL_GROUPS_PER_SLAB - 1; i >= 0; i--)
+	{
+		this->free_groups_.push_back(slab + i * 4);
+	}
+}
+
+DestructibleMapChunk* DestructibleMapChunkPool::acquire()
+{
+	map_profiler.count(COUNTER_CHUNK_GROUP_ACQUIRED);
+
+	if (this->free_groups_.empty())
+	{
+		this->allocate_slab();
+	}
+	const auto group = this->free_groups_.back();
+	this->free_groups_.pop_back();
+	return group;
+}
+
+void DestructibleMapChunkPool::release(DestructibleMapChunk *group)
+{
+	this->free_groups_.push_back(group);
+}
+
+void DestructibleMapChunkPool::set_attributes(int id, uint32_t attributes)
+{
+	if (this->attributes_[id] == attributes)
+	{
+		return;
+	}
+
+	this->attributes_[id] = attributes;
+	if (this->attributes_dirty_)
+	{
+		this->attributes_dirty_begin_ = std::min(this->attributes_dirty_begin_, id);
+		this->attributes_dirty_end_ = std::max(this->attributes_dirty_end_, id + 1);
+	}
+	else
+	{
+		this->attributes_dirty_begin_ = id;
+		this->attributes_dirty_end_ = id + 1;
+		this->attributes_dirty_ = true;
+	}
+}
+
+bool DestructibleMapChunkPool::take_dirty_attributes(int &begin, int &end)
+{
+	if (!this->attributes_dirty_)
+	{
+		return false;
+	}
+
+	begin = this->attributes_dirty_begin_;
+	end = this->attributes_dirty_end_;
+	this->attributes_dirty_ = false;
+	return true;
+}
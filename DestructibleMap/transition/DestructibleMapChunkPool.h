@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class DestructibleMapChunk;
+
+// hands out groups of four sibling chunks, which lie next to each other in memory.
+// Released groups keep their allocated paths and vertices, so a subdivide after a merge does not need the heap.
+// Only used from the merge/subdivide stage, which runs on one thread.
+// Every chunk of the pool has a fixed id (the root chunk, which is not part of the pool, has id 0), which indexes the render attributes of the chunks.
+class DestructibleMapChunkPool
+{
+	std::vector<DestructibleMapChunk*> slabs_;
+	std::vector<DestructibleMapChunk*> free_groups_;
+	// CHUNK_ATTRIBUTE_* flags by chunk id, with the ids changed since they were last uploaded
+	std::vector<uint32_t> attributes_;
+	bool attributes_dirty_;
+	int attributes_dirty_begin_;
+	int attributes_dirty_end_;
+
+	void allocate_slab();
+public:
+	DestructibleMapChunkPool();
+	~DestructibleMapChunkPool();
+
+	DestructibleMapChunkPool(const DestructibleMapChunkPool&) = delete;
+	DestructibleMapChunkPool& operator=(const DestructibleMapChunkPool&) = delete;
+
+	// returns the first of four chunks
+	DestructibleMapChunk *acquire();
+	void release(DestructibleMapChunk *group);
+
+	int get_num_slabs() const
+	{
+		return int(this->slabs_.size());
+	}
+
+	void set_attributes(int id, uint32_t attributes);
+
+	uint32_t get_attributes(int id) const
+	{
+		return this->attributes_[id];
+	}
+
+	const std::vector<uint32_t> &get_all_attributes() const
+	{
+		return this->attributes_;
+	}
+
+	// the range of ids whose attributes changed since the last call, false if none did
+	bool take_dirty_attributes(int &begin, int &end);
+};
@@ -0,0 +1,44 @@
+#include "DestructibleMapClipperContext.h"
+#include <memory>
+#include <vector>
+
+namespace
+{
+	// contexts which are currently not borrowed, a thread only ever creates as many as it had borrowed at once
+	struct ClipperContextList
+	{
+		std::vector<std::unique_ptr<ClipperContext>> free_contexts;
+	};
+
+	ClipperContextList &get_context_list()
+	{
+		static thread_local ClipperContextList list;
+		return list;
+	}
+}
+
+ClipperScope::ClipperScope()
+{
+	auto &list = get_context_list();
+	if (list.free_contexts.empty())
+	{
+		this->context_ = new ClipperContext();
+	}
+	else
+	{
+		this->context_ = list.free_contexts.back().release();
+		list.free_contexts.pop_back();
+	}
+
+	auto &clipper = this->context_->clipper;
+	clipper.StrictlySimple(false);
+	clipper.ReverseSolution(false);
+	clipper.PreserveCollinear(false);
+}
+
+ClipperScope::~ClipperScope()
+{
+	// only gives the edges back, the memory stays with the context
+	this->context_->clipper.Clear();
+	get_context_list().free_contexts.emplace_back(this->context_);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "clipper.hpp"
+
+// a Clipper together with buffers for its input and output, which all keep their memory between clipping operations
+struct ClipperContext
+{
+	ClipperLib::Clipper clipper;
+	ClipperLib::PolyTree poly_tree;
+	ClipperLib::Paths paths;
+	ClipperLib::Paths subject_paths;
+	ClipperLib::Paths clip_paths;
+	// rectangle of the chunk which is clipped
+	ClipperLib::Path quad;
+};
+
+// borrows a context of the calling thread for the lifetime of the scope, the clipper is cleared and has the default options.
+// Scopes may be nested, e.g. apply_polygon passes its result to the children while its own context is still borrowed.
+class ClipperScope
+{
+	ClipperContext *context_;
+public:
+	ClipperScope();
+	~ClipperScope();
+
+	ClipperScope(const ClipperScope&) = delete;
+	ClipperScope& operator=(const ClipperScope&) = delete;
+
+	ClipperContext* operator->() const
+	{
+		return this->context_;
+	}
+
+	ClipperContext& operator*() const
+	{
+		return *this->context_;
+	}
+};
@@ -1,12 +1,17 @@
 #pragma once
 
-// how many vertices are allowed per batch?
-#define VERTICES_PER_BATCH (4096)
+// The defines marked as "default" are only the defaults of DestructibleMapConfig, they can be changed at runtime per map.
 
-// how many batches are available on start
+// default: how many vertices are allowed per batch? At most 65536, the indices of a batch are 16 bit
+#define VERTICES_PER_BATCH (2048)
+
+// how many indices are reserved in a batch for every vertex, a chunk with more indices takes more vertices of the batch
+#define BATCH_INDICES_PER_VERTEX (3)
+
+// default: how many batches are available on start
 #define NUM_START_BATCHES (64)
 
-// how many vertices per chunk should be allowed
+// default: how many vertices per chunk should be allowed
 #define VERTICES_PER_CHUNK (64)
 
 // factor from real coordinates to Clipper coordinates
@@ -15,9 +20,31 @@
 // factor from Clipper coordinates to real coordinates
 #define SCALE_FACTOR_INV (1.0f/SCALE_FACTOR)
 
-// how big is the triangulation buffer (used when fast triangulation is performed, this is the maximum number of points allowed)
+// default: how big is the triangulation buffer (used when fast triangulation is performed, this is the maximum number of points allowed)
 #define TRIANGULATION_BUFFER (VERTICES_PER_CHUNK*3)
 
+// how many batches are checked in each direction of the Morton order for a batch close to a chunk
+#define MORTON_NEIGHBOUR_BATCHES (4)
+
+// how many groups of four sibling chunks are allocated at once by the chunk pool
+#define CHUNK_POOL_GROUPS_PER_SLAB (64)
+
+// seed used for generating the map and its point cloud, the same seed always results in the same map
+#define GENERATE_SEED (1)
+
+// file the viewer loads the map from, the map is generated and written there if the file does not exist or was written with another DestructibleMapConfig
+// (delete it after changing the GENERATE_ defines)
+#define MAP_SNAPSHOT_FILE "map.dmsnap"
+
+// file the leaves are paged out to if the viewer runs with a resident_bytes_limit, it is deleted again when the map is destroyed
+#define MAP_PAGE_FILE "map.dmpages"
+
+// how many operations a DestructibleMapJournal records between two checkpoints (snapshots of the whole map)
+#define JOURNAL_CHECKPOINT_INTERVAL (1000)
+
+// how long a DestructibleMapJournal collects records before they are written, unless a flush or a checkpoint is requested
+#define JOURNAL_FLUSH_MILLISECONDS (100)
+
 // how many rects should be generated
 #define GENERATE_NUM_RECTS (500)
 
@@ -36,11 +63,97 @@
 // maximum size of shapes (in real coordinates)
 #define GENERATE_MAX_SIZE (300)
 
-// area*MAP_TRIANGLE_AREA_RATIO many points are being used for monte carlo point cloud approximation for the quadtree
+// default: area*MAP_TRIANGLE_AREA_RATIO many points are being used for monte carlo point cloud approximation for the quadtree
 #define MAP_TRIANGLE_AREA_RATIO (0.025f)
 
-// x=total_points*MAP_POINTS_PER_LEAF_RATIO is the maximum number of points which should be stored in each leaf in the quad tree (if number is greater than x a new leaf is generated).
+// default: x=total_points*MAP_POINTS_PER_LEAF_RATIO is the maximum number of points which should be stored in each leaf in the quad tree (if number is greater than x a new leaf is generated).
 #define MAP_POINTS_PER_LEAF_RATIO (0.0005f)
 
-// is subdividing/merging enabled?
-#define ENABLE_MERGING_SUBDIVIDING
\ No newline at end of file
+// default: is subdividing/merging enabled?
+#define ENABLE_MERGING_SUBDIVIDING
+
+// default: are batches looked up by their free capacity (best fit in O(log n)) instead of a linear first fit search?
+#define ENABLE_BATCH_FREE_INDEX
+
+// default: are chunks placed into batches close to them (Morton order), so the batches can be culled?
+#define ENABLE_SPATIAL_BATCH_PACKING
+
+// default: how many microseconds update_batches may spend on swapping in results of submitted operations per frame (at least one result is always applied, 0 means no limit)
+#define ASYNC_APPLY_BUDGET_MICROSECONDS (2000)
+
+// default: how many microseconds update_batches may spend on merging and deferred subdividing of chunks per frame (at least one of them is always done, 0 means no limit)
+#define MAINTENANCE_BUDGET_MICROSECONDS (500)
+
+// default: how many bytes the geometry of the leaves may use before the leaves furthest away from the active region are paged out (0 means no limit, paging needs a page file, see DestructibleMap::set_page_file)
+#define RESIDENT_BYTES_LIMIT (0)
+
+// default: leaves closer than this to the active region (in real coordinates) are paged in ahead of time and never paged out
+#define PAGE_IN_DISTANCE (500.0f)
+
+// default: an inner chunk of the quad tree which covers fewer pixels on the screen than this is drawn with its level of detail instead of its leaves.
+// The level of detail is simplified by the size of the chunk / LOD_PIXELS, so by about a pixel once it is drawn (0 disables the levels of detail)
+#define LOD_PIXELS (128.0f)
+
+// default: is incremental triangulation enabled? (only the triangles touching a modification are triangulated again)
+//#define ENABLE_INCREMENTAL_TRIANGULATION
+
+struct DestructibleMapConfig
+{
+	int vertices_per_batch;
+	int num_start_batches;
+	int vertices_per_chunk;
+	int triangulation_buffer;
+	float triangle_area_ratio;
+	float points_per_leaf_ratio;
+	bool enable_merging_subdividing;
+	bool incremental_triangulation;
+	bool batch_free_index;
+	bool spatial_batch_packing;
+	int async_apply_budget_microseconds;
+	int maintenance_budget_microseconds;
+	long long resident_bytes_limit;
+	float page_in_distance;
+	float lod_pixels;
+
+	DestructibleMapConfig()
+	{
+		this->vertices_per_batch = VERTICES_PER_BATCH;
+		this->num_start_batches = NUM_START_BATCHES;
+		this->vertices_per_chunk = VERTICES_PER_CHUNK;
+		this->triangulation_buffer = TRIANGULATION_BUFFER;
+		this->triangle_area_ratio = MAP_TRIANGLE_AREA_RATIO;
+		this->points_per_leaf_ratio = MAP_POINTS_PER_LEAF_RATIO;
+		this->async_apply_budget_microseconds = ASYNC_APPLY_BUDGET_MICROSECONDS;
+		this->maintenance_budget_microseconds = MAINTENANCE_BUDGET_MICROSECONDS;
+		this->resident_bytes_limit = RESIDENT_BYTES_LIMIT;
+		this->page_in_distance = PAGE_IN_DISTANCE;
+		this->lod_pixels = LOD_PIXELS;
+#ifdef ENABLE_MERGING_SUBDIVIDING
+		this->enable_merging_subdividing = true;
+#else
+		this->enable_merging_subdividing = false;
+#endif
+#ifdef ENABLE_BATCH_FREE_INDEX
+		this->batch_free_index = true;
+#else
+		this->batch_free_index = false;
+#endif
+#ifdef ENABLE_SPATIAL_BATCH_PACKING
+		this->spatial_batch_packing = true;
+#else
+		this->spatial_batch_packing = false;
+#endif
+#ifdef ENABLE_INCREMENTAL_TRIANGULATION
+		this->incremental_triangulation = true;
+#else
+		this->incremental_triangulation = false;
+#endif
+	}
+
+	// sets the chunk size together with the triangulation buffer that depends on it
+	void set_vertices_per_chunk(int vertices_per_chunk)
+	{
+		this->vertices_per_chunk = vertices_per_chunk;
+		this->triangulation_buffer = vertices_per_chunk * 3;
+	}
+};
@@ -2,11 +2,13 @@
 #include <GLFW/glfw3.h>
 #include "RenderingEngine.h"
 #include "DestructibleMap.h"
+#include "DestructibleMapRenderer.h"
 #include <glm/gtc/matrix_transform.hpp>
 
-DestructibleMapController::DestructibleMapController(DestructibleMap *map) 
+DestructibleMapController::DestructibleMapController(DestructibleMap *map, DestructibleMapRenderer *renderer)
 {
 	this->map_ = map;
+	this->renderer_ = renderer;
 	this->highlighted_chunk_ = nullptr;
 }
 
@@ -42,7 +44,8 @@ void DestructibleMapController::update(double delta)
 		if (b1 || b2) {
 			//std::cout << "Picked " << pick_pos.x << " " << pick_pos.y << " " << pick_pos.z << std::endl;
 			const auto circle = make_circle(glm::ivec2(pick_pos.x * SCALE_FACTOR, pick_pos.y * SCALE_FACTOR), 10 * SCALE_FACTOR, 16);
-			map_->apply_polygon_operation(circle, b1 ? ClipperLib::ctDifference : ClipperLib::ctUnion);
+			// clipped and triangulated in the background, the map swaps the result in at the start of a later frame
+			map_->submit_polygon_operation(circle, b1 ? ClipperLib::ctDifference : ClipperLib::ctUnion);
 		}
 
 		if (this->highlighted_chunk_)
@@ -58,7 +61,7 @@ void DestructibleMapController::update(double delta)
 
 	if (glfwGetKey(this->rendering_engine_->get_window(), GLFW_KEY_2))
 	{
-		map_->update_quadtree_representation();
+		renderer_->update_quadtree_representation();
 	}
 
 	const auto sx = glfwGetKey(this->rendering_engine_->get_window(), GLFW_KEY_A) - glfwGetKey(this->rendering_engine_->get_window(), GLFW_KEY_D);
@@ -4,15 +4,17 @@
 class RenderingEngine;
 class DestructibleMap;
 class DestructibleMapChunk;
+class DestructibleMapRenderer;
 
 class DestructibleMapController
 {
 	glm::mat4 proj_inverse_;
 	DestructibleMap* map_;
+	DestructibleMapRenderer* renderer_;
 	RenderingEngine* rendering_engine_;
 	DestructibleMapChunk *highlighted_chunk_;
 public:
-	explicit DestructibleMapController(DestructibleMap *map_);
+	explicit DestructibleMapController(DestructibleMap *map, DestructibleMapRenderer *renderer);
 	~DestructibleMapController();
 
 	void update(double delta);
@@ -0,0 +1,94 @@
+#include "DestructibleMapCulling.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+DestructibleMapFrustum extract_frustum(const glm::mat4 &view_projection)
+{
+	// Gribb/Hartmann: the planes are sums/differences of the last row with the other rows (glm is column major)
+	glm::vec4 rows[4];
+	for (auto i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+	}
+
+	DestructibleMapFrustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	return frustum;
+}
+
+bool is_box_visible(const DestructibleMapFrustum &frustum, const glm::vec2 &begin, const glm::vec2 &end)
+{
+	for (auto &plane : frustum.planes)
+	{
+		// the corner which is the furthest inside of the plane, if it is outside the whole box is
+		const auto corner = glm::vec2(
+			plane.x >= 0.0f ? end.x : begin.x,
+			plane.y >= 0.0f ? end.y : begin.y
+		);
+		if (plane.x * corner.x + plane.y * corner.y + plane.w < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool get_visible_rect(const glm::mat4 &view_projection, glm::vec2 &begin, glm::vec2 &end)
+{
+	const auto inverse = glm::inverse(view_projection);
+	begin = glm::vec2(std::numeric_limits<float>::max());
+	end = glm::vec2(-std::numeric_limits<float>::max());
+	for (auto i = 0; i < 4; i++)
+	{
+		// ray through the corner from the near to the far plane
+		const auto ndc = glm::vec2(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f);
+		auto near_point = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+		auto far_point = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+		near_point /= near_point.w;
+		far_point /= far_point.w;
+
+		const auto dz = far_point.z - near_point.z;
+		if (std::abs(dz) < 1e-6f)
+		{
+			return false;
+		}
+		const auto t = -near_point.z / dz;
+		if (t < 0.0f || t > 1.0f)
+		{
+			return false;
+		}
+
+		const auto point = glm::vec2(near_point + (far_point - near_point) * t);
+		begin = glm::min(begin, point);
+		end = glm::max(end, point);
+	}
+	return true;
+}
+
+float get_projected_size(const glm::mat4 &view_projection, const glm::vec2 &viewport_size, const glm::vec2 &begin, const glm::vec2 &end)
+{
+	auto projected_begin = glm::vec2(std::numeric_limits<float>::max());
+	auto projected_end = glm::vec2(-std::numeric_limits<float>::max());
+	for (auto i = 0; i < 4; i++)
+	{
+		const auto corner = view_projection * glm::vec4(i & 1 ? end.x : begin.x, i & 2 ? end.y : begin.y, 0.0f, 1.0f);
+		if (corner.w <= 0.0f)
+		{
+			return std::numeric_limits<float>::max();
+		}
+
+		const auto ndc = glm::vec2(corner) / corner.w;
+		projected_begin = glm::min(projected_begin, ndc);
+		projected_end = glm::max(projected_end, ndc);
+	}
+
+	// normalized device coordinates span 2 units over the viewport
+	const auto size = (projected_end - projected_begin) * viewport_size * 0.5f;
+	return std::max(size.x, size.y);
+}
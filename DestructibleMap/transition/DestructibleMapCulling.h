@@ -0,0 +1,20 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// planes of the view frustum, a point p is inside of a plane if dot(plane.xyz, p) + plane.w >= 0
+struct DestructibleMapFrustum
+{
+	glm::vec4 planes[6];
+};
+
+// extracts the frustum planes of the combined matrix (projection * view), no GPU is needed for culling
+DestructibleMapFrustum extract_frustum(const glm::mat4 &view_projection);
+
+// the map lies in the z = 0 plane, so only a 2D box has to be tested. Conservative: may return true for boxes close to a corner of the frustum.
+bool is_box_visible(const DestructibleMapFrustum &frustum, const glm::vec2 &begin, const glm::vec2 &end);
+
+// bounding box of the part of the z = 0 plane the camera sees, false if a corner of the view does not hit the plane
+bool get_visible_rect(const glm::mat4 &view_projection, glm::vec2 &begin, glm::vec2 &end);
+
+// size in pixels of the bigger side of the bounding box of the projected box, the maximum float if a corner is behind the camera
+float get_projected_size(const glm::mat4 &view_projection, const glm::vec2 &viewport_size, const glm::vec2 &begin, const glm::vec2 &end);
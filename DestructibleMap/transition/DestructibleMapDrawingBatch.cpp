@@ -2,26 +2,41 @@
 #include "DestructibleMapChunk.h"
 #include <cassert>
 #include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include "DestructibleMapUtility.h"
 
-DestructibleMapDrawingBatch::DestructibleMapDrawingBatch()
+DestructibleMapDrawingBatch::DestructibleMapDrawingBatch(int capacity)
 {
-	this->vao_ = 0;
-	this->vbo_ = 0;
+	this->buffer_ = nullptr;
+	this->capacity_ = capacity;
 	this->allocated_ = 0;
+	this->used_ = 0;
 	this->is_dirty_ = false;
+	this->dirty_begin_ = 0;
+	this->dirty_end_ = 0;
+	this->indices_dirty_ = false;
+	this->index_dirty_begin_ = 0;
+	this->index_dirty_end_ = 0;
+	this->commands_dirty_ = false;
+	this->free_index_ = nullptr;
+	this->index_ = -1;
+	this->indexed_free_ = 0;
+	this->bounds_begin_ = glm::vec2(0.0f, 0.0f);
+	this->bounds_end_ = glm::vec2(0.0f, 0.0f);
+	this->bounds_dirty_ = false;
 
-#pragma omp parallel for
-	for (auto i = 0; i < VERTICES_PER_BATCH * 2; i++)
-	{
-		this->vertex_data_[i] = 0.0;
-	}
+	assert(capacity <= MAX_MESH_VERTICES);
+	this->vertex_data_.resize(capacity * 2, 0.0f);
+	this->index_data_.resize(capacity * BATCH_INDICES_PER_VERTEX, 0);
+	this->add_free_range(0, capacity);
 }
 
 
 DestructibleMapDrawingBatch::~DestructibleMapDrawingBatch()
 {
-	glDeleteVertexArrays(1, &this->vao_);
-	glDeleteBuffers(1, &this->vbo_);
+	delete this->buffer_;
 
 	for (auto &info : this->infos_)
 	{
@@ -29,103 +44,269 @@ DestructibleMapDrawingBatch::~DestructibleMapDrawingBatch()
 		{
 			info->chunk->update_batch(nullptr);
 		}
-		delete info;
 	}
 }
 
-void DestructibleMapDrawingBatch::draw(DestructibleMapShader *shader)
+void DestructibleMapDrawingBatch::upload()
 {
-	if (this->is_dirty_)
+	if (this->is_dirty_ || this->indices_dirty_)
 	{
-		assert(VERTICES_PER_BATCH >= this->allocated_);
+		assert(this->capacity_ >= this->allocated_);
+		assert(!this->is_dirty_ || (this->dirty_begin_ >= 0 && this->dirty_end_ <= this->allocated_));
+		assert(!this->indices_dirty_ || (this->index_dirty_begin_ >= 0 && this->index_dirty_end_ <= this->allocated_ * BATCH_INDICES_PER_VERTEX));
 
-		glBindBuffer(GL_ARRAY_BUFFER, this->vbo_);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * this->allocated_ * 2, this->vertex_data_, GL_DYNAMIC_DRAW);
+		// only the changed ranges are sent to the GPU
+		const auto num_vertices = this->is_dirty_ ? this->dirty_end_ - this->dirty_begin_ : 0;
+		const auto num_indices = this->indices_dirty_ ? this->index_dirty_end_ - this->index_dirty_begin_ : 0;
+		this->buffer_->upload(this->vertex_data_.data(), this->dirty_begin_, num_vertices, this->index_data_.data(), this->index_dirty_begin_, num_indices);
+		map_uploaded_bytes += sizeof(float) * num_vertices * 2 + sizeof(uint16_t) * num_indices;
+		this->is_dirty_ = false;
+		this->indices_dirty_ = false;
+	}
 
+	if (this->commands_dirty_)
+	{
+		this->buffer_->upload_commands(this->commands_.data(), int(this->commands_.size()));
+		map_uploaded_bytes += sizeof(BatchDrawCommand) * this->commands_.size();
+		this->commands_dirty_ = false;
 	}
+}
 
-	if (this->allocated_ > 0) {
-		glBindVertexArray(this->vao_);
-		glDrawArrays(GL_TRIANGLES, 0, this->allocated_);
-		map_draw_calls++;
+void DestructibleMapDrawingBatch::draw()
+{
+	this->upload();
+	if (!this->commands_.empty()) {
+		this->buffer_->draw();
 	}
 }
 
-void DestructibleMapDrawingBatch::init()
+void DestructibleMapDrawingBatch::draw_chunk(const BatchInfo *info)
 {
-	glGenVertexArrays(1, &this->vao_);
-	glGenBuffers(1, &this->vbo_);
-	glBindVertexArray(vao_);
+	assert(info->batch == this);
+	this->upload();
+	this->buffer_->draw_command(info->batch_index);
+}
+
+void DestructibleMapDrawingBatch::init(IBatchBackend *backend)
+{
+	this->buffer_ = backend->create_buffer(this->capacity_, this->capacity_ * BATCH_INDICES_PER_VERTEX);
+}
+
+void DestructibleMapDrawingBatch::add_free_range(int offset, int size)
+{
+	this->free_ranges_[offset] = size;
+	this->free_sizes_.insert(std::make_pair(size, offset));
+}
+
+void DestructibleMapDrawingBatch::remove_free_range(int offset, int size)
+{
+	this->free_ranges_.erase(offset);
+	this->free_sizes_.erase(std::make_pair(size, offset));
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, this->vbo_);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * VERTICES_PER_BATCH * 2, this->vertex_data_, GL_DYNAMIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
-	glBindVertexArray(0);
+void DestructibleMapDrawingBatch::mark_dirty(bool &is_dirty, int &begin, int &end, int offset, int size)
+{
+	if (!is_dirty)
+	{
+		begin = offset;
+		end = offset + size;
+		is_dirty = true;
+	}
+	else
+	{
+		begin = std::min(begin, offset);
+		end = std::max(end, offset + size);
+	}
 }
 
 bool DestructibleMapDrawingBatch::is_free(int for_size) const
 {
-	return (this->allocated_ + for_size) < VERTICES_PER_BATCH;
+	return this->get_biggest_free() > for_size;
+}
+
+int DestructibleMapDrawingBatch::get_biggest_free() const
+{
+	// the biggest free range is the last one
+	return this->free_sizes_.empty() ? 0 : this->free_sizes_.rbegin()->first;
+}
+
+void DestructibleMapDrawingBatch::set_free_index(BatchFreeIndex *free_index, int index)
+{
+	this->free_index_ = free_index;
+	this->index_ = index;
+	this->indexed_free_ = this->get_biggest_free();
+	this->free_index_->insert(std::make_pair(this->indexed_free_, this->index_));
+}
+
+void DestructibleMapDrawingBatch::update_free_index()
+{
+	const auto biggest_free = this->get_biggest_free();
+	if (this->free_index_ == nullptr || biggest_free == this->indexed_free_)
+	{
+		return;
+	}
+
+	this->free_index_->erase(std::make_pair(this->indexed_free_, this->index_));
+	this->indexed_free_ = biggest_free;
+	this->free_index_->insert(std::make_pair(this->indexed_free_, this->index_));
 }
 
 void DestructibleMapDrawingBatch::alloc_chunk(DestructibleMapChunk *chunk)
 {
-	assert(this->is_free(chunk->vertices_.size()));
+	assert(this->is_free(chunk->get_batch_size()));
 	assert(chunk->get_batch_info() == nullptr);
 
-	const auto new_vertices_count = chunk->vertices_.size();
+	// the vertices are shared by the triangles, a chunk with many indices takes more vertices to have room for them
+	const auto new_vertices_count = chunk->get_batch_size();
+	const auto num_vertices = chunk->get_num_vertices();
+	const auto num_indices = chunk->get_num_indices();
+	const auto vertices = chunk->get_vertices();
+	const auto indices = chunk->get_indices();
 
-	auto info = new BatchInfo();
+	// best fit: smallest free range the chunk fits into
+	const auto range = *this->free_sizes_.lower_bound(std::make_pair(new_vertices_count, 0));
+	const auto offset = range.second;
+	this->remove_free_range(range.second, range.first);
+	if (range.first > new_vertices_count)
+	{
+		this->add_free_range(offset + new_vertices_count, range.first - new_vertices_count);
+	}
+
+	// the info is stored inside of the chunk, so moving a chunk between batches does not allocate
+	auto info = &chunk->batch_info_storage_;
 	info->batch = this;
 	info->chunk = chunk;
 	info->batch_index = this->infos_.size();
-	info->offset = this->allocated_;
+	info->offset = offset;
 	info->size = new_vertices_count;
 
-	// update array
-#pragma omp parallel for
-	for (auto i = 0; i < new_vertices_count; i++)
+	// the cell of the chunk may be much bigger than its geometry, so the vertices are used for the bounding box
+	const auto max_float = std::numeric_limits<float>::max();
+	info->begin = glm::vec2(max_float, max_float);
+	info->end = glm::vec2(-max_float, -max_float);
+	generate_aabb(vertices, num_vertices, info->begin, info->end);
+	if (this->infos_.empty())
+	{
+		this->bounds_begin_ = info->begin;
+		this->bounds_end_ = info->end;
+	}
+	else
 	{
-		const auto vertex = chunk->vertices_[i];
+		this->bounds_begin_ = glm::min(this->bounds_begin_, info->begin);
+		this->bounds_end_ = glm::max(this->bounds_end_, info->end);
+	}
 
-		this->vertex_data_[(this->allocated_ + i) * 2] = vertex.x;
-		this->vertex_data_[(this->allocated_ + i) * 2 + 1] = vertex.y;
+	// update arrays, a chunk has too few vertices to be worth more than one thread
+	for (auto i = 0; i < num_vertices; i++)
+	{
+		this->vertex_data_[(offset + i) * 2] = vertices[i].x;
+		this->vertex_data_[(offset + i) * 2 + 1] = vertices[i].y;
 	}
 
-	this->allocated_ += new_vertices_count;
-	this->is_dirty_ = true;
+	// the indices of the chunk are rebased to its offset
+	const auto first_index = offset * BATCH_INDICES_PER_VERTEX;
+	for (auto i = 0; i < num_indices; i++)
+	{
+		this->index_data_[first_index + i] = uint16_t(offset + indices[i]);
+	}
+
+	this->allocated_ = std::max(this->allocated_, offset + new_vertices_count);
+	this->used_ += new_vertices_count;
+	mark_dirty(this->is_dirty_, this->dirty_begin_, this->dirty_end_, offset, num_vertices);
+	mark_dirty(this->indices_dirty_, this->index_dirty_begin_, this->index_dirty_end_, first_index, num_indices);
 	this->infos_.push_back(info);
+	this->commands_.push_back({ first_index, num_indices, chunk->get_id() });
+	this->commands_dirty_ = true;
 	chunk->update_batch(info);
+	this->update_free_index();
 }
 
 void DestructibleMapDrawingBatch::dealloc_chunk(DestructibleMapChunk* chunk)
 {
 	auto info = chunk->get_batch_info();
-	const auto batch_index = info->offset;
-	const auto batch_size = info->size;
+	auto offset = info->offset;
+	auto size = info->size;
 
-	assert(batch_index >= 0 && batch_size >= 0);
+	assert(offset >= 0 && size >= 0);
 	assert(info->batch == this);
 
-	// update array
-	for (auto i = batch_index + batch_size; i < this->allocated_; i++)
+	// only the command of the chunk is removed, its vertices and indices stay where they are until the range is reused
+	this->used_ -= size;
+
+	// coalesce with the free neighbours
+	auto next = this->free_ranges_.lower_bound(offset);
+	if (next != this->free_ranges_.end() && next->first == offset + size)
+	{
+		size += next->second;
+		this->remove_free_range(next->first, next->second);
+	}
+	next = this->free_ranges_.lower_bound(offset);
+	if (next != this->free_ranges_.begin())
 	{
-		this->vertex_data_[(i - batch_size) * 2] = this->vertex_data_[i * 2];
-		this->vertex_data_[(i - batch_size) * 2 + 1] = this->vertex_data_[i * 2 + 1];
+		const auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			size += prev->second;
+			this->remove_free_range(prev->first, prev->second);
+		}
 	}
-	this->allocated_ -= batch_size;
-	this->is_dirty_ = true;
+	this->add_free_range(offset, size);
+	this->update_free_index();
 
-	// reset batch info
-	for (int i = info->batch_index + 1; i < this->infos_.size(); i++)
+	// a free range at the end of the batch does not need to be drawn
+	if (offset + size == this->capacity_)
 	{
-		auto &tmp = this->infos_[i];
-		tmp->batch_index--;
-		tmp->offset -= batch_size;
+		this->allocated_ = std::min(this->allocated_, offset);
+		this->dirty_end_ = std::min(this->dirty_end_, this->allocated_);
+		this->is_dirty_ = this->is_dirty_ && this->dirty_end_ > this->dirty_begin_;
+		this->index_dirty_end_ = std::min(this->index_dirty_end_, this->allocated_ * BATCH_INDICES_PER_VERTEX);
+		this->indices_dirty_ = this->indices_dirty_ && this->index_dirty_end_ > this->index_dirty_begin_;
 	}
-	this->infos_.erase(this->infos_.begin() + info->batch_index);
-	delete info;
+
+	// reset batch info, the last one takes the place of the removed one
+	const auto batch_index = info->batch_index;
+	this->infos_[batch_index] = this->infos_.back();
+	this->infos_[batch_index]->batch_index = batch_index;
+	this->infos_.pop_back();
+	this->commands_[batch_index] = this->commands_.back();
+	this->commands_.pop_back();
+	this->commands_dirty_ = true;
+	this->bounds_dirty_ = true;
 
 	chunk->update_batch(nullptr);
 }
+
+void DestructibleMapDrawingBatch::update_bounds()
+{
+	if (!this->bounds_dirty_)
+	{
+		return;
+	}
+	this->bounds_dirty_ = false;
+
+	for (auto i = 0; i < this->infos_.size(); i++)
+	{
+		const auto info = this->infos_[i];
+		this->bounds_begin_ = i == 0 ? info->begin : glm::min(this->bounds_begin_, info->begin);
+		this->bounds_end_ = i == 0 ? info->end : glm::max(this->bounds_end_, info->end);
+	}
+}
+
+void DestructibleMapDrawingBatch::get_bounds(glm::vec2 &begin, glm::vec2 &end)
+{
+	this->update_bounds();
+	begin = this->bounds_begin_;
+	end = this->bounds_end_;
+}
+
+bool DestructibleMapDrawingBatch::is_visible(const DestructibleMapFrustum &frustum)
+{
+	if (this->infos_.empty())
+	{
+		return false;
+	}
+
+	this->update_bounds();
+	return is_box_visible(frustum, this->bounds_begin_, this->bounds_end_);
+}
@@ -1,41 +1,110 @@
 #pragma once
 
 
-#include "DestructibleMapShader.h"
 #include <vector>
+#include <map>
+#include <set>
+#include <glm/glm.hpp>
 #include "DestructibleMapConfiguration.h"
+#include "DestructibleMapCulling.h"
+#include "DestructibleMapBackend.h"
 
+class DestructibleMap;
+class DestructibleMapRenderer;
 class DestructibleMapChunk;
 class DestructibleMapDrawingBatch;
 
+// all batches of a map ordered by their biggest free range, the second value is the index of the batch in the map
+typedef std::set<std::pair<int, int>> BatchFreeIndex;
+
 struct BatchInfo
 {
 	DestructibleMapDrawingBatch *batch;
 	DestructibleMapChunk *chunk;
+	// in vertices, the indices start at offset * BATCH_INDICES_PER_VERTEX
 	int offset;
 	int size;
 	int batch_index;
+	// bounding box of the vertices of the chunk
+	glm::vec2 begin;
+	glm::vec2 end;
 };
 
+// the vertex storage of a batch is managed as a sub allocator: a freed chunk only loses its draw command and leaves a hole,
+// which are tracked as free ranges (coalesced with their neighbours) and reused using best fit.
+// Every vertex owns BATCH_INDICES_PER_VERTEX indices, so the indices of a chunk are allocated together with its vertices.
+// The indices are relative to the start of the batch. Each chunk is drawn by its own command, so the unused indices are never read.
 class DestructibleMapDrawingBatch
 {
-	GLuint vao_;
-	GLuint vbo_;
+	IBatchBuffer *buffer_;
 
-	float vertex_data_[VERTICES_PER_BATCH * 2];
+	std::vector<float> vertex_data_;
+	std::vector<uint16_t> index_data_;
+	// in vertices
+	int capacity_;
+	// number of vertices which need to be drawn (end of the last allocated range)
 	int allocated_;
+	// number of vertices actually used by chunks
+	int used_;
+	// changed vertices and changed indices
 	bool is_dirty_;
+	int dirty_begin_;
+	int dirty_end_;
+	bool indices_dirty_;
+	int index_dirty_begin_;
+	int index_dirty_end_;
 	std::vector<BatchInfo*> infos_;
+	// one per chunk, in the order of infos_
+	std::vector<BatchDrawCommand> commands_;
+	bool commands_dirty_;
+
+	// bounding box of all chunks inside of the batch, recalculated lazily after a deallocation
+	glm::vec2 bounds_begin_;
+	glm::vec2 bounds_end_;
+	bool bounds_dirty_;
+
+	// free ranges by offset (for coalescing) and by size (for best fit)
+	std::map<int, int> free_ranges_;
+	std::set<std::pair<int, int>> free_sizes_;
+
+	BatchFreeIndex *free_index_;
+	int index_;
+	int indexed_free_;
+
+	void update_free_index();
+	void add_free_range(int offset, int size);
+	void remove_free_range(int offset, int size);
+	static void mark_dirty(bool &is_dirty, int &begin, int &end, int offset, int size);
+	void update_bounds();
+	// sends the changes to the buffer
+	void upload();
 public:
-	DestructibleMapDrawingBatch();
+	// capacity may be at most MAX_MESH_VERTICES
+	explicit DestructibleMapDrawingBatch(int capacity);
 	~DestructibleMapDrawingBatch();
 
-	void draw(DestructibleMapShader *shader);
-	void init();
+	// uploads the changes and adds the batch to the frame of the backend, which draws it when it is flushed.
+	// The color of each chunk comes from its render attributes, see DestructibleMapChunk::set_highlighted
+	void draw();
+	// the same for a single chunk of the batch
+	void draw_chunk(const BatchInfo *info);
+	void init(IBatchBackend *backend);
 	bool is_free(int num_vertices) const;
+	int get_biggest_free() const;
+	// the batch keeps its entry in the index up to date on every allocation/deallocation
+	void set_free_index(BatchFreeIndex *free_index, int index);
 	void alloc_chunk(DestructibleMapChunk *chunk);
 	void dealloc_chunk(DestructibleMapChunk *chunk);
 
+	int get_used() const
+	{
+		return this->used_;
+	}
+
+	bool is_visible(const DestructibleMapFrustum &frustum);
+	void get_bounds(glm::vec2 &begin, glm::vec2 &end);
+
 	friend DestructibleMap;
+	friend DestructibleMapRenderer;
 };
 
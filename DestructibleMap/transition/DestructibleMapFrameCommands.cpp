@@ -0,0 +1,80 @@
+#include "DestructibleMapFrameCommands.h"
+#include <algorithm>
+#include <cstring>
+
+void extend_range(int &begin, int &end, int offset, int size)
+{
+	if (end > begin)
+	{
+		begin = std::min(begin, offset);
+		end = std::max(end, offset + size);
+	}
+	else
+	{
+		begin = offset;
+		end = offset + size;
+	}
+}
+
+DestructibleMapFrameCommands::DestructibleMapFrameCommands(int num_copies)
+{
+	this->num_commands_ = 0;
+	this->num_cached_commands_ = 0;
+	this->num_copies_ = num_copies;
+	this->pending_begin_.assign(num_copies, 0);
+	this->pending_end_.assign(num_copies, 0);
+}
+
+int DestructibleMapFrameCommands::add(int num_commands)
+{
+	const auto position = this->num_commands_;
+	this->num_commands_ += num_commands;
+	if (int(this->commands_.size()) < this->num_commands_)
+	{
+		this->commands_.resize(this->num_commands_);
+	}
+	return position;
+}
+
+void DestructibleMapFrameCommands::set(int position, const IndirectDrawCommand *commands, int num_commands)
+{
+	std::copy(commands, commands + num_commands, this->commands_.begin() + position);
+	for (auto i = 0; i < this->num_copies_; i++)
+	{
+		extend_range(this->pending_begin_[i], this->pending_end_[i], position, num_commands);
+	}
+}
+
+void DestructibleMapFrameCommands::set_if_changed(int position, const IndirectDrawCommand &command)
+{
+	// a command which every copy has or is still going to get
+	if (position < this->num_cached_commands_ && memcmp(&this->commands_[position], &command, sizeof(command)) == 0)
+	{
+		return;
+	}
+	this->set(position, &command, 1);
+}
+
+void DestructibleMapFrameCommands::mark_all_pending()
+{
+	for (auto i = 0; i < this->num_copies_; i++)
+	{
+		this->pending_begin_[i] = 0;
+		this->pending_end_[i] = int(this->commands_.size());
+	}
+}
+
+int DestructibleMapFrameCommands::end_frame()
+{
+	this->num_cached_commands_ = this->num_commands_;
+	this->num_commands_ = 0;
+	return this->num_cached_commands_;
+}
+
+void DestructibleMapFrameCommands::take_pending(int copy, int &begin, int &end)
+{
+	begin = this->pending_begin_[copy];
+	end = std::min(this->pending_end_[copy], this->num_cached_commands_);
+	this->pending_begin_[copy] = 0;
+	this->pending_end_[copy] = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// layout of glMultiDrawElementsIndirect
+struct IndirectDrawCommand
+{
+	uint32_t count;
+	uint32_t instance_count;
+	uint32_t first_index;
+	int32_t base_vertex;
+	uint32_t base_instance;
+};
+
+// grows [begin, end) so it covers [offset, offset + size) as well, an empty range is replaced
+void extend_range(int &begin, int &end, int offset, int size);
+
+// the draw commands of the current frame for a backend which keeps several copies of its command buffer (a ring, so it never writes into a copy
+// the GPU may still read). Only one copy is written per frame, so every copy remembers the range of commands it misses.
+class DestructibleMapFrameCommands
+{
+	std::vector<IndirectDrawCommand> commands_;
+	int num_commands_;
+	// how many commands the last frame had, only those can be compared with the commands of the current frame
+	int num_cached_commands_;
+	int num_copies_;
+	std::vector<int> pending_begin_;
+	std::vector<int> pending_end_;
+public:
+	explicit DestructibleMapFrameCommands(int num_copies = 1);
+
+	// appends num_commands commands to the frame and returns the position of the first one, they have to be set afterwards
+	int add(int num_commands);
+	// the commands are written into every copy
+	void set(int position, const IndirectDrawCommand *commands, int num_commands);
+	// the command is only written into the copies if it differs from the command at the same position in the last frame
+	void set_if_changed(int position, const IndirectDrawCommand &command);
+	// every command has to be written into every copy again, e.g. once the command buffer grew
+	void mark_all_pending();
+
+	// ends the frame and returns how many commands it had. The copies which are not written this frame may miss the commands past its end,
+	// so those are forgotten and written again once a later frame is long enough
+	int end_frame();
+	// the range of the commands of the frame which just ended the copy misses, afterwards the copy counts as written
+	void take_pending(int copy, int &begin, int &end);
+
+	const IndirectDrawCommand *get_commands() const
+	{
+		return this->commands_.data();
+	}
+
+	int get_num_copies() const
+	{
+		return this->num_copies_;
+	}
+};
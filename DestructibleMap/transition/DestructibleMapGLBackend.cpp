@@ -0,0 +1,507 @@
+#include "DestructibleMapGLBackend.h"
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+GLBatchBuffer::GLBatchBuffer(GLBatchBackend *backend, int base_vertex, int first_index, int capacity, int index_capacity)
+{
+	this->backend_ = backend;
+	this->base_vertex_ = base_vertex;
+	this->first_index_ = first_index;
+	this->capacity_ = capacity;
+	this->index_capacity_ = index_capacity;
+	this->vertex_data_ = nullptr;
+	this->index_data_ = nullptr;
+	for (auto i = 0; i < GL_BATCH_RING_SIZE; i++)
+	{
+		this->pending_begin_[i] = 0;
+		this->pending_end_[i] = 0;
+		this->pending_index_begin_[i] = 0;
+		this->pending_index_end_[i] = 0;
+	}
+	this->commands_version_ = backend->next_version_++;
+	this->frame_ = 0;
+}
+
+GLBatchBuffer::~GLBatchBuffer()
+{
+	// the backend may already be gone, in which case it detached its buffers
+	if (this->backend_ != nullptr)
+	{
+		this->backend_->remove_buffer(this);
+	}
+}
+
+void GLBatchBuffer::mark_all_pending()
+{
+	if (this->vertex_data_ == nullptr)
+	{
+		return;
+	}
+
+	for (auto i = 0; i < this->backend_->num_copies_; i++)
+	{
+		this->pending_begin_[i] = 0;
+		this->pending_end_[i] = this->capacity_;
+		this->pending_index_begin_[i] = 0;
+		this->pending_index_end_[i] = this->index_capacity_;
+	}
+}
+
+void GLBatchBuffer::write_pending(int copy)
+{
+	auto backend = this->backend_;
+
+	auto &begin = this->pending_begin_[copy];
+	auto &end = this->pending_end_[copy];
+	if (end > begin)
+	{
+		const auto offset = sizeof(float) * 2 * (copy * backend->vertex_capacity_ + this->base_vertex_ + begin);
+		backend->write(backend->vbo_, backend->mapped_vertices_, offset, this->vertex_data_ + begin * 2, sizeof(float) * 2 * (end - begin));
+		begin = 0;
+		end = 0;
+	}
+
+	auto &index_begin = this->pending_index_begin_[copy];
+	auto &index_end = this->pending_index_end_[copy];
+	if (index_end > index_begin)
+	{
+		const auto offset = sizeof(uint16_t) * (copy * backend->index_capacity_ + this->first_index_ + index_begin);
+		backend->write(backend->ebo_, backend->mapped_indices_, offset, this->index_data_ + index_begin, sizeof(uint16_t) * (index_end - index_begin));
+		index_begin = 0;
+		index_end = 0;
+	}
+}
+
+void GLBatchBuffer::upload(const float *vertex_data, int offset, int num_vertices, const uint16_t *index_data, int index_offset, int num_indices)
+{
+	// the copies are written lazily, when the batch is drawn the next time
+	this->vertex_data_ = vertex_data;
+	this->index_data_ = index_data;
+	for (auto i = 0; i < this->backend_->num_copies_; i++)
+	{
+		if (num_vertices > 0)
+		{
+			extend_range(this->pending_begin_[i], this->pending_end_[i], offset, num_vertices);
+		}
+		if (num_indices > 0)
+		{
+			extend_range(this->pending_index_begin_[i], this->pending_index_end_[i], index_offset, num_indices);
+		}
+	}
+}
+
+void GLBatchBuffer::upload_commands(const BatchDrawCommand *commands, int num_commands)
+{
+	this->commands_.resize(num_commands);
+	for (auto i = 0; i < num_commands; i++)
+	{
+		auto &command = this->commands_[i];
+		command.count = GLuint(commands[i].num_indices);
+		command.instance_count = 1;
+		command.first_index = GLuint(commands[i].first_index);
+		command.base_vertex = 0;
+		command.base_instance = GLuint(commands[i].chunk_id);
+	}
+	this->commands_version_ = this->backend_->next_version_++;
+}
+
+void GLBatchBuffer::draw()
+{
+	this->backend_->add_frame_batch(this);
+}
+
+void GLBatchBuffer::draw_command(int index)
+{
+	this->backend_->add_frame_command(this, index);
+}
+
+GLBatchBackend::GLBatchBackend()
+{
+	// glad has to be loaded before the backend is created
+	if (!GLAD_GL_VERSION_4_3)
+	{
+		std::cout << "Drawing the batches needs OpenGL 4.3" << std::endl;
+	}
+	this->persistent_ = GLAD_GL_VERSION_4_4 != 0;
+	this->num_copies_ = this->persistent_ ? GL_BATCH_RING_SIZE : 1;
+	this->frame_commands_ = DestructibleMapFrameCommands(this->num_copies_);
+	this->current_ = 0;
+	for (auto i = 0; i < GL_BATCH_RING_SIZE; i++)
+	{
+		this->fences_[i] = nullptr;
+		this->pending_attribute_begin_[i] = 0;
+		this->pending_attribute_end_[i] = 0;
+	}
+
+	this->vbo_ = 0;
+	this->ebo_ = 0;
+	this->command_buffer_ = 0;
+	this->chunk_attribute_buffer_ = 0;
+	this->mapped_vertices_ = nullptr;
+	this->mapped_indices_ = nullptr;
+	this->mapped_commands_ = nullptr;
+	this->mapped_chunk_attributes_ = nullptr;
+	this->vertex_capacity_ = 0;
+	this->index_capacity_ = 0;
+	this->command_capacity_ = 0;
+	this->chunk_attribute_capacity_ = 0;
+	this->used_vertices_ = 0;
+	this->used_indices_ = 0;
+	this->next_version_ = 0;
+	this->num_frame_batches_ = 0;
+	// buffers start in frame 0, so the first frame is 1
+	this->frame_ = 1;
+	this->chunk_attributes_ = nullptr;
+	this->num_chunk_attributes_ = 0;
+	this->uploaded_bytes = 0;
+
+	glGenVertexArrays(1, &this->vao_);
+}
+
+GLBatchBackend::~GLBatchBackend()
+{
+	for (auto &buffer : this->buffers_)
+	{
+		buffer->backend_ = nullptr;
+	}
+	for (auto i = 0; i < GL_BATCH_RING_SIZE; i++)
+	{
+		if (this->fences_[i] != nullptr)
+		{
+			glDeleteSync(this->fences_[i]);
+		}
+	}
+	this->delete_geometry_buffers();
+	this->delete_command_buffers();
+	this->delete_storage(this->chunk_attribute_buffer_, this->mapped_chunk_attributes_);
+	glDeleteVertexArrays(1, &this->vao_);
+}
+
+void *GLBatchBackend::create_storage(GLuint &buffer, size_t size)
+{
+	// bound to the copy target, so the buffers bound to the vertex array stay as they are
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (this->persistent_)
+	{
+		const auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		return glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+	}
+
+	glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	return nullptr;
+}
+
+void GLBatchBackend::delete_storage(GLuint &buffer, void *mapped)
+{
+	if (buffer == 0)
+	{
+		return;
+	}
+
+	if (mapped != nullptr)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+	// the GPU may still read it, OpenGL deletes it once it is not used anymore
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void GLBatchBackend::write(GLuint buffer, void *mapped, size_t offset, const void *data, size_t size)
+{
+	if (mapped != nullptr)
+	{
+		memcpy(static_cast<char*>(mapped) + offset, data, size);
+	}
+	else
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	}
+	this->uploaded_bytes += size;
+}
+
+void GLBatchBackend::create_geometry_buffers(int vertex_capacity, int index_capacity)
+{
+	this->vertex_capacity_ = vertex_capacity;
+	this->index_capacity_ = index_capacity;
+	this->mapped_vertices_ = static_cast<float*>(this->create_storage(this->vbo_, sizeof(float) * 2 * vertex_capacity * this->num_copies_));
+	this->mapped_indices_ = static_cast<uint16_t*>(this->create_storage(this->ebo_, sizeof(uint16_t) * index_capacity * this->num_copies_));
+
+	// the element buffer binding is part of the vertex array
+	glBindVertexArray(this->vao_);
+	glBindBuffer(GL_ARRAY_BUFFER, this->vbo_);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->ebo_);
+	glBindVertexArray(0);
+}
+
+void GLBatchBackend::delete_geometry_buffers()
+{
+	this->delete_storage(this->vbo_, this->mapped_vertices_);
+	this->delete_storage(this->ebo_, this->mapped_indices_);
+	this->mapped_vertices_ = nullptr;
+	this->mapped_indices_ = nullptr;
+}
+
+void GLBatchBackend::create_command_buffers(int command_capacity)
+{
+	this->command_capacity_ = command_capacity;
+	this->mapped_commands_ = static_cast<GLDrawElementsCommand*>(this->create_storage(this->command_buffer_, sizeof(GLDrawElementsCommand) * command_capacity * this->num_copies_));
+}
+
+void GLBatchBackend::delete_command_buffers()
+{
+	this->delete_storage(this->command_buffer_, this->mapped_commands_);
+	this->mapped_commands_ = nullptr;
+}
+
+void GLBatchBackend::create_chunk_attribute_buffer(int chunk_attribute_capacity)
+{
+	this->delete_storage(this->chunk_attribute_buffer_, this->mapped_chunk_attributes_);
+	this->chunk_attribute_capacity_ = chunk_attribute_capacity;
+	this->mapped_chunk_attributes_ = static_cast<uint32_t*>(this->create_storage(this->chunk_attribute_buffer_, sizeof(uint32_t) * chunk_attribute_capacity * this->num_copies_));
+
+	// read once per instance, the base instance of a command selects the entry of its chunk
+	glBindVertexArray(this->vao_);
+	glBindBuffer(GL_ARRAY_BUFFER, this->chunk_attribute_buffer_);
+	glEnableVertexAttribArray(1);
+	glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(uint32_t), nullptr);
+	glVertexAttribDivisor(1, 1);
+	glBindVertexArray(0);
+
+	// the whole table is written into the new buffer, and the commands of each copy point into its own copy of the table
+	for (auto i = 0; i < this->num_copies_; i++)
+	{
+		this->pending_attribute_begin_[i] = 0;
+		this->pending_attribute_end_[i] = this->num_chunk_attributes_;
+	}
+	this->frame_commands_.mark_all_pending();
+}
+
+void GLBatchBackend::wait_for_fence(int index)
+{
+	if (this->fences_[index] == nullptr)
+	{
+		return;
+	}
+
+	while (true)
+	{
+		const auto result = glClientWaitSync(this->fences_[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+		{
+			break;
+		}
+	}
+	glDeleteSync(this->fences_[index]);
+	this->fences_[index] = nullptr;
+}
+
+IBatchBuffer *GLBatchBackend::create_buffer(int capacity, int index_capacity)
+{
+	// the range of a deleted batch of the same size is reused
+	for (auto i = 0; i < int(this->free_ranges_.size()); i++)
+	{
+		const auto range = this->free_ranges_[i];
+		if (range.capacity == capacity && range.index_capacity == index_capacity)
+		{
+			this->free_ranges_.erase(this->free_ranges_.begin() + i);
+			auto buffer = new GLBatchBuffer(this, range.base_vertex, range.first_index, capacity, index_capacity);
+			this->buffers_.push_back(buffer);
+			return buffer;
+		}
+	}
+
+	auto buffer = new GLBatchBuffer(this, this->used_vertices_, this->used_indices_, capacity, index_capacity);
+	this->used_vertices_ += capacity;
+	this->used_indices_ += index_capacity;
+	if (this->used_vertices_ > this->vertex_capacity_ || this->used_indices_ > this->index_capacity_)
+	{
+		// the shared buffers are created again with twice the size, all batches are written into them from their vertex and index data
+		this->delete_geometry_buffers();
+		this->create_geometry_buffers(std::max(this->used_vertices_, this->vertex_capacity_ * 2), std::max(this->used_indices_, this->index_capacity_ * 2));
+		for (auto &other : this->buffers_)
+		{
+			other->mark_all_pending();
+		}
+
+		// the commands of each copy point into the copies of the vertices and indices, which moved
+		this->frame_commands_.mark_all_pending();
+	}
+	this->buffers_.push_back(buffer);
+	return buffer;
+}
+
+void GLBatchBackend::remove_buffer(GLBatchBuffer *buffer)
+{
+	this->buffers_.erase(std::find(this->buffers_.begin(), this->buffers_.end(), buffer));
+	if (buffer->frame_ == this->frame_)
+	{
+		this->frame_buffers_.erase(std::find(this->frame_buffers_.begin(), this->frame_buffers_.end(), buffer));
+	}
+	this->free_ranges_.push_back({ buffer->base_vertex_, buffer->first_index_, buffer->capacity_, buffer->index_capacity_ });
+}
+
+void GLBatchBackend::upload_chunk_attributes(const uint32_t *attributes, int num_chunks, int offset, int count)
+{
+	this->chunk_attributes_ = attributes;
+	this->num_chunk_attributes_ = num_chunks;
+	if (num_chunks > this->chunk_attribute_capacity_)
+	{
+		auto chunk_attribute_capacity = std::max(this->chunk_attribute_capacity_ * 2, GL_START_CHUNK_ATTRIBUTES);
+		while (chunk_attribute_capacity < num_chunks)
+		{
+			chunk_attribute_capacity *= 2;
+		}
+		this->create_chunk_attribute_buffer(chunk_attribute_capacity);
+		return;
+	}
+
+	for (auto i = 0; i < this->num_copies_; i++)
+	{
+		extend_range(this->pending_attribute_begin_[i], this->pending_attribute_end_[i], offset, count);
+	}
+}
+
+void GLBatchBackend::add_frame_buffer(GLBatchBuffer *buffer)
+{
+	if (buffer->frame_ != this->frame_)
+	{
+		buffer->frame_ = this->frame_;
+		this->frame_buffers_.push_back(buffer);
+	}
+}
+
+void GLBatchBackend::add_frame_batch(GLBatchBuffer *buffer)
+{
+	this->add_frame_buffer(buffer);
+
+	const auto index = this->num_frame_batches_++;
+	const auto num_commands = int(buffer->commands_.size());
+	const auto first_command = this->frame_commands_.add(num_commands);
+
+	// the commands are still in place if the same batch with the same commands was drawn at this position in the last frame
+	const FrameBatch frame_batch = { buffer, buffer->commands_version_, first_command };
+	if (index < int(this->frame_batches_.size()))
+	{
+		const auto &last = this->frame_batches_[index];
+		if (last.buffer == buffer && last.commands_version == buffer->commands_version_ && last.first_command == first_command)
+		{
+			return;
+		}
+		this->frame_batches_[index] = frame_batch;
+	}
+	else
+	{
+		this->frame_batches_.push_back(frame_batch);
+	}
+
+	this->copy_commands_.assign(buffer->commands_.begin(), buffer->commands_.end());
+	for (auto &command : this->copy_commands_)
+	{
+		command.first_index += GLuint(buffer->first_index_);
+		command.base_vertex += buffer->base_vertex_;
+	}
+	this->frame_commands_.set(first_command, this->copy_commands_.data(), num_commands);
+}
+
+void GLBatchBackend::add_frame_command(GLBatchBuffer *buffer, int index)
+{
+	this->add_frame_buffer(buffer);
+
+	// only written again if a different command was at this position in the last frame
+	auto command = buffer->commands_[index];
+	command.first_index += GLuint(buffer->first_index_);
+	command.base_vertex += buffer->base_vertex_;
+	this->frame_commands_.set_if_changed(this->frame_commands_.add(1), command);
+}
+
+int GLBatchBackend::flush()
+{
+	const auto num_commands = this->frame_commands_.end_frame();
+	const auto num_frame_batches = this->num_frame_batches_;
+	this->num_frame_batches_ = 0;
+	// a batch which is no longer drawn at the same position has to write its commands again, even if the frame gets longer later on
+	this->frame_batches_.resize(num_frame_batches);
+	this->frame_++;
+	if (num_commands == 0)
+	{
+		this->frame_buffers_.clear();
+		return 0;
+	}
+
+	if (this->persistent_)
+	{
+		// the last copy may still be read by the GPU, so this frame is written into the next one
+		this->current_ = (this->current_ + 1) % this->num_copies_;
+		this->wait_for_fence(this->current_);
+	}
+	const auto copy = this->current_;
+
+	if (num_commands > this->command_capacity_)
+	{
+		auto command_capacity = std::max(this->command_capacity_ * 2, GL_START_DRAW_COMMANDS);
+		while (command_capacity < num_commands)
+		{
+			command_capacity *= 2;
+		}
+		this->delete_command_buffers();
+		this->create_command_buffers(command_capacity);
+		this->frame_commands_.mark_all_pending();
+	}
+	// the map uploads its table before it draws anything, this only keeps the attribute bound
+	if (this->chunk_attribute_capacity_ == 0)
+	{
+		this->create_chunk_attribute_buffer(GL_START_CHUNK_ATTRIBUTES);
+	}
+
+	// culled batches keep their pending data until they are drawn again
+	for (auto buffer : this->frame_buffers_)
+	{
+		buffer->write_pending(copy);
+	}
+	this->frame_buffers_.clear();
+
+	auto &attribute_begin = this->pending_attribute_begin_[copy];
+	auto &attribute_end = this->pending_attribute_end_[copy];
+	if (attribute_end > attribute_begin)
+	{
+		this->write(this->chunk_attribute_buffer_, this->mapped_chunk_attributes_, sizeof(uint32_t) * (copy * this->chunk_attribute_capacity_ + attribute_begin), this->chunk_attributes_ + attribute_begin, sizeof(uint32_t) * (attribute_end - attribute_begin));
+	}
+	attribute_begin = 0;
+	attribute_end = 0;
+
+	int begin, end;
+	this->frame_commands_.take_pending(copy, begin, end);
+	if (end > begin)
+	{
+		// the commands of this copy use its vertices, indices and chunk attributes
+		const auto commands = this->frame_commands_.get_commands();
+		this->copy_commands_.assign(commands + begin, commands + end);
+		for (auto &command : this->copy_commands_)
+		{
+			command.first_index += GLuint(copy * this->index_capacity_);
+			command.base_vertex += copy * this->vertex_capacity_;
+			command.base_instance += GLuint(copy * this->chunk_attribute_capacity_);
+		}
+		this->write(this->command_buffer_, this->mapped_commands_, sizeof(GLDrawElementsCommand) * (copy * this->command_capacity_ + begin), this->copy_commands_.data(), sizeof(GLDrawElementsCommand) * (end - begin));
+	}
+
+	glBindVertexArray(this->vao_);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->command_buffer_);
+	const auto indirect = reinterpret_cast<const void*>(sizeof(GLDrawElementsCommand) * copy * this->command_capacity_);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, indirect, num_commands, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	if (this->persistent_)
+	{
+		this->fences_[copy] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	return 1;
+}
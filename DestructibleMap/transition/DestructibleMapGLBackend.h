@@ -0,0 +1,152 @@
+#pragma once
+#include <vector>
+#include <glad/glad.h>
+#include "DestructibleMapBackend.h"
+#include "DestructibleMapFrameCommands.h"
+
+// how many copies of the shared buffers are kept if they are persistently mapped, so the CPU never writes into a copy the GPU may still read
+#define GL_BATCH_RING_SIZE (3)
+
+// how many draw commands fit into the command buffer at the start, it grows when needed
+#define GL_START_DRAW_COMMANDS (1024)
+
+// how many chunk ids fit into the chunk attribute buffer at the start, it grows when needed
+#define GL_START_CHUNK_ATTRIBUTES (1024)
+
+class GLBatchBackend;
+
+typedef IndirectDrawCommand GLDrawElementsCommand;
+
+// range of the shared vertex and index buffers of the backend
+class GLBatchBuffer : public IBatchBuffer
+{
+	GLBatchBackend *backend_;
+	int base_vertex_;
+	int first_index_;
+	int capacity_;
+	int index_capacity_;
+
+	const float *vertex_data_;
+	const uint16_t *index_data_;
+	// changed vertices and indices which are not yet written into each copy
+	int pending_begin_[GL_BATCH_RING_SIZE];
+	int pending_end_[GL_BATCH_RING_SIZE];
+	int pending_index_begin_[GL_BATCH_RING_SIZE];
+	int pending_index_end_[GL_BATCH_RING_SIZE];
+
+	// relative to the batch, base_instance is the chunk id
+	std::vector<GLDrawElementsCommand> commands_;
+	// changes whenever the commands change, unique over all buffers of the backend
+	unsigned int commands_version_;
+	// the last frame of the backend which drew anything of the buffer
+	unsigned int frame_;
+
+	void mark_all_pending();
+	void write_pending(int copy);
+public:
+	explicit GLBatchBuffer(GLBatchBackend *backend, int base_vertex, int first_index, int capacity, int index_capacity);
+	~GLBatchBuffer();
+
+	void upload(const float *vertex_data, int offset, int num_vertices, const uint16_t *index_data, int index_offset, int num_indices) override;
+	void upload_commands(const BatchDrawCommand *commands, int num_commands) override;
+	void draw() override;
+	void draw_command(int index) override;
+
+	friend GLBatchBackend;
+};
+
+// all batches share one vertex buffer, one index buffer and one vertex array. Every chunk is a command of a single glMultiDrawElementsIndirect per frame.
+// The base instance of a command is the id of its chunk, so the per instance attribute 1 reads the render attributes of the chunk. Needs OpenGL 4.3.
+// The commands of a frame are only written again where the drawn batches or their commands differ from the frame before.
+class GLBatchBackend : public IBatchBackend
+{
+	// a batch drawn in a frame, with the position of its commands
+	struct FrameBatch
+	{
+		GLBatchBuffer *buffer;
+		unsigned int commands_version;
+		int first_command;
+	};
+
+	// range of a deleted buffer
+	struct FreeRange
+	{
+		int base_vertex;
+		int first_index;
+		int capacity;
+		int index_capacity;
+	};
+
+	bool persistent_;
+	int num_copies_;
+	int current_;
+	GLsync fences_[GL_BATCH_RING_SIZE];
+
+	GLuint vao_;
+	GLuint vbo_;
+	GLuint ebo_;
+	GLuint command_buffer_;
+	GLuint chunk_attribute_buffer_;
+	float *mapped_vertices_;
+	uint16_t *mapped_indices_;
+	GLDrawElementsCommand *mapped_commands_;
+	uint32_t *mapped_chunk_attributes_;
+
+	// of a single copy
+	int vertex_capacity_;
+	int index_capacity_;
+	int command_capacity_;
+	int chunk_attribute_capacity_;
+	// bump allocation of the vertex and index buffers, freed ranges are reused by buffers with the same capacities
+	int used_vertices_;
+	int used_indices_;
+	std::vector<GLBatchBuffer*> buffers_;
+	std::vector<FreeRange> free_ranges_;
+	unsigned int next_version_;
+
+	// commands of the current frame without the offset of the copy
+	DestructibleMapFrameCommands frame_commands_;
+	std::vector<FrameBatch> frame_batches_;
+	int num_frame_batches_;
+	// every buffer with commands in the current frame, each once
+	std::vector<GLBatchBuffer*> frame_buffers_;
+	unsigned int frame_;
+	std::vector<GLDrawElementsCommand> copy_commands_;
+
+	// the table of the map, written into each copy when it is drawn the next time
+	const uint32_t *chunk_attributes_;
+	int num_chunk_attributes_;
+	int pending_attribute_begin_[GL_BATCH_RING_SIZE];
+	int pending_attribute_end_[GL_BATCH_RING_SIZE];
+
+	void create_geometry_buffers(int vertex_capacity, int index_capacity);
+	void create_command_buffers(int command_capacity);
+	void delete_geometry_buffers();
+	void delete_command_buffers();
+	void create_chunk_attribute_buffer(int chunk_attribute_capacity);
+	void *create_storage(GLuint &buffer, size_t size);
+	void delete_storage(GLuint &buffer, void *mapped);
+	void write(GLuint buffer, void *mapped, size_t offset, const void *data, size_t size);
+	void wait_for_fence(int index);
+	void add_frame_buffer(GLBatchBuffer *buffer);
+	void add_frame_batch(GLBatchBuffer *buffer);
+	void add_frame_command(GLBatchBuffer *buffer, int index);
+	void remove_buffer(GLBatchBuffer *buffer);
+public:
+	// bytes actually written to GPU memory (with the ring each copy is written)
+	long long uploaded_bytes;
+
+	GLBatchBackend();
+	~GLBatchBackend();
+
+	IBatchBuffer *create_buffer(int capacity, int index_capacity) override;
+	void upload_chunk_attributes(const uint32_t *attributes, int num_chunks, int offset, int count) override;
+	int flush() override;
+
+	bool is_persistent() const
+	{
+		return this->persistent_;
+	}
+
+	friend GLBatchBuffer;
+};
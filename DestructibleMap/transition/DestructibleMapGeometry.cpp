@@ -0,0 +1,183 @@
+#include "DestructibleMapGeometry.h"
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include "DestructibleMapUtility.h"
+#include "DestructibleMapProfiler.h"
+
+DestructibleMapCompactPaths::DestructibleMapCompactPaths()
+{
+	this->origin_ = ClipperLib::IntPoint(0, 0);
+	this->words_ = 1;
+}
+
+void DestructibleMapCompactPaths::assign(const ClipperLib::Paths &paths)
+{
+	this->clear();
+
+	auto num_points = size_t(0);
+	auto begin = ClipperLib::IntPoint(0, 0);
+	auto end = ClipperLib::IntPoint(0, 0);
+	for (auto &path : paths)
+	{
+		for (auto &point : path)
+		{
+			begin.X = num_points == 0 ? point.X : std::min(begin.X, point.X);
+			begin.Y = num_points == 0 ? point.Y : std::min(begin.Y, point.Y);
+			end.X = num_points == 0 ? point.X : std::max(end.X, point.X);
+			end.Y = num_points == 0 ? point.Y : std::max(end.Y, point.Y);
+			num_points++;
+		}
+		this->path_ends_.push_back(uint32_t(num_points));
+	}
+	this->origin_ = begin;
+
+	// Clipper coordinates stay below 2^62, so every extent fits into four words
+	const auto extent = std::max(end.X - begin.X, end.Y - begin.Y);
+	this->words_ = extent > 0xffffffffll ? 4 : extent > 0xffff ? 2 : 1;
+	this->coordinates_.resize(num_points * 2 * this->words_);
+	auto i = size_t(0);
+	for (auto &path : paths)
+	{
+		for (auto &point : path)
+		{
+			const uint64_t coordinates[] = { uint64_t(point.X - begin.X), uint64_t(point.Y - begin.Y) };
+			for (auto axis = 0; axis < 2; axis++)
+			{
+				const auto index = (axis * num_points + i) * this->words_;
+				for (auto word = 0; word < this->words_; word++)
+				{
+					this->coordinates_[index + word] = uint16_t(coordinates[axis] >> (word * 16));
+				}
+			}
+			i++;
+		}
+	}
+}
+
+void DestructibleMapCompactPaths::get(ClipperLib::Paths &paths) const
+{
+	const auto num_points = this->get_num_points();
+	paths.resize(this->path_ends_.size());
+
+	auto i = size_t(0);
+	for (auto p = 0; p < paths.size(); p++)
+	{
+		auto &path = paths[p];
+		path.resize(this->path_ends_[p] - i);
+		for (auto &point : path)
+		{
+			point.X = this->origin_.X + ClipperLib::cInt(this->get_coordinate(i));
+			point.Y = this->origin_.Y + ClipperLib::cInt(this->get_coordinate(num_points + i));
+			i++;
+		}
+	}
+}
+
+void DestructibleMapCompactPaths::clear()
+{
+	this->path_ends_.clear();
+	this->coordinates_.clear();
+	this->words_ = 1;
+}
+
+void DestructibleMapCompactPaths::release()
+{
+	std::vector<uint32_t>().swap(this->path_ends_);
+	std::vector<uint16_t>().swap(this->coordinates_);
+	this->words_ = 1;
+}
+
+void DestructibleMapCompactPaths::swap(DestructibleMapCompactPaths &other)
+{
+	std::swap(this->origin_, other.origin_);
+	this->path_ends_.swap(other.path_ends_);
+	this->coordinates_.swap(other.coordinates_);
+	std::swap(this->words_, other.words_);
+}
+
+size_t DestructibleMapCompactPaths::get_resident_bytes() const
+{
+	return this->path_ends_.capacity() * sizeof(uint32_t) + this->coordinates_.capacity() * sizeof(uint16_t);
+}
+
+void index_triangles(const std::vector<glm::vec2> &triangles, DestructibleMapMesh &mesh)
+{
+	mesh.clear();
+
+	// open addressing table of the vertices found so far, at most half full. The vertices keep the order in which they are found
+	thread_local std::vector<int> table;
+	thread_local std::vector<uint32_t> corner_vertices;
+	auto table_size = size_t(16);
+	while (table_size < triangles.size() * 2)
+	{
+		table_size *= 2;
+	}
+	table.assign(table_size, -1);
+	corner_vertices.resize(triangles.size());
+
+	for (auto i = 0; i < triangles.size(); i++)
+	{
+		const auto &vertex = triangles[i];
+		uint32_t bits[2];
+		memcpy(bits, &vertex, sizeof(bits));
+		auto slot = size_t((bits[0] * 0x9e3779b1u) ^ (bits[1] * 0x85ebca77u)) & (table_size - 1);
+		while (table[slot] >= 0 && mesh.vertices[table[slot]] != vertex)
+		{
+			slot = (slot + 1) & (table_size - 1);
+		}
+		if (table[slot] < 0)
+		{
+			table[slot] = int(mesh.vertices.size());
+			mesh.vertices.push_back(vertex);
+		}
+		corner_vertices[i] = uint32_t(table[slot]);
+	}
+
+	mesh.indices.reserve(triangles.size());
+	auto num_dropped = 0;
+	for (auto i = 0; i + 2 < triangles.size(); i += 3)
+	{
+		if (corner_vertices[i] >= MAX_MESH_VERTICES || corner_vertices[i + 1] >= MAX_MESH_VERTICES || corner_vertices[i + 2] >= MAX_MESH_VERTICES)
+		{
+			num_dropped++;
+			continue;
+		}
+		mesh.indices.push_back(uint16_t(corner_vertices[i]));
+		mesh.indices.push_back(uint16_t(corner_vertices[i + 1]));
+		mesh.indices.push_back(uint16_t(corner_vertices[i + 2]));
+	}
+
+	// found after the first MAX_MESH_VERTICES, so only the dropped triangles use them
+	if (mesh.vertices.size() > MAX_MESH_VERTICES)
+	{
+		mesh.vertices.resize(MAX_MESH_VERTICES);
+		map_profiler.count(COUNTER_TRIANGLES_DROPPED, num_dropped);
+		std::cout << "Meshes are limited to " << MAX_MESH_VERTICES << " vertices, " << num_dropped << " triangles were dropped" << std::endl;
+	}
+}
+
+void expand_triangles(const glm::vec2 *vertices, const uint16_t *indices, int num_indices, std::vector<glm::vec2> &triangles)
+{
+	triangles.resize(num_indices);
+	for (auto i = 0; i < num_indices; i++)
+	{
+		triangles[i] = vertices[indices[i]];
+	}
+}
+
+void triangulate_mesh(const ClipperLib::PolyTree &poly_tree, bool fast, int triangulation_buffer, DestructibleMapMesh &mesh)
+{
+	// the triangle list of the calling thread, keeps its memory between triangulations
+	thread_local std::vector<glm::vec2> triangles;
+	triangles.clear();
+	if (fast)
+	{
+		triangulate_fast(poly_tree, triangles, triangulation_buffer);
+	}
+	else
+	{
+		triangulate(poly_tree, triangles);
+	}
+	index_triangles(triangles, mesh);
+}
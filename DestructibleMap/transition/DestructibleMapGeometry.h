@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "clipper.hpp"
+
+// a mesh may not have more vertices than a 16 bit index can address
+#define MAX_MESH_VERTICES (65536)
+
+// contours of a chunk, stored relative to their smallest coordinates with all x before all y.
+// The coordinates take 16 bit if the contours span at most 65535 units (65 at SCALE_FACTOR 1000), 32 bit (two words, low first) otherwise.
+// Contours which span even more than 32 bit are stored uncompressed (four words).
+class DestructibleMapCompactPaths
+{
+	ClipperLib::IntPoint origin_;
+	// index of the first point after each path
+	std::vector<uint32_t> path_ends_;
+	std::vector<uint16_t> coordinates_;
+	// 1, 2 or 4 words per coordinate
+	int words_;
+
+	uint64_t get_coordinate(size_t index) const
+	{
+		switch (this->words_)
+		{
+		case 1:
+			return this->coordinates_[index];
+		case 2:
+			return this->coordinates_[index * 2] | uint32_t(this->coordinates_[index * 2 + 1]) << 16;
+		default:
+			return this->coordinates_[index * 4] | uint64_t(this->coordinates_[index * 4 + 1]) << 16 | uint64_t(this->coordinates_[index * 4 + 2]) << 32 | uint64_t(this->coordinates_[index * 4 + 3]) << 48;
+		}
+	}
+public:
+	DestructibleMapCompactPaths();
+
+	void assign(const ClipperLib::Paths &paths);
+	// decodes into paths, reusing their memory
+	void get(ClipperLib::Paths &paths) const;
+	// keeps the memory
+	void clear();
+	void release();
+	void swap(DestructibleMapCompactPaths &other);
+
+	bool empty() const
+	{
+		return this->path_ends_.empty();
+	}
+
+	size_t get_num_paths() const
+	{
+		return this->path_ends_.size();
+	}
+
+	size_t get_num_points() const
+	{
+		return this->path_ends_.empty() ? 0 : this->path_ends_.back();
+	}
+
+	bool is_wide() const
+	{
+		return this->words_ > 1;
+	}
+
+	size_t get_coordinate_bytes() const
+	{
+		return this->words_ * sizeof(uint16_t);
+	}
+
+	// heap memory, including unused capacity
+	size_t get_resident_bytes() const;
+};
+
+// triangles of a chunk, every vertex is stored once and referenced by three indices per triangle
+struct DestructibleMapMesh
+{
+	std::vector<glm::vec2> vertices;
+	std::vector<uint16_t> indices;
+
+	void clear()
+	{
+		this->vertices.clear();
+		this->indices.clear();
+	}
+
+	void release()
+	{
+		std::vector<glm::vec2>().swap(this->vertices);
+		std::vector<uint16_t>().swap(this->indices);
+	}
+
+	void swap(DestructibleMapMesh &other)
+	{
+		this->vertices.swap(other.vertices);
+		this->indices.swap(other.indices);
+	}
+
+	size_t get_resident_bytes() const
+	{
+		return this->vertices.capacity() * sizeof(glm::vec2) + this->indices.capacity() * sizeof(uint16_t);
+	}
+};
+
+// merges the corners of a triangle list which are at exactly the same position. The vertices of a mesh which would need more than
+// MAX_MESH_VERTICES are dropped together with their triangles (counted as COUNTER_TRIANGLES_DROPPED). Such a chunk does not fit into a batch,
+// so it is subdivided by update_batches and its children get the dropped triangles back.
+void index_triangles(const std::vector<glm::vec2> &triangles, DestructibleMapMesh &mesh);
+// writes the corners of all triangles of the mesh, three per triangle
+void expand_triangles(const glm::vec2 *vertices, const uint16_t *indices, int num_indices, std::vector<glm::vec2> &triangles);
+// triangulate_fast or triangulate, followed by index_triangles
+void triangulate_mesh(const ClipperLib::PolyTree &poly_tree, bool fast, int triangulation_buffer, DestructibleMapMesh &mesh);
@@ -0,0 +1,331 @@
+#include "DestructibleMapJournal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace
+{
+	const char journal_magic[8] = { 'D', 'M', 'J', 'O', 'U', 'R', 'N', 'L' };
+
+	enum JournalRecordType
+	{
+		JOURNAL_OPERATION = 1,
+		JOURNAL_CHECKPOINT = 2
+	};
+
+	// every record starts with its type and the size of the rest of the record
+	struct JournalRecordHeader
+	{
+		uint32_t type;
+		uint32_t size;
+	};
+
+	struct JournalFileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		float scale_factor;
+	};
+
+	void append(std::vector<char> &buffer, const void *data, size_t size)
+	{
+		buffer.insert(buffer.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	}
+
+	std::string get_directory(const std::string &file_name)
+	{
+		const auto separator = file_name.find_last_of("/\\");
+		return separator == std::string::npos ? std::string() : file_name.substr(0, separator + 1);
+	}
+}
+
+DestructibleMapJournal::DestructibleMapJournal()
+{
+	this->file_ = nullptr;
+	this->checkpoint_interval_ = 0;
+	this->num_operations_ = 0;
+	this->last_checkpoint_ = 0;
+	this->stopping_ = false;
+	this->flush_requested_ = false;
+	this->writing_ = false;
+}
+
+DestructibleMapJournal::~DestructibleMapJournal()
+{
+	this->close();
+}
+
+bool DestructibleMapJournal::open(const char *file_name, int checkpoint_interval)
+{
+	this->close();
+
+	this->file_ = fopen(file_name, "wb");
+	if (this->file_ == nullptr)
+	{
+		std::cout << "Could not open journal " << file_name << std::endl;
+		return false;
+	}
+
+	JournalFileHeader header = {};
+	memcpy(header.magic, journal_magic, sizeof(header.magic));
+	header.version = JOURNAL_VERSION;
+	header.scale_factor = SCALE_FACTOR;
+	fwrite(&header, sizeof(header), 1, this->file_);
+
+	this->file_name_ = file_name;
+	this->checkpoint_interval_ = checkpoint_interval;
+	this->num_operations_ = 0;
+	this->last_checkpoint_ = 0;
+	this->stopping_ = false;
+	this->thread_ = std::thread(&DestructibleMapJournal::thread_main, this);
+	return true;
+}
+
+void DestructibleMapJournal::close()
+{
+	if (this->file_ == nullptr)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		this->stopping_ = true;
+	}
+	this->wake_up_.notify_all();
+	this->thread_.join();
+
+	fclose(this->file_);
+	this->file_ = nullptr;
+}
+
+void DestructibleMapJournal::record(const std::vector<DestructibleMapOperation> &operations)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		for (auto &operation : operations)
+		{
+			const uint32_t clip_type = operation.clip_type;
+			const uint32_t num_points = operation.polygon.size();
+			const JournalRecordHeader record = { JOURNAL_OPERATION, uint32_t(sizeof(clip_type) + sizeof(num_points) + num_points * 2 * sizeof(int64_t)) };
+			append(this->buffer_, &record, sizeof(record));
+			append(this->buffer_, &clip_type, sizeof(clip_type));
+			append(this->buffer_, &num_points, sizeof(num_points));
+			for (auto &point : operation.polygon)
+			{
+				const int64_t coordinates[] = { point.X, point.Y };
+				append(this->buffer_, coordinates, sizeof(coordinates));
+			}
+		}
+	}
+	this->num_operations_ += operations.size();
+}
+
+bool DestructibleMapJournal::needs_checkpoint() const
+{
+	return this->checkpoint_interval_ > 0 && this->num_operations_ - this->last_checkpoint_ >= this->checkpoint_interval_;
+}
+
+void DestructibleMapJournal::add_checkpoint(std::vector<char> &snapshot)
+{
+	this->last_checkpoint_ = this->num_operations_;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+		this->checkpoints_.emplace_back(this->num_operations_, std::vector<char>());
+		this->checkpoints_.back().second.swap(snapshot);
+	}
+	this->wake_up_.notify_one();
+}
+
+void DestructibleMapJournal::flush()
+{
+	if (this->file_ == nullptr)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(this->mutex_);
+	this->flush_requested_ = true;
+	this->wake_up_.notify_one();
+	this->idle_.wait(lock, [this]() { return this->buffer_.empty() && this->checkpoints_.empty() && !this->writing_; });
+}
+
+void DestructibleMapJournal::thread_main()
+{
+	std::vector<std::pair<long long, std::vector<char>>> checkpoints;
+
+	std::unique_lock<std::mutex> lock(this->mutex_);
+	while (true)
+	{
+		// small records are collected for a while, so the disk is not hit every frame
+		this->wake_up_.wait_for(lock, std::chrono::milliseconds(JOURNAL_FLUSH_MILLISECONDS), [this]()
+		{
+			return this->stopping_ || this->flush_requested_ || !this->checkpoints_.empty();
+		});
+		this->flush_requested_ = false;
+
+		if (!this->buffer_.empty() || !this->checkpoints_.empty())
+		{
+			this->write_buffer_.swap(this->buffer_);
+			checkpoints.swap(this->checkpoints_);
+			this->writing_ = true;
+			lock.unlock();
+
+			fwrite(this->write_buffer_.data(), 1, this->write_buffer_.size(), this->file_);
+			this->write_buffer_.clear();
+			for (auto &checkpoint : checkpoints)
+			{
+				this->write_checkpoint(checkpoint.first, checkpoint.second);
+			}
+			checkpoints.clear();
+			fflush(this->file_);
+
+			lock.lock();
+			this->writing_ = false;
+		}
+
+		if (this->buffer_.empty() && this->checkpoints_.empty())
+		{
+			this->idle_.notify_all();
+			if (this->stopping_)
+			{
+				return;
+			}
+		}
+	}
+}
+
+void DestructibleMapJournal::write_checkpoint(long long operation_index, const std::vector<char> &snapshot)
+{
+	// the journal only refers to the snapshot once it is complete, a crash in between leaves the previous checkpoint
+	const auto name_begin = this->file_name_.find_last_of("/\\");
+	const auto name = (name_begin == std::string::npos ? this->file_name_ : this->file_name_.substr(name_begin + 1)) + "." + std::to_string(operation_index) + ".dmsnap";
+	const auto path = get_directory(this->file_name_) + name;
+	const auto temporary_path = path + ".tmp";
+
+	std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+	stream.write(snapshot.data(), snapshot.size());
+	stream.close();
+	std::remove(path.c_str());
+	if (!stream || std::rename(temporary_path.c_str(), path.c_str()) != 0)
+	{
+		std::cout << "Could not write checkpoint " << path << std::endl;
+		return;
+	}
+
+	const int64_t index = operation_index;
+	const JournalRecordHeader record = { JOURNAL_CHECKPOINT, uint32_t(sizeof(index) + name.size()) };
+	fwrite(&record, sizeof(record), 1, this->file_);
+	fwrite(&index, sizeof(index), 1, this->file_);
+	fwrite(name.data(), 1, name.size(), this->file_);
+}
+
+bool DestructibleMapJournalReader::open(const char *file_name)
+{
+	this->operations_.clear();
+	this->checkpoints_.clear();
+
+	std::ifstream stream(file_name, std::ios::binary);
+	if (!stream)
+	{
+		std::cout << "Could not open journal " << file_name << std::endl;
+		return false;
+	}
+	const std::vector<char> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+	JournalFileHeader header;
+	if (data.size() < sizeof(header) || (memcpy(&header, data.data(), sizeof(header)), memcmp(header.magic, journal_magic, sizeof(header.magic)) != 0) ||
+		header.version != JOURNAL_VERSION || header.scale_factor != SCALE_FACTOR)
+	{
+		std::cout << "Invalid journal " << file_name << std::endl;
+		return false;
+	}
+
+	const auto directory = get_directory(file_name);
+	size_t offset = sizeof(header);
+	JournalRecordHeader record;
+	while (offset + sizeof(record) <= data.size())
+	{
+		memcpy(&record, data.data() + offset, sizeof(record));
+		offset += sizeof(record);
+		if (record.size > data.size() - offset)
+		{
+			break;
+		}
+
+		const auto payload = data.data() + offset;
+		offset += record.size;
+		if (record.type == JOURNAL_OPERATION && record.size >= 2 * sizeof(uint32_t))
+		{
+			uint32_t clip_type;
+			uint32_t num_points;
+			memcpy(&clip_type, payload, sizeof(clip_type));
+			memcpy(&num_points, payload + sizeof(clip_type), sizeof(num_points));
+			if (record.size != sizeof(clip_type) + sizeof(num_points) + uint64_t(num_points) * 2 * sizeof(int64_t))
+			{
+				break;
+			}
+
+			DestructibleMapOperation operation;
+			operation.clip_type = ClipperLib::ClipType(clip_type);
+			operation.polygon.resize(num_points);
+			auto coordinates = payload + sizeof(clip_type) + sizeof(num_points);
+			for (auto &point : operation.polygon)
+			{
+				int64_t x, y;
+				memcpy(&x, coordinates, sizeof(x));
+				memcpy(&y, coordinates + sizeof(x), sizeof(y));
+				point = ClipperLib::IntPoint(x, y);
+				coordinates += sizeof(x) + sizeof(y);
+			}
+			this->operations_.push_back(operation);
+		}
+		else if (record.type == JOURNAL_CHECKPOINT && record.size > sizeof(int64_t))
+		{
+			int64_t index;
+			memcpy(&index, payload, sizeof(index));
+			this->checkpoints_.push_back({ index, directory + std::string(payload + sizeof(index), record.size - sizeof(index)) });
+		}
+	}
+	return true;
+}
+
+bool DestructibleMapJournalReader::replay(DestructibleMap &map, long long num_operations, int batch_size) const
+{
+	if (num_operations < 0 || num_operations > this->operations_.size())
+	{
+		num_operations = this->operations_.size();
+	}
+
+	const DestructibleMapJournalCheckpoint *checkpoint = nullptr;
+	for (auto &candidate : this->checkpoints_)
+	{
+		if (candidate.operation_index <= num_operations && (checkpoint == nullptr || candidate.operation_index > checkpoint->operation_index))
+		{
+			checkpoint = &candidate;
+		}
+	}
+	if (checkpoint == nullptr)
+	{
+		std::cout << "No checkpoint before operation " << num_operations << std::endl;
+		return false;
+	}
+	if (!map.load_snapshot(checkpoint->file_name.c_str()))
+	{
+		return false;
+	}
+
+	// the quad tree is maintained after every batch, like after every frame while recording
+	batch_size = std::max(batch_size, 1);
+	std::vector<DestructibleMapOperation> batch;
+	for (auto i = checkpoint->operation_index; i < num_operations; i += batch_size)
+	{
+		batch.assign(this->operations_.begin() + i, this->operations_.begin() + std::min(i + batch_size, num_operations));
+		map.apply_polygon_operations(batch);
+		map.update_batches();
+	}
+	return true;
+}
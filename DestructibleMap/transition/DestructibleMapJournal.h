@@ -0,0 +1,95 @@
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DestructibleMap.h"
+
+// has to be increased with every change of the record layout, journals of another version are rejected
+#define JOURNAL_VERSION (1)
+
+// a checkpoint refers to a snapshot file in the directory of the journal, the map after operation_index operations
+struct DestructibleMapJournalCheckpoint
+{
+	long long operation_index;
+	std::string file_name;
+};
+
+// append only log of the operations applied to a map. The render thread only encodes the records into a buffer,
+// a background thread writes the buffer and the checkpoint snapshots to disk, so recording never waits for the disk.
+// Every checkpoint_interval operations the map hands over a snapshot (see DestructibleMap::set_journal).
+class DestructibleMapJournal
+{
+	std::string file_name_;
+	FILE *file_;
+	int checkpoint_interval_;
+	long long num_operations_;
+	long long last_checkpoint_;
+
+	// records which were not written yet, swapped with the buffer of the thread
+	std::vector<char> buffer_;
+	std::vector<char> write_buffer_;
+	// snapshots which were not written yet
+	std::vector<std::pair<long long, std::vector<char>>> checkpoints_;
+
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable wake_up_;
+	std::condition_variable idle_;
+	bool stopping_;
+	bool flush_requested_;
+	// the thread is writing outside of the lock
+	bool writing_;
+
+	void thread_main();
+	void write_checkpoint(long long operation_index, const std::vector<char> &snapshot);
+public:
+	DestructibleMapJournal();
+	// writes everything which is still buffered
+	~DestructibleMapJournal();
+
+	DestructibleMapJournal(const DestructibleMapJournal&) = delete;
+	DestructibleMapJournal& operator=(const DestructibleMapJournal&) = delete;
+
+	// truncates the file, checkpoint_interval <= 0 only writes the initial checkpoint
+	bool open(const char *file_name, int checkpoint_interval = JOURNAL_CHECKPOINT_INTERVAL);
+	void close();
+
+	void record(const std::vector<DestructibleMapOperation> &operations);
+	bool needs_checkpoint() const;
+	// takes over the snapshot of the map after all recorded operations
+	void add_checkpoint(std::vector<char> &snapshot);
+	// blocks until everything recorded so far is on disk
+	void flush();
+
+	long long get_num_operations() const
+	{
+		return this->num_operations_;
+	}
+};
+
+// reads a journal and rebuilds the map of any point in it, starting from the nearest checkpoint before that point
+class DestructibleMapJournalReader
+{
+	std::vector<DestructibleMapOperation> operations_;
+	std::vector<DestructibleMapJournalCheckpoint> checkpoints_;
+public:
+	// a record cut off by a crash ends the journal, everything before it is still used
+	bool open(const char *file_name);
+
+	// loads the nearest checkpoint into a map which was not loaded yet and applies the operations after it up to num_operations (all if negative).
+	// With batch_size > 1 the operations are applied in batches (apply_polygon_operations clips each leaf once per batch and runs the leaves in parallel).
+	bool replay(DestructibleMap &map, long long num_operations = -1, int batch_size = 1) const;
+
+	const std::vector<DestructibleMapOperation> &get_operations() const
+	{
+		return this->operations_;
+	}
+
+	const std::vector<DestructibleMapJournalCheckpoint> &get_checkpoints() const
+	{
+		return this->checkpoints_;
+	}
+};
@@ -0,0 +1,295 @@
+#include "DestructibleMapPager.h"
+#include <cstdio>
+#include <iostream>
+#include "DestructibleMapClipperContext.h"
+#include "DestructibleMapConfiguration.h"
+#include "DestructibleMapTaskScheduler.h"
+#include "DestructibleMapUtility.h"
+
+namespace
+{
+	// unsigned LEB128, small deltas take a single byte
+	void write_varint(std::vector<char> &data, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			data.push_back(char((value & 0x7f) | 0x80));
+			value >>= 7;
+		}
+		data.push_back(char(value));
+	}
+
+	bool read_varint(const std::vector<char> &data, size_t &offset, uint64_t &value)
+	{
+		value = 0;
+		for (auto shift = 0; shift < 64 && offset < data.size(); shift += 7)
+		{
+			const auto byte = uint8_t(data[offset++]);
+			value |= uint64_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// zig zag, so small negative deltas are small too
+	void write_delta(std::vector<char> &data, int64_t delta)
+	{
+		write_varint(data, (uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+	}
+
+	bool read_delta(const std::vector<char> &data, size_t &offset, int64_t &delta)
+	{
+		uint64_t value;
+		if (!read_varint(data, offset, value))
+		{
+			return false;
+		}
+		delta = int64_t(value >> 1) ^ -int64_t(value & 1);
+		return true;
+	}
+}
+
+DestructibleMapPager::DestructibleMapPager()
+{
+	this->file_size_ = 0;
+	this->used_bytes_ = 0;
+	this->fast_triangulation_ = true;
+	this->triangulation_buffer_ = TRIANGULATION_BUFFER;
+	this->stopping_ = false;
+}
+
+DestructibleMapPager::~DestructibleMapPager()
+{
+	if (this->thread_.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->mutex_);
+			this->stopping_ = true;
+		}
+		this->wake_up_.notify_one();
+		this->thread_.join();
+	}
+
+	DestructibleMapPageResult *result;
+	while (this->results_.pop(result))
+	{
+		delete result;
+	}
+
+	if (this->file_.is_open())
+	{
+		this->file_.close();
+		std::remove(this->file_name_.c_str());
+	}
+}
+
+bool DestructibleMapPager::open(const char *file_name, bool fast_triangulation, int triangulation_buffer)
+{
+	this->file_.open(file_name, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!this->file_.is_open())
+	{
+		std::cout << "Could not open page file " << file_name << std::endl;
+		return false;
+	}
+
+	this->file_name_ = file_name;
+	this->fast_triangulation_ = fast_triangulation;
+	this->triangulation_buffer_ = triangulation_buffer;
+	this->thread_ = std::thread(&DestructibleMapPager::thread_main, this);
+	return true;
+}
+
+DestructibleMapPage DestructibleMapPager::write(const ClipperLib::Paths &paths, const glm::ivec2 &origin)
+{
+	DestructibleMapPage page = { 0, 0 };
+	if (paths.empty())
+	{
+		return page;
+	}
+
+	// every point is stored as the difference to the previous one, the first one relative to the quad
+	std::vector<char> data;
+	write_varint(data, paths.size());
+	ClipperLib::IntPoint previous(origin.x, origin.y);
+	for (auto &path : paths)
+	{
+		write_varint(data, path.size());
+		for (auto &point : path)
+		{
+			write_delta(data, point.X - previous.X);
+			write_delta(data, point.Y - previous.Y);
+			previous = point;
+		}
+	}
+
+	page.size = uint32_t(data.size());
+	const auto capacity = uint32_t((data.size() + PAGE_GRANULARITY - 1) / PAGE_GRANULARITY * PAGE_GRANULARITY);
+
+	std::lock_guard<std::mutex> lock(this->file_mutex_);
+	const auto free_page = this->free_pages_.lower_bound(capacity);
+	if (free_page != this->free_pages_.end() && free_page->first == capacity)
+	{
+		page.offset = free_page->second;
+		this->free_pages_.erase(free_page);
+	}
+	else
+	{
+		page.offset = this->file_size_;
+		this->file_size_ += capacity;
+	}
+	this->used_bytes_ += capacity;
+
+	this->file_.seekp(std::streamoff(page.offset));
+	this->file_.write(data.data(), data.size());
+	if (!this->file_)
+	{
+		std::cout << "Could not write page file " << this->file_name_ << std::endl;
+		this->file_.clear();
+	}
+	return page;
+}
+
+bool DestructibleMapPager::read(const DestructibleMapPage &page, const glm::ivec2 &origin, ClipperLib::Paths &paths)
+{
+	paths.clear();
+	if (page.size == 0)
+	{
+		return true;
+	}
+
+	std::vector<char> data(page.size);
+	{
+		std::lock_guard<std::mutex> lock(this->file_mutex_);
+		this->file_.seekg(std::streamoff(page.offset));
+		this->file_.read(data.data(), data.size());
+		if (!this->file_)
+		{
+			std::cout << "Could not read page file " << this->file_name_ << std::endl;
+			this->file_.clear();
+			return false;
+		}
+	}
+
+	// every count is checked against the remaining bytes, a point takes at least two of them
+	size_t offset = 0;
+	uint64_t num_paths;
+	if (!read_varint(data, offset, num_paths) || num_paths > data.size())
+	{
+		return false;
+	}
+	paths.resize(num_paths);
+	ClipperLib::IntPoint previous(origin.x, origin.y);
+	for (auto &path : paths)
+	{
+		uint64_t num_points;
+		if (!read_varint(data, offset, num_points) || num_points > (data.size() - offset) / 2)
+		{
+			paths.clear();
+			return false;
+		}
+		path.resize(num_points);
+		for (auto &point : path)
+		{
+			int64_t x, y;
+			if (!read_delta(data, offset, x) || !read_delta(data, offset, y))
+			{
+				paths.clear();
+				return false;
+			}
+			point = ClipperLib::IntPoint(previous.X + x, previous.Y + y);
+			previous = point;
+		}
+	}
+	return true;
+}
+
+void DestructibleMapPager::release(const DestructibleMapPage &page)
+{
+	if (page.size == 0)
+	{
+		return;
+	}
+
+	const auto capacity = uint32_t((page.size + PAGE_GRANULARITY - 1) / PAGE_GRANULARITY * PAGE_GRANULARITY);
+	std::lock_guard<std::mutex> lock(this->file_mutex_);
+	this->free_pages_.insert(std::make_pair(capacity, page.offset));
+	this->used_bytes_ -= capacity;
+}
+
+void DestructibleMapPager::triangulate(const ClipperLib::Paths &paths, DestructibleMapMesh &mesh) const
+{
+	mesh.clear();
+	if (paths.empty())
+	{
+		return;
+	}
+
+	ClipperScope scope;
+	paths_to_polytree(paths, scope->poly_tree);
+	triangulate_mesh(scope->poly_tree, this->fast_triangulation_, this->triangulation_buffer_, mesh);
+}
+
+void DestructibleMapPager::request(const DestructibleMapPageRequest &request)
+{
+	this->requests_.push(request);
+
+	// the thread checks for requests while holding the mutex, so it either sees the request or gets the notification
+	{
+		std::lock_guard<std::mutex> lock(this->mutex_);
+	}
+	this->wake_up_.notify_one();
+}
+
+DestructibleMapPageResult *DestructibleMapPager::pop_result()
+{
+	DestructibleMapPageResult *result;
+	if (this->results_.pop(result))
+	{
+		return result;
+	}
+	return nullptr;
+}
+
+void DestructibleMapPager::thread_main()
+{
+	std::vector<DestructibleMapPageRequest> requests;
+	while (true)
+	{
+		// everything requested so far is loaded in parallel, the results are published as soon as each leaf is done
+		DestructibleMapPageRequest request;
+		while (this->requests_.pop(request))
+		{
+			requests.push_back(request);
+		}
+
+		if (!requests.empty())
+		{
+			map_scheduler.parallel_for(int(requests.size()), [this, &requests](int i)
+			{
+				auto result = new DestructibleMapPageResult();
+				result->request = requests[i];
+
+				ClipperScope scope;
+				result->loaded = this->read(result->request.page, result->request.origin, scope->paths);
+				if (result->loaded)
+				{
+					result->paths.assign(scope->paths);
+					this->triangulate(scope->paths, result->mesh);
+				}
+				this->results_.push(result);
+			});
+			requests.clear();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(this->mutex_);
+		this->wake_up_.wait(lock, [this]() { return this->stopping_ || !this->requests_.empty(); });
+		if (this->stopping_)
+		{
+			return;
+		}
+	}
+}
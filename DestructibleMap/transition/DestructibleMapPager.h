@@ -0,0 +1,105 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "clipper.hpp"
+#include "DestructibleMapGeometry.h"
+#include "DestructibleMapQueue.h"
+
+// pages are allocated in multiples of this, so a freed page fits the next leaf of a similar size
+#define PAGE_GRANULARITY (64)
+
+class DestructibleMapChunk;
+
+// where the paths of a paged out leaf are in the page file
+struct DestructibleMapPage
+{
+	uint64_t offset;
+	// 0 for a leaf without paths, nothing is written for it
+	uint32_t size;
+};
+
+// a paged out leaf which should be loaded again by the background thread
+struct DestructibleMapPageRequest
+{
+	DestructibleMapChunk *chunk;
+	// the result is dropped if the leaf was paged in on demand (or paged out again) in the meantime
+	unsigned int version;
+	DestructibleMapPage page;
+	// the paths are stored relative to the begin of the quad of the leaf (in Clipper coordinates)
+	glm::ivec2 origin;
+};
+
+struct DestructibleMapPageResult
+{
+	DestructibleMapPageRequest request;
+	// false if the page could not be read, the leaf stays paged out
+	bool loaded;
+	DestructibleMapCompactPaths paths;
+	DestructibleMapMesh mesh;
+};
+
+// page file for the leaves far away from the active region of a map. Only the paths are stored, delta encoded relative to the quad of the leaf,
+// the triangles are computed again when a leaf is paged in. Paging out happens on the render thread, paging in on a background thread
+// which reads, decodes and triangulates the requested leaves on the task scheduler and hands them back through a lock free queue.
+class DestructibleMapPager
+{
+	std::string file_name_;
+	std::fstream file_;
+	// free parts of the file by size
+	std::multimap<uint32_t, uint64_t> free_pages_;
+	uint64_t file_size_;
+	uint64_t used_bytes_;
+	// reads happen on the workers of the task scheduler, writes on the render thread
+	std::mutex file_mutex_;
+
+	bool fast_triangulation_;
+	int triangulation_buffer_;
+
+	DestructibleMapQueue<DestructibleMapPageRequest> requests_;
+	DestructibleMapQueue<DestructibleMapPageResult*> results_;
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable wake_up_;
+	bool stopping_;
+
+	void thread_main();
+public:
+	DestructibleMapPager();
+	// deletes the page file
+	~DestructibleMapPager();
+
+	DestructibleMapPager(const DestructibleMapPager&) = delete;
+	DestructibleMapPager& operator=(const DestructibleMapPager&) = delete;
+
+	// truncates the file, the leaves are triangulated the same way set_paths does it
+	bool open(const char *file_name, bool fast_triangulation, int triangulation_buffer);
+
+	DestructibleMapPage write(const ClipperLib::Paths &paths, const glm::ivec2 &origin);
+	// can be called from any thread, false if the page could not be read or decoded
+	bool read(const DestructibleMapPage &page, const glm::ivec2 &origin, ClipperLib::Paths &paths);
+	// the page is reused by later writes, so it must not be requested anymore
+	void release(const DestructibleMapPage &page);
+	void triangulate(const ClipperLib::Paths &paths, DestructibleMapMesh &mesh) const;
+
+	void request(const DestructibleMapPageRequest &request);
+	// returns nullptr if no result is ready, only called by the render thread
+	DestructibleMapPageResult *pop_result();
+
+	uint64_t get_file_size() const
+	{
+		return this->file_size_;
+	}
+
+	// bytes of the pages which are in use
+	uint64_t get_used_bytes() const
+	{
+		return this->used_bytes_;
+	}
+};
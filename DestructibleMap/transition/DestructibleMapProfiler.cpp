@@ -0,0 +1,132 @@
+#include "DestructibleMapProfiler.h"
+#include <chrono>
+
+DestructibleMapProfiler map_profiler;
+
+long long get_nanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *get_stage_name(DestructibleMapStage stage)
+{
+	switch (stage)
+	{
+	case STAGE_RANGE_QUERY:
+		return "range query";
+	case STAGE_CLIP:
+		return "clip";
+	case STAGE_TRIANGULATE:
+		return "triangulate";
+	case STAGE_BATCH_UPDATE:
+		return "batch update";
+	case STAGE_MERGE_SUBDIVIDE:
+		return "merge/subdivide";
+	default:
+		return "unknown";
+	}
+}
+
+const char *get_counter_name(DestructibleMapCounter counter)
+{
+	switch (counter)
+	{
+	case COUNTER_FULL_TRIANGULATION:
+		return "full triangulations";
+	case COUNTER_INCREMENTAL_TRIANGULATION:
+		return "incremental triangulations";
+	case COUNTER_INCREMENTAL_FALLBACK:
+		return "incremental fallbacks";
+	case COUNTER_TRIANGLES_DROPPED:
+		return "triangles dropped over the vertex limit";
+	case COUNTER_CHUNK_GROUP_ACQUIRED:
+		return "chunk groups acquired";
+	case COUNTER_CHUNK_SLAB_ALLOCATED:
+		return "chunk slabs allocated";
+	case COUNTER_LEAF_SKIPPED:
+		return "leaves skipped";
+	case COUNTER_LEAF_EMPTIED:
+		return "leaves emptied";
+	case COUNTER_LEAF_FILLED:
+		return "leaves filled";
+	case COUNTER_LEAF_CLIPPED:
+		return "leaves clipped";
+	case COUNTER_ASYNC_APPLIED:
+		return "async results applied";
+	case COUNTER_ASYNC_STALE:
+		return "async results stale";
+	case COUNTER_CHUNK_MERGED:
+		return "chunks merged";
+	case COUNTER_CHUNK_SUBDIVIDED:
+		return "chunks subdivided";
+	case COUNTER_MAINTENANCE_DEFERRED:
+		return "maintenance deferred";
+	case COUNTER_LEAF_PAGED_OUT:
+		return "leaves paged out";
+	case COUNTER_LEAF_PAGED_IN:
+		return "leaves paged in";
+	case COUNTER_LEAF_PAGED_IN_ON_DEMAND:
+		return "leaves paged in on demand";
+	case COUNTER_LOD_BUILT:
+		return "levels of detail built";
+	case COUNTER_LOD_DRAWN:
+		return "chunks drawn simplified";
+	default:
+		return "unknown";
+	}
+}
+
+DestructibleMapProfiler::DestructibleMapProfiler()
+{
+	this->reset();
+}
+
+void DestructibleMapProfiler::add(DestructibleMapStage stage, long long nanoseconds)
+{
+	this->stage_nanoseconds_[stage] += nanoseconds;
+	this->stage_calls_[stage]++;
+}
+
+void DestructibleMapProfiler::count(DestructibleMapCounter counter, long long amount)
+{
+	this->counters_[counter] += amount;
+}
+
+void DestructibleMapProfiler::reset()
+{
+	for (auto i = 0; i < NUM_STAGES; i++)
+	{
+		this->stage_nanoseconds_[i] = 0;
+		this->stage_calls_[i] = 0;
+	}
+	for (auto i = 0; i < NUM_COUNTERS; i++)
+	{
+		this->counters_[i] = 0;
+	}
+}
+
+double DestructibleMapProfiler::get_milliseconds(DestructibleMapStage stage) const
+{
+	return this->stage_nanoseconds_[stage] / 1000000.0;
+}
+
+long long DestructibleMapProfiler::get_calls(DestructibleMapStage stage) const
+{
+	return this->stage_calls_[stage];
+}
+
+long long DestructibleMapProfiler::get_count(DestructibleMapCounter counter) const
+{
+	return this->counters_[counter];
+}
+
+ProfileScope::ProfileScope(DestructibleMapStage stage)
+{
+	this->stage_ = stage;
+	this->begin_ = get_nanoseconds();
+}
+
+ProfileScope::~ProfileScope()
+{
+	map_profiler.add(this->stage_, get_nanoseconds() - this->begin_);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+
+enum DestructibleMapStage
+{
+	STAGE_RANGE_QUERY,
+	STAGE_CLIP,
+	STAGE_TRIANGULATE,
+	STAGE_BATCH_UPDATE,
+	STAGE_MERGE_SUBDIVIDE,
+	NUM_STAGES
+};
+
+enum DestructibleMapCounter
+{
+	COUNTER_FULL_TRIANGULATION,
+	COUNTER_INCREMENTAL_TRIANGULATION,
+	COUNTER_INCREMENTAL_FALLBACK,
+	COUNTER_TRIANGLES_DROPPED,
+	COUNTER_CHUNK_GROUP_ACQUIRED,
+	COUNTER_CHUNK_SLAB_ALLOCATED,
+	COUNTER_LEAF_SKIPPED,
+	COUNTER_LEAF_EMPTIED,
+	COUNTER_LEAF_FILLED,
+	COUNTER_LEAF_CLIPPED,
+	COUNTER_ASYNC_APPLIED,
+	COUNTER_ASYNC_STALE,
+	COUNTER_CHUNK_MERGED,
+	COUNTER_CHUNK_SUBDIVIDED,
+	COUNTER_MAINTENANCE_DEFERRED,
+	COUNTER_LEAF_PAGED_OUT,
+	COUNTER_LEAF_PAGED_IN,
+	COUNTER_LEAF_PAGED_IN_ON_DEMAND,
+	COUNTER_LOD_BUILT,
+	COUNTER_LOD_DRAWN,
+	NUM_COUNTERS
+};
+
+long long get_nanoseconds();
+const char *get_stage_name(DestructibleMapStage stage);
+const char *get_counter_name(DestructibleMapCounter counter);
+
+// accumulates the time spent in each stage of the modification pipeline.
+// Stages may run on several threads at once, so the accumulated time is CPU time and not wall time.
+// Merge/subdivide contains the clipping and triangulation of the new chunks, which are also counted in their own stage.
+class DestructibleMapProfiler
+{
+	std::atomic<long long> stage_nanoseconds_[NUM_STAGES];
+	std::atomic<long long> stage_calls_[NUM_STAGES];
+	std::atomic<long long> counters_[NUM_COUNTERS];
+public:
+	DestructibleMapProfiler();
+
+	void add(DestructibleMapStage stage, long long nanoseconds);
+	void count(DestructibleMapCounter counter, long long amount = 1);
+	void reset();
+
+	double get_milliseconds(DestructibleMapStage stage) const;
+	long long get_calls(DestructibleMapStage stage) const;
+	long long get_count(DestructibleMapCounter counter) const;
+};
+
+extern DestructibleMapProfiler map_profiler;
+
+// measures the lifetime of the scope and adds it to map_profiler
+class ProfileScope
+{
+	DestructibleMapStage stage_;
+	long long begin_;
+public:
+	explicit ProfileScope(DestructibleMapStage stage);
+	~ProfileScope();
+};
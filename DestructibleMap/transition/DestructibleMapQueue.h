@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+
+// unbounded lock free queue, any thread may push but only one thread may pop (Vyukov's MPSC queue).
+// Elements come out in the order their push finished.
+template <typename T>
+class DestructibleMapQueue
+{
+	struct Node
+	{
+		std::atomic<Node*> next;
+		T value;
+	};
+
+	// the most recently pushed node
+	std::atomic<Node*> head_;
+	// the node which was popped last, only touched by the consumer
+	Node *tail_;
+public:
+	DestructibleMapQueue()
+	{
+		this->tail_ = new Node();
+		this->tail_->next.store(nullptr, std::memory_order_relaxed);
+		this->head_.store(this->tail_, std::memory_order_relaxed);
+	}
+
+	~DestructibleMapQueue()
+	{
+		T value;
+		while (this->pop(value))
+		{
+		}
+		delete this->tail_;
+	}
+
+	DestructibleMapQueue(const DestructibleMapQueue&) = delete;
+	DestructibleMapQueue& operator=(const DestructibleMapQueue&) = delete;
+
+	void push(const T &value)
+	{
+		auto node = new Node();
+		node->next.store(nullptr, std::memory_order_relaxed);
+		node->value = value;
+
+		const auto previous = this->head_.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	// consumer only
+	bool pop(T &value)
+	{
+		const auto next = this->tail_->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+		{
+			return false;
+		}
+
+		value = next->value;
+		delete this->tail_;
+		this->tail_ = next;
+		return true;
+	}
+
+	// consumer only
+	bool empty() const
+	{
+		return this->tail_->next.load(std::memory_order_acquire) == nullptr;
+	}
+};
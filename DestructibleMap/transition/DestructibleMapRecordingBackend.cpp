@@ -0,0 +1,89 @@
+#include "DestructibleMapRecordingBackend.h"
+
+RecordingBatchBuffer::RecordingBatchBuffer(RecordingBatchBackend *backend)
+{
+	this->backend_ = backend;
+	this->num_commands_ = 0;
+	this->num_indices_ = 0;
+}
+
+void RecordingBatchBuffer::upload(const float * /*vertex_data*/, int /*offset*/, int num_vertices, const uint16_t * /*index_data*/, int /*index_offset*/, int num_indices)
+{
+	this->backend_->num_uploads++;
+	this->backend_->uploaded_vertices += num_vertices;
+	this->backend_->uploaded_indices += num_indices;
+	this->backend_->uploaded_bytes += sizeof(float) * num_vertices * 2 + sizeof(uint16_t) * num_indices;
+}
+
+void RecordingBatchBuffer::upload_commands(const BatchDrawCommand *commands, int num_commands)
+{
+	this->num_commands_ = num_commands;
+	this->num_indices_ = 0;
+	this->command_indices_.resize(num_commands);
+	for (auto i = 0; i < num_commands; i++)
+	{
+		this->num_indices_ += commands[i].num_indices;
+		this->command_indices_[i] = commands[i].num_indices;
+	}
+	this->backend_->uploaded_commands += num_commands;
+}
+
+void RecordingBatchBuffer::draw()
+{
+	this->backend_->frame_commands_ += this->num_commands_;
+	this->backend_->frame_indices_ += this->num_indices_;
+}
+
+void RecordingBatchBuffer::draw_command(int index)
+{
+	this->backend_->frame_commands_++;
+	this->backend_->frame_indices_ += this->command_indices_[index];
+}
+
+RecordingBatchBackend::RecordingBatchBackend()
+{
+	this->num_buffers = 0;
+	this->frame_commands_ = 0;
+	this->frame_indices_ = 0;
+	this->reset_counters();
+}
+
+IBatchBuffer *RecordingBatchBackend::create_buffer(int /*capacity*/, int /*index_capacity*/)
+{
+	this->num_buffers++;
+	return new RecordingBatchBuffer(this);
+}
+
+void RecordingBatchBackend::upload_chunk_attributes(const uint32_t * /*attributes*/, int /*num_chunks*/, int /*offset*/, int count)
+{
+	this->uploaded_chunk_attributes += count;
+	this->uploaded_bytes += sizeof(uint32_t) * count;
+}
+
+int RecordingBatchBackend::flush()
+{
+	if (this->frame_commands_ == 0)
+	{
+		return 0;
+	}
+
+	this->num_draws++;
+	this->drawn_commands += this->frame_commands_;
+	this->drawn_indices += this->frame_indices_;
+	this->frame_commands_ = 0;
+	this->frame_indices_ = 0;
+	return 1;
+}
+
+void RecordingBatchBackend::reset_counters()
+{
+	this->num_uploads = 0;
+	this->uploaded_vertices = 0;
+	this->uploaded_indices = 0;
+	this->uploaded_commands = 0;
+	this->uploaded_chunk_attributes = 0;
+	this->uploaded_bytes = 0;
+	this->num_draws = 0;
+	this->drawn_commands = 0;
+	this->drawn_indices = 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include "DestructibleMapBackend.h"
+
+class RecordingBatchBackend;
+
+class RecordingBatchBuffer : public IBatchBuffer
+{
+	RecordingBatchBackend *backend_;
+	int num_commands_;
+	long long num_indices_;
+	std::vector<int> command_indices_;
+public:
+	explicit RecordingBatchBuffer(RecordingBatchBackend *backend);
+
+	void upload(const float *vertex_data, int offset, int num_vertices, const uint16_t *index_data, int index_offset, int num_indices) override;
+	void upload_commands(const BatchDrawCommand *commands, int num_commands) override;
+	void draw() override;
+	void draw_command(int index) override;
+};
+
+// backend without any GPU, it only counts what would have been sent to the GPU. Used for headless simulation and profiling.
+// Like the GL backend it draws all batches of a frame with a single multi draw call.
+class RecordingBatchBackend : public IBatchBackend
+{
+	int frame_commands_;
+	long long frame_indices_;
+public:
+	int num_buffers;
+	int num_uploads;
+	long long uploaded_vertices;
+	long long uploaded_indices;
+	long long uploaded_commands;
+	long long uploaded_chunk_attributes;
+	long long uploaded_bytes;
+	int num_draws;
+	long long drawn_commands;
+	long long drawn_indices;
+
+	RecordingBatchBackend();
+
+	IBatchBuffer *create_buffer(int capacity, int index_capacity) override;
+	void upload_chunk_attributes(const uint32_t *attributes, int num_chunks, int offset, int count) override;
+	int flush() override;
+
+	void reset_counters();
+
+	friend RecordingBatchBuffer;
+};
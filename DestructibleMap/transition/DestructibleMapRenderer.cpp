@@ -0,0 +1,138 @@
+#include "DestructibleMapRenderer.h"
+#include <iostream>
+#include <GLFW/glfw3.h>
+#include "DestructibleMap.h"
+#include "DestructibleMapShader.h"
+#include "DestructibleMapDrawingBatch.h"
+#include "DestructibleMapCulling.h"
+#include "DestructibleMapUtility.h"
+#include "MeshResource.h"
+#include "RenderingEngine.h"
+
+DestructibleMapRenderer::DestructibleMapRenderer(DestructibleMap *map)
+{
+	this->map_ = map;
+	this->rendering_engine_ = nullptr;
+	this->point_distribution_resource_ = nullptr;
+	this->quadtree_resource_ = nullptr;
+	this->startup_displayed_ = false;
+
+	this->map_shader_ = new DestructibleMapShader();
+	map_shader_->init();
+}
+
+DestructibleMapRenderer::~DestructibleMapRenderer()
+{
+	delete this->map_shader_;
+
+	if (point_distribution_resource_)
+	{
+		delete point_distribution_resource_;
+	}
+
+	if (quadtree_resource_)
+	{
+		delete quadtree_resource_;
+	}
+}
+
+void DestructibleMapRenderer::init(RenderingEngine *rendering_engine)
+{
+	this->rendering_engine_ = rendering_engine;
+
+	this->map_->init(&this->backend_);
+
+	this->update_quadtree_representation();
+
+	this->point_distribution_resource_ = new MeshResource(this->map_->get_points());
+	this->point_distribution_resource_->init();
+
+	glPointSize(8);
+}
+
+void DestructibleMapRenderer::draw()
+{
+	map_draw_calls = 0;
+	map_uploaded_bytes = 0;
+	map_culled_batches = 0;
+
+	// the leaves around the visible part of the map are kept in memory (or paged in) when a page file is used
+	glm::vec2 visible_begin, visible_end;
+	if (get_visible_rect(this->rendering_engine_->get_projection_matrix() * this->rendering_engine_->get_view_matrix(), visible_begin, visible_end))
+	{
+		this->map_->set_active_region(visible_begin, visible_end);
+	}
+
+	this->map_->update_batches();
+
+	this->map_shader_->use();
+	this->map_shader_->set_camera_uniforms(this->rendering_engine_->get_view_matrix(), this->rendering_engine_->get_projection_matrix());
+	this->map_shader_->set_base_color(glm::vec3(1.0, 0.0, 0.0));
+
+	glBindVertexArray(this->quadtree_resource_->get_resource_id());
+	glDrawArrays(GL_LINES, 0, this->lines_.size());
+
+	if (glfwGetKey(this->rendering_engine_->get_window(), GLFW_KEY_3)) {
+		glBindVertexArray(this->point_distribution_resource_->get_resource_id());
+		glDrawArrays(GL_POINTS, 0, this->map_->get_points().size());
+	}
+
+	if (glfwGetKey(this->rendering_engine_->get_window(), GLFW_KEY_1))
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	} else
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	}
+
+	// highlighted chunks are found by the shader in the chunk attributes of the backend, so the loop only looks at the batches
+	const auto view_projection = this->rendering_engine_->get_projection_matrix() * this->rendering_engine_->get_view_matrix();
+	if (this->map_->get_config().lod_pixels > 0.0f)
+	{
+		// chunks far away are drawn with their level of detail, picked by their size on the screen
+		this->map_->draw_lod_chunks(view_projection, glm::vec2(this->rendering_engine_->get_viewport()));
+	}
+	else
+	{
+		const auto frustum = extract_frustum(view_projection);
+		for (auto &batch : this->map_->get_batches())
+		{
+			if (!batch->is_visible(frustum))
+			{
+				map_culled_batches++;
+				continue;
+			}
+
+			batch->draw();
+		}
+	}
+
+	this->map_shader_->set_base_color(glm::vec3(0.0, 1.0, 0.0));
+	this->map_shader_->set_highlight_color(glm::vec3(1.0, 1.0, 0.0));
+	this->map_shader_->set_chunk_attributes_enabled(true);
+	map_draw_calls += this->backend_.flush();
+	this->map_shader_->set_chunk_attributes_enabled(false);
+
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+	glBindVertexArray(0);
+
+	if (!startup_displayed_)
+	{
+		std::cout << "Time from loading until first frame " << (get_time() - this->map_->get_start_time()) << std::endl;
+		this->startup_displayed_ = true;
+	}
+}
+
+void DestructibleMapRenderer::update_quadtree_representation()
+{
+	this->lines_.clear();
+	this->map_->get_quadtree_lines(this->lines_);
+
+	if (this->quadtree_resource_)
+	{
+		delete this->quadtree_resource_;
+	}
+	this->quadtree_resource_ = new MeshResource(this->lines_);
+	this->quadtree_resource_->init();
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "DestructibleMapGLBackend.h"
+
+class DestructibleMap;
+class DestructibleMapShader;
+class MeshResource;
+class RenderingEngine;
+
+// draws a DestructibleMap using OpenGL, the map itself only knows the GPU through the GLBatchBackend
+class DestructibleMapRenderer
+{
+	DestructibleMap *map_;
+	DestructibleMapShader *map_shader_;
+	GLBatchBackend backend_;
+
+	std::vector<glm::vec2> lines_;
+	MeshResource *point_distribution_resource_;
+	MeshResource *quadtree_resource_;
+	RenderingEngine *rendering_engine_;
+
+	bool startup_displayed_;
+public:
+	explicit DestructibleMapRenderer(DestructibleMap *map);
+	~DestructibleMapRenderer();
+
+	void init(RenderingEngine *rendering_engine);
+
+	void draw();
+
+	void update_quadtree_representation();
+};
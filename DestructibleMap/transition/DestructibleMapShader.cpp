@@ -8,6 +8,8 @@ DestructibleMapShader::DestructibleMapShader() : ShaderResource("assets/shaders/
 	this->view_uniform_ = -1;
 	this->projection_uniform_ = -1;
 	this->base_color_uniform_ = -1;
+	this->highlight_color_uniform_ = -1;
+	this->use_chunk_attributes_uniform_ = -1;
 }
 
 
@@ -24,6 +26,16 @@ void DestructibleMapShader::set_base_color(const glm::vec3& color) const
 	glUniform3fv(this->base_color_uniform_, 1, &color[0]);
 }
 
+void DestructibleMapShader::set_highlight_color(const glm::vec3& color) const
+{
+	glUniform3fv(this->highlight_color_uniform_, 1, &color[0]);
+}
+
+void DestructibleMapShader::set_chunk_attributes_enabled(bool enabled) const
+{
+	glUniform1i(this->use_chunk_attributes_uniform_, enabled ? 1 : 0);
+}
+
 DestructibleMapShader::~DestructibleMapShader()
 {
 }
@@ -36,4 +48,6 @@ void DestructibleMapShader::init()
 	this->view_uniform_ = get_uniform("vp.view");
 	this->projection_uniform_ = get_uniform("vp.projection");
 	this->base_color_uniform_ = get_uniform("base_color");
+	this->highlight_color_uniform_ = get_uniform("highlight_color");
+	this->use_chunk_attributes_uniform_ = get_uniform("use_chunk_attributes");
 }
@@ -10,6 +10,8 @@ class DestructibleMapShader :
 	GLint view_uniform_;
 	GLint projection_uniform_;
 	GLint base_color_uniform_;
+	GLint highlight_color_uniform_;
+	GLint use_chunk_attributes_uniform_;
 public:
 	DestructibleMapShader();
 	~DestructibleMapShader();
@@ -19,5 +21,8 @@ public:
 	
 	void set_camera_uniforms(const glm::mat4 &view_matrix, const glm::mat4 &projection_matrix) override;
 	void set_base_color(const glm::vec3 &color) const;
+	void set_highlight_color(const glm::vec3 &color) const;
+	// if enabled highlighted chunks (by the chunk attributes of the GLBatchBackend) use the highlight color instead of the base color
+	void set_chunk_attributes_enabled(bool enabled) const;
 };
 
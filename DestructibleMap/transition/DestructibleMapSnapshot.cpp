@@ -0,0 +1,140 @@
+#include "DestructibleMapSnapshot.h"
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+DestructibleMapMappedFile::DestructibleMapMappedFile()
+{
+	this->data_ = nullptr;
+	this->size_ = 0;
+#ifdef _WIN32
+	this->file_ = INVALID_HANDLE_VALUE;
+	this->mapping_ = nullptr;
+#else
+	this->file_ = -1;
+#endif
+}
+
+DestructibleMapMappedFile::~DestructibleMapMappedFile()
+{
+	this->close();
+}
+
+#ifdef _WIN32
+
+bool DestructibleMapMappedFile::open(const char *file_name)
+{
+	this->close();
+
+	this->file_ = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (this->file_ == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(this->file_, &size) || size.QuadPart == 0)
+	{
+		this->close();
+		return false;
+	}
+	this->size_ = size_t(size.QuadPart);
+
+	this->mapping_ = CreateFileMappingA(this->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (this->mapping_ == nullptr)
+	{
+		std::cout << "Could not map " << file_name << std::endl;
+		this->close();
+		return false;
+	}
+
+	this->data_ = static_cast<const char*>(MapViewOfFile(this->mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (this->data_ == nullptr)
+	{
+		std::cout << "Could not map " << file_name << std::endl;
+		this->close();
+		return false;
+	}
+	return true;
+}
+
+void DestructibleMapMappedFile::close()
+{
+	if (this->data_ != nullptr)
+	{
+		UnmapViewOfFile(this->data_);
+	}
+	if (this->mapping_ != nullptr)
+	{
+		CloseHandle(this->mapping_);
+	}
+	if (this->file_ != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(this->file_);
+	}
+
+	this->data_ = nullptr;
+	this->size_ = 0;
+	this->file_ = INVALID_HANDLE_VALUE;
+	this->mapping_ = nullptr;
+}
+
+#else
+
+bool DestructibleMapMappedFile::open(const char *file_name)
+{
+	this->close();
+
+	this->file_ = ::open(file_name, O_RDONLY);
+	if (this->file_ < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(this->file_, &status) != 0 || status.st_size == 0)
+	{
+		this->close();
+		return false;
+	}
+	this->size_ = size_t(status.st_size);
+
+	// the whole snapshot is used right away, so the pages are read ahead instead of faulting in one by one
+	auto data = mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, this->file_, 0);
+	if (data == MAP_FAILED)
+	{
+		std::cout << "Could not map " << file_name << std::endl;
+		this->size_ = 0;
+		this->close();
+		return false;
+	}
+	madvise(data, this->size_, MADV_WILLNEED);
+	this->data_ = static_cast<const char*>(data);
+	return true;
+}
+
+void DestructibleMapMappedFile::close()
+{
+	if (this->data_ != nullptr)
+	{
+		munmap(const_cast<char*>(this->data_), this->size_);
+	}
+	if (this->file_ >= 0)
+	{
+		::close(this->file_);
+	}
+
+	this->data_ = nullptr;
+	this->size_ = 0;
+	this->file_ = -1;
+}
+
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// has to be increased with every change of the layout below, snapshots of another version are rejected
+#define SNAPSHOT_VERSION (3)
+
+// the file starts with this header, the sections follow at the given offsets (8 byte aligned). All values are little endian, in the layout of the writing machine.
+struct DestructibleMapSnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	// the vertices are used in place, so the layout of glm::vec2 and the scale of the paths have to match
+	uint32_t vertex_size;
+	float scale_factor;
+	uint32_t seed;
+	// the DestructibleMapConfig the quad tree and the meshes were built with, a map with another configuration rejects the snapshot
+	// (e.g. a leaf may not fit into its batches, or the map would be subdivided differently)
+	uint32_t vertices_per_batch;
+	uint32_t vertices_per_chunk;
+	uint32_t triangulation_buffer;
+	uint32_t merging_subdividing;
+	float triangle_area_ratio;
+	float points_per_leaf_ratio;
+
+	uint64_t num_nodes;
+	uint64_t num_paths;
+	uint64_t num_path_points;
+	uint64_t num_vertices;
+	uint64_t num_indices;
+	uint64_t num_points;
+
+	// DestructibleMapSnapshotNode[num_nodes], the quad tree in pre order (north west, north east, south west, south east)
+	uint64_t nodes_offset;
+	// uint32_t[num_paths], number of points of each path of the leaves, in the order of the nodes
+	uint64_t path_sizes_offset;
+	// int64_t[num_path_points * 2], x and y of the points of all paths
+	uint64_t path_points_offset;
+	// glm::vec2[num_vertices], distinct vertices of the triangles of all leaves
+	uint64_t vertices_offset;
+	// uint16_t[num_indices], three per triangle, into the vertices of the own leaf
+	uint64_t indices_offset;
+	// glm::vec2[num_points], point cloud the quad tree was built from
+	uint64_t points_offset;
+};
+
+struct DestructibleMapSnapshotNode
+{
+	float begin[2];
+	float end[2];
+	// inner nodes have neither paths nor vertices, their four children follow
+	uint32_t has_children;
+	uint32_t num_paths;
+	uint64_t num_vertices;
+	uint64_t num_indices;
+};
+
+// read only view of a whole file, the memory stays valid until the object is destroyed
+class DestructibleMapMappedFile
+{
+	const char *data_;
+	size_t size_;
+#ifdef _WIN32
+	void *file_;
+	void *mapping_;
+#else
+	int file_;
+#endif
+
+	void close();
+public:
+	DestructibleMapMappedFile();
+	~DestructibleMapMappedFile();
+
+	DestructibleMapMappedFile(const DestructibleMapMappedFile&) = delete;
+	DestructibleMapMappedFile& operator=(const DestructibleMapMappedFile&) = delete;
+
+	bool open(const char *file_name);
+
+	const char *get_data() const
+	{
+		return this->data_;
+	}
+
+	size_t get_size() const
+	{
+		return this->size_;
+	}
+};
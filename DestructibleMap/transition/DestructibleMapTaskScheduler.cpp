@@ -0,0 +1,240 @@
+#include "DestructibleMapTaskScheduler.h"
+#include <algorithm>
+#include <iterator>
+
+DestructibleMapTaskScheduler map_scheduler;
+
+namespace
+{
+	// the queue of the calling thread, threads which are not workers of the scheduler use queue 0
+	thread_local const DestructibleMapTaskScheduler *current_scheduler = nullptr;
+	thread_local int current_queue = 0;
+
+	int get_queue_index(const DestructibleMapTaskScheduler *scheduler)
+	{
+		return current_scheduler == scheduler ? current_queue : 0;
+	}
+}
+
+DestructibleMapTaskGroup::DestructibleMapTaskGroup()
+{
+	this->pending_ = 0;
+}
+
+void DestructibleMapTaskGroup::run(const std::function<void()> &function)
+{
+	// an exception must not leave a worker thread (terminate) or skip the pending counter (the group would be waited on forever)
+	try
+	{
+		function();
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(this->exception_mutex_);
+		if (!this->exception_)
+		{
+			this->exception_ = std::current_exception();
+		}
+	}
+}
+
+DestructibleMapTaskScheduler::DestructibleMapTaskScheduler(int num_threads)
+{
+	this->num_threads_ = 0;
+	this->num_queued_ = 0;
+	this->num_sleeping_ = 0;
+	this->stopping_ = false;
+	this->start(num_threads);
+}
+
+DestructibleMapTaskScheduler::~DestructibleMapTaskScheduler()
+{
+	this->stop();
+}
+
+void DestructibleMapTaskScheduler::start(int num_threads)
+{
+	if (num_threads <= 0)
+	{
+		num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+	}
+	this->num_threads_ = num_threads;
+	this->stopping_ = false;
+
+	for (auto i = 0; i < num_threads; i++)
+	{
+		this->queues_.emplace_back(new TaskQueue());
+	}
+	for (auto i = 1; i < num_threads; i++)
+	{
+		this->workers_.emplace_back(&DestructibleMapTaskScheduler::worker_main, this, i);
+	}
+}
+
+void DestructibleMapTaskScheduler::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->sleep_mutex_);
+		this->stopping_ = true;
+	}
+	this->wake_up_.notify_all();
+
+	for (auto &worker : this->workers_)
+	{
+		worker.join();
+	}
+	this->workers_.clear();
+	this->queues_.clear();
+}
+
+void DestructibleMapTaskScheduler::set_num_threads(int num_threads)
+{
+	this->stop();
+	this->start(num_threads);
+}
+
+void DestructibleMapTaskScheduler::worker_main(int index)
+{
+	current_scheduler = this;
+	current_queue = index;
+
+	while (true)
+	{
+		if (this->run_task(index))
+		{
+			continue;
+		}
+
+		// the counters are checked in opposite order by spawn, so either the worker sees the new task or spawn sees the sleeping worker
+		std::unique_lock<std::mutex> lock(this->sleep_mutex_);
+		this->num_sleeping_++;
+		this->wake_up_.wait(lock, [this]() { return this->stopping_ || this->num_queued_ > 0; });
+		this->num_sleeping_--;
+		if (this->stopping_)
+		{
+			return;
+		}
+	}
+}
+
+bool DestructibleMapTaskScheduler::run_task(int index, const DestructibleMapTaskGroup *group)
+{
+	Task task;
+	auto found = false;
+	const auto matches = [group](const Task &queued) { return group == nullptr || queued.group == group; };
+
+	// own queue from the back (newest, probably still in cache), the others from the front (oldest, probably the biggest piece of work)
+	{
+		auto &queue = *this->queues_[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		const auto newest = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), matches);
+		if (newest != queue.tasks.rend())
+		{
+			task = std::move(*newest);
+			queue.tasks.erase(std::next(newest).base());
+			found = true;
+		}
+	}
+	for (auto i = 1; i < this->num_threads_ && !found; i++)
+	{
+		auto &queue = *this->queues_[(index + i) % this->num_threads_];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		const auto oldest = std::find_if(queue.tasks.begin(), queue.tasks.end(), matches);
+		if (oldest != queue.tasks.end())
+		{
+			task = std::move(*oldest);
+			queue.tasks.erase(oldest);
+			found = true;
+		}
+	}
+
+	if (!found)
+	{
+		return false;
+	}
+
+	this->num_queued_--;
+	task.group->run(task.function);
+	task.group->pending_--;
+	return true;
+}
+
+void DestructibleMapTaskScheduler::spawn(DestructibleMapTaskGroup &group, std::function<void()> function)
+{
+	if (this->num_threads_ == 1)
+	{
+		group.run(function);
+		return;
+	}
+
+	group.pending_++;
+	{
+		auto &queue = *this->queues_[get_queue_index(this)];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back({ std::move(function), &group });
+	}
+	this->num_queued_++;
+
+	if (this->num_sleeping_ > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->sleep_mutex_);
+		}
+		this->wake_up_.notify_one();
+	}
+}
+
+void DestructibleMapTaskScheduler::wait(DestructibleMapTaskGroup &group)
+{
+	// queue 0 is shared by the threads which are not workers, any task in it may belong to another of them
+	const auto index = get_queue_index(this);
+	const auto only_group = current_scheduler == this ? nullptr : &group;
+	while (group.pending_ > 0)
+	{
+		// the remaining tasks of the group are running on other threads
+		if (!this->run_task(index, only_group))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	std::exception_ptr exception;
+	{
+		std::lock_guard<std::mutex> lock(group.exception_mutex_);
+		std::swap(exception, group.exception_);
+	}
+	if (exception)
+	{
+		std::rethrow_exception(exception);
+	}
+}
+
+void DestructibleMapTaskScheduler::parallel_for(int count, const std::function<void(int)> &function, int grain_size)
+{
+	if (this->num_threads_ == 1 || count <= grain_size)
+	{
+		for (auto i = 0; i < count; i++)
+		{
+			function(i);
+		}
+		return;
+	}
+
+	// a few blocks per thread, so threads which finish early can steal the rest
+	const auto num_blocks = std::min((count + grain_size - 1) / grain_size, this->num_threads_ * 4);
+	const auto block_size = (count + num_blocks - 1) / num_blocks;
+
+	DestructibleMapTaskGroup group;
+	for (auto begin = 0; begin < count; begin += block_size)
+	{
+		const auto end = std::min(begin + block_size, count);
+		this->spawn(group, [&function, begin, end]()
+		{
+			for (auto i = begin; i < end; i++)
+			{
+				function(i);
+			}
+		});
+	}
+	this->wait(group);
+}
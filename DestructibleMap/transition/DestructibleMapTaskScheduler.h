@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// counts the tasks spawned into it which did not finish yet
+class DestructibleMapTaskGroup
+{
+	std::atomic<int> pending_;
+	// the first exception thrown by one of the tasks, rethrown by wait
+	std::mutex exception_mutex_;
+	std::exception_ptr exception_;
+
+	void run(const std::function<void()> &function);
+public:
+	DestructibleMapTaskGroup();
+
+	DestructibleMapTaskGroup(const DestructibleMapTaskGroup&) = delete;
+	DestructibleMapTaskGroup& operator=(const DestructibleMapTaskGroup&) = delete;
+
+	friend class DestructibleMapTaskScheduler;
+};
+
+// persistent worker threads, each with its own task deque. A thread runs its newest task first and steals the oldest task of another thread when it runs dry.
+// Waiting for a group runs other tasks instead of blocking, so tasks can spawn and wait for tasks of their own (e.g. apply_polygon recursing into the children).
+// The calling thread is one of the threads, with one thread everything runs inline on it. Threads which are not workers (the render thread, the background
+// threads of the async modifier and the pager) only run tasks of the group they wait for, so a frame never ends up doing the work of a background job.
+class DestructibleMapTaskScheduler
+{
+	struct Task
+	{
+		std::function<void()> function;
+		DestructibleMapTaskGroup *group;
+	};
+
+	struct TaskQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	// queue 0 is shared by all threads which are not workers
+	std::vector<std::unique_ptr<TaskQueue>> queues_;
+	std::vector<std::thread> workers_;
+	int num_threads_;
+
+	std::atomic<int> num_queued_;
+	std::atomic<int> num_sleeping_;
+	std::atomic<bool> stopping_;
+	std::mutex sleep_mutex_;
+	std::condition_variable wake_up_;
+
+	void start(int num_threads);
+	void stop();
+	void worker_main(int index);
+	// with a group only a task of that group is run
+	bool run_task(int index, const DestructibleMapTaskGroup *group = nullptr);
+public:
+	// 0 uses every hardware thread
+	explicit DestructibleMapTaskScheduler(int num_threads = 0);
+	~DestructibleMapTaskScheduler();
+
+	DestructibleMapTaskScheduler(const DestructibleMapTaskScheduler&) = delete;
+	DestructibleMapTaskScheduler& operator=(const DestructibleMapTaskScheduler&) = delete;
+
+	// must not be called while tasks are running
+	void set_num_threads(int num_threads);
+	int get_num_threads() const
+	{
+		return this->num_threads_;
+	}
+
+	void spawn(DestructibleMapTaskGroup &group, std::function<void()> function);
+	// returns once every task of the group finished, running queued tasks in the meantime. Rethrows the first exception of a task of the group
+	void wait(DestructibleMapTaskGroup &group);
+
+	// calls function(i) for every i in [0, count), in blocks of at least grain_size
+	void parallel_for(int count, const std::function<void(int)> &function, int grain_size = 1);
+};
+
+extern DestructibleMapTaskScheduler map_scheduler;
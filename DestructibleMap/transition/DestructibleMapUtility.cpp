@@ -2,16 +2,20 @@
 #include "clipper.hpp"
 #include <iostream>
 #include "poly2tri/sweep/cdt.h"
-#include "ShaderResource.h"
-#include "MeshResource.h"
 #include <random>
+#include <chrono>
+#include <climits>
+#include <algorithm>
 #include <glm/gtc/quaternion.hpp>
-#include <GLFW/glfw3.h>
-#include "RenderingEngine.h"
 #include "DestructibleMapDrawingBatch.h"
-#include <omp.h>
+#include "DestructibleMapClipperContext.h"
 
 
+double get_time()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 float triangle_area(const float d_x0, const float d_y0, const float d_x1, const float d_y1, const float d_x2, const float d_y2)
 {
 	return abs(((d_x1 - d_x0)*(d_y2 - d_y0) - (d_x2 - d_x0)*(d_y1 - d_y0)) / 2.0);
@@ -30,17 +34,237 @@ void get_bounding_box(const ClipperLib::Path& polygon, glm::ivec2& begin, glm::i
 	}
 }
 
-ClipperLib::Path make_rect(const glm::ivec2 pos, const glm::ivec2 size)
+void make_rect(const glm::ivec2 pos, const glm::ivec2 size, ClipperLib::Path &rect)
 {
-	ClipperLib::Path rect;
+	rect.clear();
 	rect <<
 		ClipperLib::IntPoint(pos.x, pos.y) <<
 		ClipperLib::IntPoint(pos.x + size.x, pos.y) <<
 		ClipperLib::IntPoint(pos.x + size.x, pos.y + size.y) <<
 		ClipperLib::IntPoint(pos.x, pos.y + size.y);
+}
+
+ClipperLib::Path make_rect(const glm::ivec2 pos, const glm::ivec2 size)
+{
+	ClipperLib::Path rect;
+	make_rect(pos, size, rect);
 	return rect;
 }
 
+ClipperLib::cInt get_coordinate(const ClipperLib::IntPoint &point, int axis)
+{
+	return axis == 0 ? point.X : point.Y;
+}
+
+// one Sutherland-Hodgman pass, keeps the part of the path on the inner side of the line where the coordinate of axis is value
+void clip_path_to_line(const ClipperLib::Path &input, int axis, ClipperLib::cInt value, bool keep_greater, ClipperLib::Path &output)
+{
+	output.clear();
+	if (input.empty())
+	{
+		return;
+	}
+
+	const auto other_axis = 1 - axis;
+	auto previous = input.back();
+	auto previous_inside = keep_greater ? get_coordinate(previous, axis) >= value : get_coordinate(previous, axis) <= value;
+	for (const auto &current : input)
+	{
+		const auto current_inside = keep_greater ? get_coordinate(current, axis) >= value : get_coordinate(current, axis) <= value;
+		if (current_inside != previous_inside)
+		{
+			// always interpolate from the same end point, so an edge shared by two paths is cut at the same point
+			const auto &a = previous.X < current.X || (previous.X == current.X && previous.Y < current.Y) ? previous : current;
+			const auto &b = &a == &previous ? current : previous;
+			const auto t = double(value - get_coordinate(a, axis)) / double(get_coordinate(b, axis) - get_coordinate(a, axis));
+			const auto other = get_coordinate(a, other_axis) + ClipperLib::cInt(round((get_coordinate(b, other_axis) - get_coordinate(a, other_axis)) * t));
+
+			const auto intersection = axis == 0 ? ClipperLib::IntPoint(value, other) : ClipperLib::IntPoint(other, value);
+			if (output.empty() || output.back() != intersection)
+			{
+				output.push_back(intersection);
+			}
+		}
+		if (current_inside && (output.empty() || output.back() != current))
+		{
+			output.push_back(current);
+		}
+		previous = current;
+		previous_inside = current_inside;
+	}
+
+	while (output.size() > 1 && output.front() == output.back())
+	{
+		output.pop_back();
+	}
+}
+
+void clip_paths_to_rect(const ClipperLib::Paths &paths, const ClipperLib::Path &rect, ClipperLib::Paths &result)
+{
+	const auto &rect_begin = rect[0];
+	const auto &rect_end = rect[2];
+
+	static thread_local ClipperLib::Path buffers[2];
+
+	// the result paths are overwritten in place, so their memory is reused
+	auto num_paths = 0;
+	for (const auto &path : paths)
+	{
+		glm::ivec2 path_begin, path_end;
+		get_bounding_box(path, path_begin, path_end);
+
+		// completely outside, touching the border does not leave any area either
+		if (path.size() < 3 || path_end.x <= rect_begin.X || path_end.y <= rect_begin.Y || path_begin.x >= rect_end.X || path_begin.y >= rect_end.Y)
+		{
+			continue;
+		}
+
+		if (num_paths == result.size())
+		{
+			result.emplace_back();
+		}
+		auto &clipped = result[num_paths];
+
+		// completely inside
+		if (path_begin.x >= rect_begin.X && path_begin.y >= rect_begin.Y && path_end.x <= rect_end.X && path_end.y <= rect_end.Y)
+		{
+			clipped = path;
+			num_paths++;
+			continue;
+		}
+
+		// only the borders which are crossed by the path need a pass
+		const ClipperLib::Path *input = &path;
+		auto current = 0;
+		const auto clip = [&](bool crossed, int axis, ClipperLib::cInt value, bool keep_greater)
+		{
+			if (crossed)
+			{
+				clip_path_to_line(*input, axis, value, keep_greater, buffers[current]);
+				input = &buffers[current];
+				current = 1 - current;
+			}
+		};
+		clip(path_begin.x < rect_begin.X, 0, rect_begin.X, true);
+		clip(path_end.x > rect_end.X, 0, rect_end.X, false);
+		clip(path_begin.y < rect_begin.Y, 1, rect_begin.Y, true);
+		clip(path_end.y > rect_end.Y, 1, rect_end.Y, false);
+
+		if (input->size() < 3 || ClipperLib::Area(*input) == 0.0)
+		{
+			continue;
+		}
+		clipped = *input;
+		num_paths++;
+	}
+	result.resize(num_paths);
+}
+
+// squared distance of a point to the line segment from begin to end
+static double segment_distance_squared(const ClipperLib::IntPoint &point, const ClipperLib::IntPoint &begin, const ClipperLib::IntPoint &end)
+{
+	const auto dx = double(end.X - begin.X);
+	const auto dy = double(end.Y - begin.Y);
+	auto px = double(point.X - begin.X);
+	auto py = double(point.Y - begin.Y);
+	const auto length_squared = dx * dx + dy * dy;
+	if (length_squared > 0.0)
+	{
+		const auto t = std::min(std::max((px * dx + py * dy) / length_squared, 0.0), 1.0);
+		px -= t * dx;
+		py -= t * dy;
+	}
+	return px * px + py * py;
+}
+
+void simplify_paths(const ClipperLib::Paths &paths, double tolerance, ClipperLib::Paths &result)
+{
+	static thread_local std::vector<char> keep;
+	static thread_local std::vector<std::pair<int, int>> stack;
+	const auto tolerance_squared = tolerance * tolerance;
+
+	// the result paths are overwritten in place, so their memory is reused
+	auto num_paths = 0;
+	for (const auto &path : paths)
+	{
+		const auto num_points = int(path.size());
+		if (num_points < 3)
+		{
+			continue;
+		}
+
+		// smaller than the tolerance in both directions, it would not be visible
+		glm::ivec2 path_begin, path_end;
+		get_bounding_box(path, path_begin, path_end);
+		if (path_end.x - path_begin.x < tolerance && path_end.y - path_begin.y < tolerance)
+		{
+			continue;
+		}
+
+		// the closed path is split at the point furthest away from its first point, both halves are simplified as open lines (Douglas-Peucker).
+		// An index of num_points is the first point again
+		auto furthest = 0;
+		auto furthest_distance = 0.0;
+		for (auto i = 1; i < num_points; i++)
+		{
+			const auto distance = segment_distance_squared(path[i], path[0], path[0]);
+			if (distance > furthest_distance)
+			{
+				furthest = i;
+				furthest_distance = distance;
+			}
+		}
+		keep.assign(num_points, 0);
+		keep[0] = 1;
+		keep[furthest] = 1;
+		stack.clear();
+		stack.push_back(std::make_pair(0, furthest));
+		stack.push_back(std::make_pair(furthest, num_points));
+		while (!stack.empty())
+		{
+			const auto line = stack.back();
+			stack.pop_back();
+
+			auto split = -1;
+			auto split_distance = tolerance_squared;
+			for (auto i = line.first + 1; i < line.second; i++)
+			{
+				const auto distance = segment_distance_squared(path[i], path[line.first], path[line.second % num_points]);
+				if (distance > split_distance)
+				{
+					split = i;
+					split_distance = distance;
+				}
+			}
+			if (split >= 0)
+			{
+				keep[split] = 1;
+				stack.push_back(std::make_pair(line.first, split));
+				stack.push_back(std::make_pair(split, line.second));
+			}
+		}
+
+		if (num_paths == result.size())
+		{
+			result.emplace_back();
+		}
+		auto &simplified = result[num_paths];
+		simplified.clear();
+		for (auto i = 0; i < num_points; i++)
+		{
+			if (keep[i])
+			{
+				simplified.push_back(path[i]);
+			}
+		}
+		if (simplified.size() >= 3)
+		{
+			num_paths++;
+		}
+	}
+	result.resize(num_paths);
+}
+
 ClipperLib::Path make_circle(const glm::ivec2 pos, const float radius, const int num_of_points)
 {
 	auto angle_step = glm::radians(360.0f) / num_of_points;
@@ -94,10 +318,9 @@ void include_point_in_end_boundary(glm::vec2& end_boundary, const glm::vec2& pos
 	end_boundary.y = std::max(end_boundary.y, pos.y);
 }
 
-void generate_point_cloud(float triangle_area_ratio, const std::vector<glm::vec2> &vertices, std::vector<glm::vec2> &points)
+void generate_point_cloud(float triangle_area_ratio, const std::vector<glm::vec2> &vertices, std::vector<glm::vec2> &points, unsigned int seed)
 {
-	std::random_device seeder;
-	std::mt19937 engine(seeder());
+	std::mt19937 engine(seed);
 	std::uniform_real_distribution<float> uniform_dist(0.0, 1.0);
 
 	points.clear();
@@ -128,7 +351,7 @@ void generate_point_cloud(float triangle_area_ratio, const std::vector<glm::vec2
 	}
 
 	// shuffle points to avoid degenerate quadtree
-	std::random_shuffle(points.begin(), points.end());
+	std::shuffle(points.begin(), points.end(), engine);
 }
 
 void ensure_points_not_overlapping(ClipperLib::Path &path)
@@ -140,6 +363,13 @@ void ensure_points_not_overlapping(ClipperLib::Path &path)
 		path[i].Y - path[prev].Y > 0 ? path[i].Y-- : path[i].Y++;
 		prev = i;
 	}
+
+	// points only a unit apart may end up on the same position, poly2tri does not accept repeated points
+	path.erase(std::unique(path.begin(), path.end()), path.end());
+	while (path.size() > 1 && path.front() == path.back())
+	{
+		path.pop_back();
+	}
 }
 
 void triangulate(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &vertices)
@@ -183,6 +413,9 @@ void triangulate(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &
 	{
 		if (!current_node->IsHole())
 		{
+			// everything poly2tri allocates for this polygon comes from the arena of this thread and is released at the end of the block
+			p2t::ArenaScope arena_scope;
+
 			// convert to Poly2Tri Polygon
 
 			int num_points = 0;
@@ -200,8 +433,10 @@ void triangulate(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &
 				}
 
 				if (child_node->Contour.size() >= 3) {
-					hole_polyline.clear();
 					ensure_points_not_overlapping(child_node->Contour);
+				}
+				if (child_node->Contour.size() >= 3) {
+					hole_polyline.clear();
 					path_to_polyline(hole_polyline, child_node, points, num_points);
 					cdt->AddHole(hole_polyline);
 				}
@@ -210,7 +445,7 @@ void triangulate(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &
 
 			cdt->Triangulate();
 
-			auto triangles = cdt->GetTriangles();
+			const auto &triangles = cdt->GetTriangles();
 			for (auto& triangle : triangles) {
 				const auto p0 = triangle->GetPoint(0);
 				const auto p1 = triangle->GetPoint(1);
@@ -233,30 +468,48 @@ void triangulate(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &
 	delete[] points;
 }
 
-void triangulate_fast(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &vertices)
+void triangulate_fast(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &vertices, int triangulation_buffer)
 {
 	if (poly_tree.Total() == 0)
 	{
 		return;
 	}
 
-	p2t::Point points[TRIANGULATION_BUFFER];
-	std::vector<p2t::Point*> polyline;
-	polyline.reserve(TRIANGULATION_BUFFER);
-	std::vector<p2t::Point*> hole_polyline;
-	polyline.reserve(TRIANGULATION_BUFFER);
+	// scratch buffers are kept per thread, so they are only allocated once and not for each chunk
+	static thread_local std::vector<p2t::Point> points;
+	if (points.size() < triangulation_buffer)
+	{
+		points.resize(triangulation_buffer);
+	}
+	static thread_local std::vector<p2t::Point*> polyline;
+	polyline.reserve(triangulation_buffer);
+	static thread_local std::vector<p2t::Point*> hole_polyline;
+	hole_polyline.reserve(triangulation_buffer);
 
 	auto current_node = poly_tree.GetFirst()->Parent;
 	while (current_node != nullptr)
 	{
 		if (!current_node->IsHole())
 		{
+			// the buffer may only grow before any point of this polygon is referenced
+			size_t needed_num_points = current_node->Contour.size();
+			for (auto &child_node : current_node->Childs)
+			{
+				needed_num_points += child_node->Contour.size();
+			}
+			if (points.size() < needed_num_points)
+			{
+				points.resize(needed_num_points);
+			}
+
+			// everything poly2tri allocates for this polygon comes from the arena of this thread and is released at the end of the block
+			p2t::ArenaScope arena_scope;
+
 			// convert to Poly2Tri Polygon
 
 			int num_points = 0;
 			polyline.clear();
-			path_to_polyline(polyline, current_node, points, num_points);
-			assert(num_points < TRIANGULATION_BUFFER);
+			path_to_polyline(polyline, current_node, points.data(), num_points);
 
 			p2t::CDT* cdt = new p2t::CDT(polyline);
 
@@ -269,18 +522,27 @@ void triangulate_fast(const ClipperLib::PolyTree &poly_tree, std::vector<glm::ve
 				}
 
 				if (child_node->Contour.size() >= 3) {
-					hole_polyline.clear();
 					ensure_points_not_overlapping(child_node->Contour);
-					path_to_polyline(hole_polyline, child_node, points, num_points);
-					assert(num_points < TRIANGULATION_BUFFER);
+				}
+				if (child_node->Contour.size() >= 3) {
+					hole_polyline.clear();
+					path_to_polyline(hole_polyline, child_node, points.data(), num_points);
 					cdt->AddHole(hole_polyline);
 				}
 
 			}
 
-			cdt->Triangulate();
+			try
+			{
+				cdt->Triangulate();
+			}
+			catch (...)
+			{
+				delete cdt;
+				throw;
+			}
 
-			auto triangles = cdt->GetTriangles();
+			const auto &triangles = cdt->GetTriangles();
 			for (auto& triangle : triangles) {
 				const auto p0 = triangle->GetPoint(0);
 				const auto p1 = triangle->GetPoint(1);
@@ -302,9 +564,139 @@ void triangulate_fast(const ClipperLib::PolyTree &poly_tree, std::vector<glm::ve
 	}
 }
 
-void generate_aabb(const std::vector<glm::vec2> &vertices, glm::vec2& boundary_begin, glm::vec2& boundary_end)
+unsigned int spread_bits(unsigned int value)
+{
+	// inserts a zero bit between each of the lower 16 bits
+	value &= 0x0000ffff;
+	value = (value | (value << 8)) & 0x00ff00ff;
+	value = (value | (value << 4)) & 0x0f0f0f0f;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+unsigned int morton_code(const glm::vec2 &point, const glm::vec2 &begin, const glm::vec2 &end)
+{
+	// position inside of the bounds on a 16 bit grid, the bits of x and y are interleaved
+	const auto normalized = glm::clamp((point - begin) / (end - begin), 0.0f, 1.0f);
+	return spread_bits(static_cast<unsigned int>(normalized.x * 65535.0f)) | (spread_bits(static_cast<unsigned int>(normalized.y * 65535.0f)) << 1);
+}
+
+float edge_side(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &p)
+{
+	return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+bool triangle_intersects_rect(const glm::vec2 &v0, const glm::vec2 &v1, const glm::vec2 &v2, const glm::vec2 &rect_begin, const glm::vec2 &rect_end)
+{
+	const auto triangle_begin = glm::min(v0, glm::min(v1, v2));
+	const auto triangle_end = glm::max(v0, glm::max(v1, v2));
+	if (triangle_end.x < rect_begin.x || triangle_end.y < rect_begin.y || triangle_begin.x > rect_end.x || triangle_begin.y > rect_end.y)
+	{
+		return false;
+	}
+
+	// separating axis test: the rect is outside if all its corners are on the outer side of one triangle edge
+	const auto orientation = edge_side(v0, v1, v2) < 0.0f ? -1.0f : 1.0f;
+	const glm::vec2 triangle[] = { v0, v1, v2 };
+	const glm::vec2 corners[] = {
+		rect_begin,
+		glm::vec2(rect_end.x, rect_begin.y),
+		rect_end,
+		glm::vec2(rect_begin.x, rect_end.y)
+	};
+	for (auto i = 0; i < 3; i++)
+	{
+		const auto &a = triangle[i];
+		const auto &b = triangle[(i + 1) % 3];
+		auto outside = true;
+		for (auto &corner : corners)
+		{
+			if (edge_side(a, b, corner) * orientation >= 0.0f)
+			{
+				outside = false;
+				break;
+			}
+		}
+		if (outside)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool triangles_to_outline(const ClipperLib::Paths &triangles, ClipperLib::Paths &outline)
 {
-	for (auto i = 0; i < vertices.size(); i++)
+	// edges shared by two triangles run in opposite directions and cancel each other out, the rest is the outline
+	std::vector<std::pair<ClipperLib::IntPoint, ClipperLib::IntPoint>> edges;
+	for (auto triangle : triangles)
+	{
+		if (!ClipperLib::Orientation(triangle))
+		{
+			ClipperLib::ReversePath(triangle);
+		}
+
+		for (auto i = 0; i < 3; i++)
+		{
+			const auto &a = triangle[i];
+			const auto &b = triangle[(i + 1) % 3];
+			auto found = false;
+			for (auto j = 0; j < edges.size(); j++)
+			{
+				if (edges[j].first == b && edges[j].second == a)
+				{
+					edges[j] = edges.back();
+					edges.pop_back();
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+			{
+				edges.push_back(std::make_pair(a, b));
+			}
+		}
+	}
+
+	// link the remaining edges to closed paths
+	while (!edges.empty())
+	{
+		const auto start = edges.back();
+		edges.pop_back();
+
+		ClipperLib::Path path;
+		path.push_back(start.first);
+		auto current = start.second;
+		while (current != start.first)
+		{
+			auto next = -1;
+			for (auto j = 0; j < edges.size(); j++)
+			{
+				if (edges[j].first == current)
+				{
+					next = j;
+					break;
+				}
+			}
+			if (next < 0)
+			{
+				return false;
+			}
+
+			path.push_back(current);
+			current = edges[next].second;
+			edges[next] = edges.back();
+			edges.pop_back();
+		}
+		outline.push_back(path);
+	}
+	return true;
+}
+
+void generate_aabb(const glm::vec2 *vertices, int num_vertices, glm::vec2& boundary_begin, glm::vec2& boundary_end)
+{
+	for (auto i = 0; i < num_vertices; i++)
 	{
 		const auto& v = vertices[i];
 
@@ -313,6 +705,11 @@ void generate_aabb(const std::vector<glm::vec2> &vertices, glm::vec2& boundary_b
 	}
 }
 
+void generate_aabb(const std::vector<glm::vec2> &vertices, glm::vec2& boundary_begin, glm::vec2& boundary_end)
+{
+	generate_aabb(vertices.data(), int(vertices.size()), boundary_begin, boundary_end);
+}
+
 void print_vertices(const std::vector<glm::vec2> &vertices)
 {
 	std::cout << "Vertices: " << std::endl;
@@ -324,7 +721,8 @@ void print_vertices(const std::vector<glm::vec2> &vertices)
 
 void paths_to_polytree(const ClipperLib::Paths &paths, ClipperLib::PolyTree &poly_tree)
 {
-	ClipperLib::Clipper c;
+	ClipperScope scope;
+	auto &c = scope->clipper;
 	c.StrictlySimple(true);
 	c.AddPaths(paths, ClipperLib::ptSubject, true);
 	if (!c.Execute(ClipperLib::ctUnion, poly_tree, ClipperLib::pftNonZero))
@@ -2,10 +2,24 @@
 #include "DestructibleMap.h"
 #include "clipper.hpp"
 
+double get_time();
+float triangle_area(const float d_x0, const float d_y0, const float d_x1, const float d_y1, const float d_x2, const float d_y2);
 ClipperLib::Path make_rect(const glm::ivec2 pos, const glm::ivec2 size);
+// same as above, reusing the memory of rect
+void make_rect(const glm::ivec2 pos, const glm::ivec2 size, ClipperLib::Path &rect);
+// clips each path against a rectangle made by make_rect (Sutherland-Hodgman), keeping its orientation, so holes stay holes.
+// Concave paths may keep zero width bridges along the border, which the next Clipper operation removes
+void clip_paths_to_rect(const ClipperLib::Paths &paths, const ClipperLib::Path &rect, ClipperLib::Paths &result);
+// Douglas-Peucker on closed paths: drops the points closer than tolerance (in Clipper coordinates) to the simplified outline, and every path
+// smaller than the tolerance. The result may intersect itself, so it has to go through a union before it is triangulated
+void simplify_paths(const ClipperLib::Paths &paths, double tolerance, ClipperLib::Paths &result);
 void get_bounding_box(const ClipperLib::Path& polygon, glm::ivec2& begin, glm::ivec2& end);
-void generate_point_cloud(float triangle_area_ratio, const std::vector<glm::vec2> &vertices, std::vector<glm::vec2> &points);
+void generate_point_cloud(float triangle_area_ratio, const std::vector<glm::vec2> &vertices, std::vector<glm::vec2> &points, unsigned int seed);
 void triangulate(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &vertices);
-void triangulate_fast(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &vertices);
+void triangulate_fast(const ClipperLib::PolyTree &poly_tree, std::vector<glm::vec2> &vertices, int triangulation_buffer);
+bool triangle_intersects_rect(const glm::vec2 &v0, const glm::vec2 &v1, const glm::vec2 &v2, const glm::vec2 &rect_begin, const glm::vec2 &rect_end);
+bool triangles_to_outline(const ClipperLib::Paths &triangles, ClipperLib::Paths &outline);
+unsigned int morton_code(const glm::vec2 &point, const glm::vec2 &begin, const glm::vec2 &end);
 void generate_aabb(const std::vector<glm::vec2> &vertices, glm::vec2& boundary_begin, glm::vec2& boundary_end);
+void generate_aabb(const glm::vec2 *vertices, int num_vertices, glm::vec2& boundary_begin, glm::vec2& boundary_end);
 void paths_to_polytree(const ClipperLib::Paths &paths, ClipperLib::PolyTree &poly_tree);
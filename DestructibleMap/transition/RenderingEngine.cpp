@@ -4,6 +4,7 @@
 #include "DestructibleMapChunk.h"
 #include "DestructibleMapController.h"
 #include "DestructibleMap.h"
+#include "DestructibleMapRenderer.h"
 
 RenderingEngine::RenderingEngine(const glm::ivec2 viewport, bool fullscreen, int refresh_rate)
 {
@@ -33,7 +34,8 @@ void RenderingEngine::run()
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
 #endif
 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// the batches are drawn with glMultiDrawElementsIndirect, the base instance of each command selects the render attributes of its chunk
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -84,11 +86,26 @@ void RenderingEngine::run()
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_BACK);
 
-	auto map = new DestructibleMap(0.001f, 0.01f);
-	map->generate_map();
-	map->init(this);
+	DestructibleMapConfig config;
+	config.triangle_area_ratio = 0.001f;
+	config.points_per_leaf_ratio = 0.01f;
 
-	auto controller = new DestructibleMapController(map);
+	// a snapshot written by an earlier start is loaded instead of generating the map again, unless it was written with another configuration
+	auto map = new DestructibleMap(config);
+	if (!map->load_snapshot(MAP_SNAPSHOT_FILE))
+	{
+		map->generate_map();
+		map->save_snapshot(MAP_SNAPSHOT_FILE);
+	}
+	if (config.resident_bytes_limit > 0)
+	{
+		map->set_page_file(MAP_PAGE_FILE);
+	}
+
+	auto renderer = new DestructibleMapRenderer(map);
+	renderer->init(this);
+
+	auto controller = new DestructibleMapController(map, renderer);
 	controller->init(this);
 
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -106,7 +123,7 @@ void RenderingEngine::run()
 		fps_count++;
 
 		if (current_time - last_fps_show > 0.5) {
-			std::cout << "Avg FPS: " << (total_fps / fps_count) << " Draw Calls: " << map_draw_calls << std::endl;
+			std::cout << "Avg FPS: " << (total_fps / fps_count) << " Draw Calls: " << map_draw_calls << " Culled Batches: " << map_culled_batches << " Uploaded Bytes: " << map_uploaded_bytes << std::endl;
 			last_fps_show = current_time;
 			fps_count = 0;
 			total_fps = 0;
@@ -122,15 +139,16 @@ void RenderingEngine::run()
 		glViewport(0, 0, this->viewport_.x, this->viewport_.y);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		map->draw();
+		renderer->draw();
 
 		glfwSwapBuffers(this->window_);
 		glfwPollEvents();
 	}
-	glfwTerminate();
-
-	delete map;
 	delete controller;
+	delete renderer;
+	delete map;
+
+	glfwTerminate();
 }
 
 GLFWwindow* RenderingEngine::get_window() const
@@ -17,7 +17,7 @@ class RenderingEngine
 	glm::mat4 projection_matrix_;
 	glm::mat4 view_matrix_;
 public:
-	explicit RenderingEngine::RenderingEngine(const glm::ivec2 viewport, bool fullscreen, int refresh_rate);
+	explicit RenderingEngine(const glm::ivec2 viewport, bool fullscreen, int refresh_rate);
 	~RenderingEngine();
 
 	void run();
@@ -1,10 +1,10 @@
-#version 330 core
+#version 430 core
 
 out vec4 FragColor;
 
-uniform vec3 base_color;
+flat in vec3 color;
 
 void main() {
-	FragColor = vec4(base_color, 1.0f);
+	FragColor = vec4(color, 1.0f);
 }
 
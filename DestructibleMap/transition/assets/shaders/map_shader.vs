@@ -1,5 +1,7 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec2 aPos;
+// CHUNK_ATTRIBUTE_* flags of the chunk, read per instance (the base instance of each draw command is the chunk id), see GLBatchBackend
+layout (location = 1) in uint aChunkAttributes;
 
 struct VP {
 	mat4 view;
@@ -7,8 +9,16 @@ struct VP {
 };
 
 uniform VP vp;
+uniform vec3 base_color;
+uniform vec3 highlight_color;
+uniform bool use_chunk_attributes;
+
+const uint CHUNK_ATTRIBUTE_HIGHLIGHTED = 1u;
+
+flat out vec3 color;
 
 void main()
 {
 	gl_Position = vp.projection * vp.view * vec4(aPos, 0.0, 1.0);
+	color = use_chunk_attributes && (aChunkAttributes & CHUNK_ATTRIBUTE_HIGHLIGHTED) != 0u ? highlight_color : base_color;
 }
\ No newline at end of file
@@ -63,6 +63,42 @@ static int const Skip = -2;        //edge that would otherwise close a path
 #define TOLERANCE (1.0e-20)
 #define NEAR_ZERO(val) (((val) > -TOLERANCE) && ((val) < TOLERANCE))
 
+//OutRec, OutPt, Join and IntersectNode are created and disposed many times
+//for every clipping operation. Disposed objects are kept per thread and
+//reused by the next allocation of the same type. The lists are trivially
+//destructible thread_locals, objects still in them when a thread ends are
+//not freed ...
+template <class T>
+struct ObjectPool
+{
+  struct FreeObject { FreeObject *Next; };
+  static thread_local FreeObject *m_Free;
+
+  static void* Allocate()
+  {
+    if (!m_Free)
+      return ::operator new(sizeof(T) > sizeof(FreeObject) ? sizeof(T) : sizeof(FreeObject));
+    FreeObject *result = m_Free;
+    m_Free = result->Next;
+    return result;
+  }
+
+  static void Free(void *ptr)
+  {
+    if (!ptr) return;
+    FreeObject *obj = static_cast<FreeObject*>(ptr);
+    obj->Next = m_Free;
+    m_Free = obj;
+  }
+};
+
+template <class T>
+thread_local typename ObjectPool<T>::FreeObject *ObjectPool<T>::m_Free = 0;
+
+#define CLIPPER_POOLED(T) \
+  static void* operator new(size_t) { return ObjectPool<T>::Allocate(); } \
+  static void operator delete(void *ptr) { ObjectPool<T>::Free(ptr); }
+
 struct TEdge {
   IntPoint Bot;
   IntPoint Curr; //current (updated for every new scanbeam)
@@ -87,6 +123,7 @@ struct IntersectNode {
   TEdge          *Edge1;
   TEdge          *Edge2;
   IntPoint        Pt;
+  CLIPPER_POOLED(IntersectNode)
 };
 
 struct LocalMinimum {
@@ -107,6 +144,7 @@ struct OutRec {
   PolyNode *PolyNd;
   OutPt    *Pts;
   OutPt    *BottomPt;
+  CLIPPER_POOLED(OutRec)
 };
 
 struct OutPt {
@@ -114,12 +152,14 @@ struct OutPt {
   IntPoint  Pt;
   OutPt    *Next;
   OutPt    *Prev;
+  CLIPPER_POOLED(OutPt)
 };
 
 struct Join {
   OutPt    *OutPt1;
   OutPt    *OutPt2;
   IntPoint  OffPt;
+  CLIPPER_POOLED(Join)
 };
 
 struct LocMinSorter
@@ -149,15 +189,39 @@ inline cInt Abs(cInt val)
 // PolyTree methods ...
 //------------------------------------------------------------------------------
 
+PolyTree::~PolyTree()
+{
+    Clear();
+    for (PolyNodes::size_type i = 0; i < FreeNodes.size(); ++i)
+      delete FreeNodes[i];
+}
+//------------------------------------------------------------------------------
+
 void PolyTree::Clear()
 {
     for (PolyNodes::size_type i = 0; i < AllNodes.size(); ++i)
-      delete AllNodes[i];
+    {
+      AllNodes[i]->Contour.clear();
+      AllNodes[i]->Childs.clear();
+      FreeNodes.push_back(AllNodes[i]);
+    }
     AllNodes.resize(0); 
     Childs.resize(0);
 }
 //------------------------------------------------------------------------------
 
+PolyNode* PolyTree::NewNode()
+{
+    if (FreeNodes.empty()) return new PolyNode();
+    PolyNode* result = FreeNodes.back();
+    FreeNodes.pop_back();
+    result->Parent = 0;
+    result->Index = 0;
+    result->m_IsOpen = false;
+    return result;
+}
+//------------------------------------------------------------------------------
+
 PolyNode* PolyTree::GetFirst() const
 {
   if (!Childs.empty())
@@ -884,12 +948,44 @@ ClipperBase::ClipperBase() //constructor
 {
   m_CurrentLM = m_MinimaList.begin(); //begin() == end() here
   m_UseFullRange = false;
+  m_EdgeBlock = 0;
+  m_EdgeOffset = 0;
 }
 //------------------------------------------------------------------------------
 
 ClipperBase::~ClipperBase() //destructor
 {
   Clear();
+  for (EdgeList::size_type i = 0; i < m_edges.size(); ++i)
+    delete [] m_edges[i];
+}
+//------------------------------------------------------------------------------
+
+TEdge* ClipperBase::AllocEdges(size_t count)
+{
+  //the edges of one path are contiguous, so they never span two blocks ...
+  while (m_EdgeBlock < m_edges.size() && m_EdgeOffset + count > m_EdgeBlockSizes[m_EdgeBlock])
+  {
+    ++m_EdgeBlock;
+    m_EdgeOffset = 0;
+  }
+  if (m_EdgeBlock == m_edges.size())
+  {
+    size_t size = count > 1024 ? count : 1024;
+    m_edges.push_back(new TEdge [size]);
+    m_EdgeBlockSizes.push_back(size);
+    m_EdgeOffset = 0;
+  }
+  TEdge* result = m_edges[m_EdgeBlock] + m_EdgeOffset;
+  m_EdgeOffset += count;
+  return result;
+}
+//------------------------------------------------------------------------------
+
+void ClipperBase::FreeEdges(size_t count)
+{
+  //only the edges of the last path can be given back ...
+  m_EdgeOffset -= count;
 }
 //------------------------------------------------------------------------------
 
@@ -1058,7 +1154,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   if ((Closed && highI < 2) || (!Closed && highI < 1)) return false;
 
   //create a new edge array ...
-  TEdge *edges = new TEdge [highI +1];
+  TEdge *edges = AllocEdges(highI +1);
 
   bool IsFlat = true;
   //1. Basic (first) edge initialization ...
@@ -1077,7 +1173,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   }
   catch(...)
   {
-    delete [] edges;
+    FreeEdges(highI +1);
     throw; //range test fails
   }
   TEdge *eStart = &edges[0];
@@ -1118,7 +1214,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
 
   if ((!Closed && (E == E->Next)) || (Closed && (E->Prev == E->Next)))
   {
-    delete [] edges;
+    FreeEdges(highI +1);
     return false;
   }
 
@@ -1146,7 +1242,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   {
     if (Closed) 
     {
-      delete [] edges;
+      FreeEdges(highI +1);
       return false;
     }
     E->Prev->OutIdx = Skip;
@@ -1164,11 +1260,9 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
       E = E->Next;
     }
     m_MinimaList.push_back(locMin);
-    m_edges.push_back(edges);
 	  return true;
   }
 
-  m_edges.push_back(edges);
   bool leftBoundIsForward;
   TEdge* EMin = 0;
 
@@ -1233,12 +1327,8 @@ bool ClipperBase::AddPaths(const Paths &ppg, PolyType PolyTyp, bool Closed)
 void ClipperBase::Clear()
 {
   DisposeLocalMinimaList();
-  for (EdgeList::size_type i = 0; i < m_edges.size(); ++i)
-  {
-    TEdge* edges = m_edges[i];
-    delete [] edges;
-  }
-  m_edges.clear();
+  m_EdgeBlock = 0;
+  m_EdgeOffset = 0;
   m_UseFullRange = false;
   m_HasOpenPaths = false;
 }
@@ -1250,7 +1340,7 @@ void ClipperBase::Reset()
   if (m_CurrentLM == m_MinimaList.end()) return; //ie nothing to process
   std::sort(m_MinimaList.begin(), m_MinimaList.end(), LocMinSorter());
 
-  m_Scanbeam = ScanbeamList(); //clears/resets priority_queue
+  while (!m_Scanbeam.empty()) m_Scanbeam.pop(); //clears priority_queue, keeps its memory
   //reset all edges ...
   for (MinimaList::iterator lm = m_MinimaList.begin(); lm != m_MinimaList.end(); ++lm)
   {
@@ -1512,13 +1602,13 @@ bool Clipper::Execute(ClipType clipType, Paths &solution,
   if (m_HasOpenPaths)
     throw clipperException("Error: PolyTree struct is needed for open path clipping.");
   m_ExecuteLocked = true;
-  solution.resize(0);
   m_SubjFillType = subjFillType;
   m_ClipFillType = clipFillType;
   m_ClipType = clipType;
   m_UsingPolyTree = false;
   bool succeeded = ExecuteInternal();
   if (succeeded) BuildResult(solution);
+  else solution.resize(0);
   DisposeAllOutRecs();
   m_ExecuteLocked = false;
   return succeeded;
@@ -1562,7 +1652,7 @@ bool Clipper::ExecuteInternal()
   bool succeeded = true;
   try {
     Reset();
-    m_Maxima = MaximaList();
+    m_Maxima.clear();
     m_SortedEdges = 0;
 
     succeeded = true;
@@ -3071,7 +3161,7 @@ void Clipper::ProcessEdgesAtTopOfScanbeam(const cInt topY)
   }
 
   //3. Process horizontals at the Top of the scanbeam ...
-  m_Maxima.sort();
+  std::sort(m_Maxima.begin(), m_Maxima.end());
   ProcessHorizontals();
   m_Maxima.clear();
 
@@ -3198,22 +3288,26 @@ int PointCount(OutPt *Pts)
 
 void Clipper::BuildResult(Paths &polys)
 {
+  //paths already in polys are overwritten, so a reused solution keeps its memory ...
+  size_t count = 0;
   polys.reserve(m_PolyOuts.size());
   for (PolyOutList::size_type i = 0; i < m_PolyOuts.size(); ++i)
   {
     if (!m_PolyOuts[i]->Pts) continue;
-    Path pg;
     OutPt* p = m_PolyOuts[i]->Pts->Prev;
     int cnt = PointCount(p);
     if (cnt < 2) continue;
+    if (count == polys.size()) polys.push_back(Path());
+    Path& pg = polys[count++];
+    pg.clear();
     pg.reserve(cnt);
     for (int i = 0; i < cnt; ++i)
     {
       pg.push_back(p->Pt);
       p = p->Prev;
     }
-    polys.push_back(pg);
   }
+  polys.resize(count);
 }
 //------------------------------------------------------------------------------
 
@@ -3228,7 +3322,7 @@ void Clipper::BuildResult2(PolyTree& polytree)
         int cnt = PointCount(outRec->Pts);
         if ((outRec->IsOpen && cnt < 2) || (!outRec->IsOpen && cnt < 3)) continue;
         FixHoleLinkage(*outRec);
-        PolyNode* pn = new PolyNode();
+        PolyNode* pn = polytree.NewNode();
         //nb: polytree takes ownership of all the PolyNodes
         polytree.AllNodes.push_back(pn);
         outRec->PolyNd = pn;
@@ -4559,32 +4653,40 @@ void MinkowskiDiff(const Path& poly1, const Path& poly2, Paths& solution)
 
 enum NodeType {ntAny, ntOpen, ntClosed};
 
-void AddPolyNodeToPaths(const PolyNode& polynode, NodeType nodetype, Paths& paths)
+//paths that are already in the output are overwritten (instead of being
+//freed and allocated again), so reusing the output does not allocate ...
+void AddPolyNodeToPaths(const PolyNode& polynode, NodeType nodetype, Paths& paths, size_t& count)
 {
   bool match = true;
   if (nodetype == ntClosed) match = !polynode.IsOpen();
   else if (nodetype == ntOpen) return;
 
   if (!polynode.Contour.empty() && match)
-    paths.push_back(polynode.Contour);
+  {
+    if (count < paths.size()) paths[count] = polynode.Contour;
+    else paths.push_back(polynode.Contour);
+    ++count;
+  }
   for (int i = 0; i < polynode.ChildCount(); ++i)
-    AddPolyNodeToPaths(*polynode.Childs[i], nodetype, paths);
+    AddPolyNodeToPaths(*polynode.Childs[i], nodetype, paths, count);
 }
 //------------------------------------------------------------------------------
 
 void PolyTreeToPaths(const PolyTree& polytree, Paths& paths)
 {
-  paths.resize(0); 
+  size_t count = 0;
   paths.reserve(polytree.Total());
-  AddPolyNodeToPaths(polytree, ntAny, paths);
+  AddPolyNodeToPaths(polytree, ntAny, paths, count);
+  paths.resize(count);
 }
 //------------------------------------------------------------------------------
 
 void ClosedPathsFromPolyTree(const PolyTree& polytree, Paths& paths)
 {
-  paths.resize(0); 
+  size_t count = 0;
   paths.reserve(polytree.Total());
-  AddPolyNodeToPaths(polytree, ntClosed, paths);
+  AddPolyNodeToPaths(polytree, ntClosed, paths, count);
+  paths.resize(count);
 }
 //------------------------------------------------------------------------------
 
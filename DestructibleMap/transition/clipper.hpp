@@ -155,18 +155,23 @@ private:
     void AddChild(PolyNode& child);
     friend class Clipper; //to access Index
     friend class ClipperOffset; 
+    friend class PolyTree; //to reset recycled nodes
 };
 
+//Clear() keeps the nodes (and the memory of their contours) for the next
+//result, so a PolyTree that is reused does not need to allocate again ...
 class PolyTree: public PolyNode
 { 
 public:
-    ~PolyTree(){ Clear(); };
+    ~PolyTree();
     PolyNode* GetFirst() const;
     void Clear();
     int Total() const;
 private:
   //PolyTree& operator =(PolyTree& other);
   PolyNodes AllNodes;
+  PolyNodes FreeNodes;
+  PolyNode* NewNode();
     friend class Clipper; //to access AllNodes
 };
 
@@ -243,13 +248,19 @@ protected:
   void SwapPositionsInAEL(TEdge *edge1, TEdge *edge2);
   void DeleteFromAEL(TEdge *e);
   void UpdateEdgeIntoAEL(TEdge *&e);
+  TEdge* AllocEdges(size_t count);
+  void FreeEdges(size_t count);
 
   typedef std::vector<LocalMinimum> MinimaList;
   MinimaList::iterator m_CurrentLM;
   MinimaList           m_MinimaList;
 
   bool              m_UseFullRange;
+  //the edges of all paths are taken from blocks, which are kept by Clear() ...
   EdgeList          m_edges;
+  std::vector<size_t> m_EdgeBlockSizes;
+  size_t            m_EdgeBlock;
+  size_t            m_EdgeOffset;
   bool              m_PreserveCollinear;
   bool              m_HasOpenPaths;
   PolyOutList       m_PolyOuts;
@@ -293,7 +304,7 @@ private:
   JoinList         m_GhostJoins;
   IntersectList    m_IntersectList;
   ClipType         m_ClipType;
-  typedef std::list<cInt> MaximaList;
+  typedef std::vector<cInt> MaximaList;
   MaximaList       m_Maxima;
   TEdge           *m_SortedEdges;
   bool             m_ExecuteLocked;
@@ -0,0 +1,87 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace p2t {
+
+// big enough for a chunk of the map, bigger triangulations get more blocks
+const size_t kArenaBlockSize = 64 * 1024;
+const size_t kArenaAlignment = 16;
+
+Arena::Arena() : block_(0), offset_(0), block_allocations_(0)
+{
+}
+
+Arena::~Arena()
+{
+  for (unsigned int i = 0; i < blocks_.size(); i++) {
+    free(blocks_[i]);
+  }
+}
+
+Arena& Arena::Current()
+{
+  static thread_local Arena arena;
+  return arena;
+}
+
+void* Arena::Allocate(size_t size)
+{
+  size = (size + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+  if (blocks_.empty() || offset_ + size > sizes_[block_]) {
+    NextBlock(size);
+  }
+  void* pointer = blocks_[block_] + offset_;
+  offset_ += size;
+  return pointer;
+}
+
+void Arena::NextBlock(size_t size)
+{
+  const size_t next = blocks_.empty() ? 0 : block_ + 1;
+
+  // a released block is reused if the allocation fits into it
+  if (next >= blocks_.size() || sizes_[next] < size) {
+    const size_t block_size = std::max(kArenaBlockSize, size);
+    char* block = static_cast<char*>(malloc(block_size));
+    if (block == NULL) {
+      throw std::bad_alloc();
+    }
+    blocks_.insert(blocks_.begin() + next, block);
+    sizes_.insert(sizes_.begin() + next, block_size);
+    block_allocations_++;
+  }
+  block_ = next;
+  offset_ = 0;
+}
+
+Arena::Mark Arena::GetMark() const
+{
+  Mark mark;
+  mark.block = block_;
+  mark.offset = offset_;
+  return mark;
+}
+
+void Arena::Release(const Mark& mark)
+{
+  block_ = mark.block;
+  offset_ = mark.offset;
+}
+
+long long Arena::block_allocations() const
+{
+  return block_allocations_;
+}
+
+size_t Arena::capacity() const
+{
+  size_t capacity = 0;
+  for (unsigned int i = 0; i < sizes_.size(); i++) {
+    capacity += sizes_[i];
+  }
+  return capacity;
+}
+
+}
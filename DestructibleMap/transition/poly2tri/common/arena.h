@@ -0,0 +1,114 @@
+/*
+ * Scratch memory of poly2tri.
+ *
+ * All objects and containers of a triangulation (triangles, nodes, edges and
+ * the vectors/lists of the sweep) are taken from a per thread bump arena.
+ * Freeing them does nothing, the memory is given back at once when the
+ * ArenaScope around the triangulation ends. The blocks of the arena are kept,
+ * so once they are big enough a triangulation does not use the heap at all.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <list>
+#include <vector>
+
+namespace p2t {
+
+class Arena {
+public:
+
+  /// Position of the arena, everything allocated after it can be released at once
+  struct Mark {
+    size_t block;
+    size_t offset;
+  };
+
+  Arena();
+  ~Arena();
+
+  /// Arena of the calling thread
+  static Arena& Current();
+
+  void* Allocate(size_t size);
+
+  Mark GetMark() const;
+  void Release(const Mark& mark);
+
+  /// Number of blocks requested from the heap since the thread started
+  long long block_allocations() const;
+  size_t capacity() const;
+
+private:
+
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  void NextBlock(size_t size);
+
+  std::vector<char*> blocks_;
+  std::vector<size_t> sizes_;
+  size_t block_;
+  size_t offset_;
+  long long block_allocations_;
+};
+
+/// Releases everything allocated from the arena of this thread during its lifetime
+class ArenaScope {
+public:
+  ArenaScope() : arena_(Arena::Current()), mark_(arena_.GetMark()) {}
+  ~ArenaScope() { arena_.Release(mark_); }
+
+private:
+  ArenaScope(const ArenaScope&);
+  ArenaScope& operator=(const ArenaScope&);
+
+  Arena& arena_;
+  Arena::Mark mark_;
+};
+
+/// STL allocator on top of the arena of the calling thread
+template <class T>
+struct ArenaAllocator {
+  typedef T value_type;
+
+  ArenaAllocator() {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>&) {}
+
+  T* allocate(size_t n)
+  {
+    return static_cast<T*>(Arena::Current().Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T*, size_t) {}
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&)
+{
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&)
+{
+  return false;
+}
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+template <class T>
+using ArenaList = std::list<T, ArenaAllocator<T> >;
+
+}
+
+/// Lets new/delete of a class use the arena of the calling thread
+#define P2T_ARENA_ALLOCATED \
+  static void* operator new(size_t size) { return p2t::Arena::Current().Allocate(size); } \
+  static void operator delete(void*) {}
+
+#endif
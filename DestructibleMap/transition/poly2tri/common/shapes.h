@@ -37,6 +37,7 @@
 #include <cstddef>
 #include <assert.h>
 #include <cmath>
+#include "arena.h"
 
 namespace p2t {
 
@@ -54,7 +55,7 @@ struct Point {
   }
 
   /// The edges this point constitutes an upper ending point
-  std::vector<Edge*> edge_list;
+  ArenaVector<Edge*> edge_list;
 
   /// Construct using coordinates.
   Point(double x, double y) : x(x), y(y) {}
@@ -122,6 +123,8 @@ struct Point {
 // Represents a simple polygon's edge
 struct Edge {
 
+  P2T_ARENA_ALLOCATED
+
   Point* p, *q;
 
   /// Constructor
@@ -150,6 +153,8 @@ struct Edge {
 class Triangle {
 public:
 
+P2T_ARENA_ALLOCATED
+
 /// Constructor
 Triangle(Point& a, Point& b, Point& c);
 
@@ -40,6 +40,8 @@ struct Node;
 
 // Advancing front node
 struct Node {
+  P2T_ARENA_ALLOCATED
+
   Point* point;
   Triangle* triangle;
 
@@ -62,6 +64,8 @@ struct Node {
 class AdvancingFront {
 public:
 
+P2T_ARENA_ALLOCATED
+
 AdvancingFront(Node& head, Node& tail);
 // Destructor
 ~AdvancingFront();
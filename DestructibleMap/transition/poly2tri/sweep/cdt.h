@@ -48,12 +48,14 @@ class CDT
 {
 public:
 
+  P2T_ARENA_ALLOCATED
+
   /**
    * Constructor - add polyline with non repeating points
    * 
    * @param polyline
    */
-  CDT(std::vector<Point*> polyline);
+  CDT(const std::vector<Point*>& polyline);
   
    /**
    * Destructor - clean up memory
@@ -65,7 +67,7 @@ public:
    * 
    * @param polyline
    */
-  void AddHole(std::vector<Point*> polyline);
+  void AddHole(const std::vector<Point*>& polyline);
   
   /**
    * Add a steiner point
@@ -82,12 +84,12 @@ public:
   /**
    * Get CDT triangles
    */
-  std::vector<Triangle*> GetTriangles();
+  const ArenaVector<Triangle*>& GetTriangles();
   
   /**
    * Get triangle map
    */
-  std::list<Triangle*> GetMap();
+  const ArenaList<Triangle*>& GetMap();
 
   private:
 
@@ -766,9 +766,7 @@ Point& Sweep::NextFlipPoint(Point& ep, Point& eq, Triangle& ot, Point& op)
     // Left
     return *ot.PointCW(op);
   } else{
-    //throw new RuntimeException("[Unsupported] Opposing point on constrained edge");
-    assert(0);
-	return Point();
+    throw std::runtime_error("[Unsupported] Opposing point on constrained edge");
   }
 }
 
@@ -40,6 +40,7 @@
 #define SWEEP_H
 
 #include <vector>
+#include "../common/arena.h"
 
 namespace p2t {
 
@@ -53,6 +54,8 @@ class Sweep
 {
 public:
 
+  P2T_ARENA_ALLOCATED
+
   /**
    * Triangulate
    * 
@@ -276,7 +279,7 @@ private:
 
   void FinalizationPolygon(SweepContext& tcx);
 
-  std::vector<Node*> nodes_;
+  ArenaVector<Node*> nodes_;
 
 };
 
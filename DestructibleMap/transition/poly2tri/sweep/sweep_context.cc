@@ -34,7 +34,7 @@
 
 namespace p2t {
 
-SweepContext::SweepContext(std::vector<Point*> polyline) :
+SweepContext::SweepContext(const std::vector<Point*>& polyline) :
   front_(0),
   head_(0),
   tail_(0),
@@ -45,12 +45,12 @@ SweepContext::SweepContext(std::vector<Point*> polyline) :
   basin = Basin();
   edge_event = EdgeEvent();
 
-  points_ = polyline;
+  points_.assign(polyline.begin(), polyline.end());
 
-  InitEdges(points_);
+  InitEdges(polyline);
 }
 
-void SweepContext::AddHole(std::vector<Point*> polyline)
+void SweepContext::AddHole(const std::vector<Point*>& polyline)
 {
   InitEdges(polyline);
   for(unsigned int i = 0; i < polyline.size(); i++) {
@@ -62,12 +62,12 @@ void SweepContext::AddPoint(Point* point) {
   points_.push_back(point);
 }
 
-std::vector<Triangle*> SweepContext::GetTriangles()
+const ArenaVector<Triangle*>& SweepContext::GetTriangles()
 {
   return triangles_;
 }
 
-std::list<Triangle*> SweepContext::GetMap()
+const ArenaList<Triangle*>& SweepContext::GetMap()
 {
   return map_;
 }
@@ -92,15 +92,17 @@ void SweepContext::InitTriangulation()
 
   double dx = kAlpha * (xmax - xmin);
   double dy = kAlpha * (ymax - ymin);
-  head_ = new Point(xmax + dx, ymin - dy);
-  tail_ = new Point(xmin - dx, ymin - dy);
+  head_point_.set(xmax + dx, ymin - dy);
+  tail_point_.set(xmin - dx, ymin - dy);
+  head_ = &head_point_;
+  tail_ = &tail_point_;
 
   // Sort points along y-axis
   std::sort(points_.begin(), points_.end(), cmp);
 
 }
 
-void SweepContext::InitEdges(std::vector<Point*> polyline)
+void SweepContext::InitEdges(const std::vector<Point*>& polyline)
 {
   int num_points = polyline.size();
   for (int i = 0; i < num_points; i++) {
@@ -125,7 +127,7 @@ Node& SweepContext::LocateNode(Point& point)
   return *front_->LocateNode(point.x);
 }
 
-void SweepContext::CreateAdvancingFront(std::vector<Node*> nodes)
+void SweepContext::CreateAdvancingFront(const ArenaVector<Node*>& nodes)
 {
 
   (void) nodes;
@@ -170,7 +172,7 @@ void SweepContext::RemoveFromMap(Triangle* triangle)
 
 void SweepContext::MeshClean(Triangle& triangle)
 {
-  std::vector<Triangle *> triangles;
+  ArenaVector<Triangle *> triangles;
   triangles.push_back(&triangle);
 
   while(!triangles.empty()){
@@ -193,14 +195,12 @@ SweepContext::~SweepContext()
 
     // Clean up memory
 
-    delete head_;
-    delete tail_;
     delete front_;
     delete af_head_;
     delete af_middle_;
     delete af_tail_;
 
-    typedef std::list<Triangle*> type_list;
+    typedef ArenaList<Triangle*> type_list;
 
     for(type_list::iterator iter = map_.begin(); iter != map_.end(); ++iter) {
         Triangle* ptr = *iter;
@@ -35,6 +35,8 @@
 #include <list>
 #include <vector>
 #include <cstddef>
+#include "../common/arena.h"
+#include "../common/shapes.h"
 
 namespace p2t {
 
@@ -51,8 +53,10 @@ class AdvancingFront;
 class SweepContext {
 public:
 
+P2T_ARENA_ALLOCATED
+
 /// Constructor
-SweepContext(std::vector<Point*> polyline);
+SweepContext(const std::vector<Point*>& polyline);
 /// Destructor
 ~SweepContext();
 
@@ -70,7 +74,7 @@ Node& LocateNode(Point& point);
 
 void RemoveNode(Node* node);
 
-void CreateAdvancingFront(std::vector<Node*> nodes);
+void CreateAdvancingFront(const ArenaVector<Node*>& nodes);
 
 /// Try to map a node to all sides of this triangle that don't have a neighbor
 void MapTriangleToNodes(Triangle& t);
@@ -83,7 +87,7 @@ Point* GetPoints();
 
 void RemoveFromMap(Triangle* triangle);
 
-void AddHole(std::vector<Point*> polyline);
+void AddHole(const std::vector<Point*>& polyline);
 
 void AddPoint(Point* point);
 
@@ -91,10 +95,10 @@ AdvancingFront* front();
 
 void MeshClean(Triangle& triangle);
 
-std::vector<Triangle*> GetTriangles();
-std::list<Triangle*> GetMap();
+const ArenaVector<Triangle*>& GetTriangles();
+const ArenaList<Triangle*>& GetMap();
 
-std::vector<Edge*> edge_list;
+ArenaVector<Edge*> edge_list;
 
 struct Basin {
   Node* left_node;
@@ -133,9 +137,9 @@ private:
 
 friend class Sweep;
 
-std::vector<Triangle*> triangles_;
-std::list<Triangle*> map_;
-std::vector<Point*> points_;
+ArenaVector<Triangle*> triangles_;
+ArenaList<Triangle*> map_;
+ArenaVector<Point*> points_;
 
 // Advancing front
 AdvancingFront* front_;
@@ -143,11 +147,14 @@ AdvancingFront* front_;
 Point* head_;
 // tail point used with advancing front
 Point* tail_;
+// storage of head and tail, the points given by the user are not owned
+Point head_point_;
+Point tail_point_;
 
 Node *af_head_, *af_middle_, *af_tail_;
 
 void InitTriangulation();
-void InitEdges(std::vector<Point*> polyline);
+void InitEdges(const std::vector<Point*>& polyline);
 
 };
 